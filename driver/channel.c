@@ -0,0 +1,393 @@
+#include "channel.h"
+#include "err.h"
+#include "shm.h"
+#include "task.h"
+
+#include <linux/mm.h>
+#include <linux/pfn_t.h>
+#include <linux/slab.h>
+
+int channel_init(struct server_t *srv, size_t region_size)
+{
+    struct sub_mem_t *sub = NULL;
+
+    INIT_LIST_HEAD(&srv->m_subscribers);
+    mutex_init(&srv->m_sub_lock);
+    srv->m_sub_count = 0;
+    srv->m_channel_closed = 0;
+    srv->m_channel_seq = 0;
+    init_waitqueue_head(&srv->m_queue_wq);
+    spin_lock_init(&srv->m_queue_lock);
+    srv->m_queue_waiters = 0;
+
+    // огромных страниц может не найтись из-за фрагментации памяти
+    if (srv->m_flags & SERVER_FLAG_HUGE_PAGES)
+        sub = get_free_huge_submem(srv->m_numa_node);
+    if (!sub)
+        sub = get_free_submem(srv->m_numa_node, min(region_size, (size_t)SHM_REGION_MAX_SIZE));
+    if (!sub)
+    {
+        ERR("There is no free sub mem for channel (SIZE: %zu)", region_size);
+        mutex_destroy(&srv->m_sub_lock);
+        return -ENOMEM;
+    }
+
+    // подобласть из запаса уже обнулена: остается сообщить ее размер
+    if (srv->m_flags & SERVER_FLAG_QUEUE)
+    {
+        struct shm_queue_header *qhdr = sub->m_vaddr;
+        BUILD_BUG_ON(sizeof(struct shm_queue_header) != 3 * RIPC_CACHE_LINE);
+
+        // номер круга считается маской: ячеек - степень двойки
+        WRITE_ONCE(qhdr->m_region_size, sub->m_size);
+        WRITE_ONCE(qhdr->m_slot_size, SHM_QUEUE_SLOT_SIZE);
+        WRITE_ONCE(qhdr->m_slot_count,
+                   rounddown_pow_of_two((sub->m_size - SHM_QUEUE_SLOTS_OFFSET) / SHM_QUEUE_SLOT_SIZE));
+    }
+    else
+    {
+        struct shm_channel_header *hdr = sub->m_vaddr;
+        BUILD_BUG_ON(sizeof(struct shm_channel_header) != RIPC_CACHE_LINE);
+        WRITE_ONCE(hdr->m_region_size, sub->m_size);
+    }
+
+    srv->m_channel_mem = sub;
+    srv->m_max_region_size = sub->m_size;
+    return 0;
+}
+
+void channel_close(struct server_t *srv)
+{
+    struct channel_sub_t *entry, *tmp;
+
+    mutex_lock(&srv->m_sub_lock);
+    srv->m_channel_closed = 1;
+    list_for_each_entry_safe(entry, tmp, &srv->m_subscribers, list)
+    {
+        // подписку снимает тот, кто первым забрал ее у клиента: здесь или в channel_unsubscribe
+        if (cmpxchg(&entry->m_client->m_channel_p, srv, NULL) != srv)
+            continue;
+
+        list_del(&entry->list);
+        srv->m_sub_count--;
+        client_put(entry->m_client);
+        kfree(entry);
+
+        // ссылка подписки (последнюю держат таблицы серверов, поэтому мьютекс еще жив)
+        server_put(srv);
+    }
+    mutex_unlock(&srv->m_sub_lock);
+
+    // исполнители очереди не должны ждать заданий от удаленного издателя
+    wake_up_interruptible_all(&srv->m_queue_wq);
+
+    INF("Channel (ID:%d)(NAME:%s) closed", srv->m_id, srv->m_name);
+}
+
+void channel_release(struct server_t *srv)
+{
+    submem_release(srv->m_channel_mem);
+    srv->m_channel_mem = NULL;
+    mutex_destroy(&srv->m_sub_lock);
+}
+
+int channel_subscribe(struct server_t *srv, struct client_t *cli)
+{
+    int ret = 0;
+
+    struct channel_sub_t *entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+    if (!entry)
+    {
+        ERR("Cant allocate memory for channel subscriber");
+        return -ENOMEM;
+    }
+
+    mutex_lock(&srv->m_sub_lock);
+    if (srv->m_channel_closed)
+    {
+        ERR("Channel (ID:%d) is closed", srv->m_id);
+        ret = -ENOENT;
+        goto out;
+    }
+    if (srv->m_sub_count >= MAX_CLIENTS_PER_SERVER)
+    {
+        ERR("Too many subscribers in channel (ID:%d)", srv->m_id);
+        ret = -ENOSPC;
+        goto out;
+    }
+
+    // подписка держит ссылку на канал, запись канала - на клиента
+    server_get(srv);
+    if (cmpxchg(&cli->m_channel_p, NULL, srv) != NULL)
+    {
+        ERR("Client (ID:%d) already subscribed", cli->m_id);
+        server_put(srv);
+        ret = -EBUSY;
+        goto out;
+    }
+
+    client_get(cli);
+    entry->m_client = cli;
+    entry->m_reg_task = cli->m_task_p->m_reg_task;
+    list_add_tail(&entry->list, &srv->m_subscribers);
+    srv->m_sub_count++;
+    entry = NULL;
+
+    INF("Client (ID:%d) subscribed to channel (ID:%d)(NAME:%s)", cli->m_id, srv->m_id, srv->m_name);
+
+out:
+    mutex_unlock(&srv->m_sub_lock);
+    kfree(entry);
+    return ret;
+}
+
+int channel_unsubscribe(struct client_t *cli)
+{
+    struct channel_sub_t *entry;
+
+    // подписку снимает тот, кто первым забрал ее у клиента
+    struct server_t *srv = xchg(&cli->m_channel_p, NULL);
+    if (!srv)
+        return -ENOENT;
+
+    mutex_lock(&srv->m_sub_lock);
+    list_for_each_entry(entry, &srv->m_subscribers, list)
+    {
+        if (entry->m_client != cli)
+            continue;
+
+        list_del(&entry->list);
+        srv->m_sub_count--;
+        kfree(entry);
+        break;
+    }
+    mutex_unlock(&srv->m_sub_lock);
+
+    INF("Client (ID:%d) unsubscribed from channel (ID:%d)", cli->m_id, srv->m_id);
+
+    client_put(cli);
+    server_put(srv);
+    return 0;
+}
+
+int channel_publish(struct server_t *srv, size_t len)
+{
+    struct channel_sub_t *entry;
+    struct sub_mem_t *sub = srv->m_channel_mem;
+    struct shm_channel_header *hdr = sub->m_vaddr;
+    int delivered = 0;
+
+    // снимок канала состояния и задания очереди издатель публикует сам
+    if (srv->m_flags & (SERVER_FLAG_STATE | SERVER_FLAG_QUEUE))
+    {
+        ERR("Channel (ID:%d) does not notify subscribers", srv->m_id);
+        return -EINVAL;
+    }
+
+    if (len > sub->m_size - SHM_CHANNEL_DATA_OFFSET)
+    {
+        ERR("Message (%zu bytes) does not fit channel (ID:%d)", len, srv->m_id);
+        return -EINVAL;
+    }
+
+    struct notification_data data = {
+        .m_who_sends = SERVER,
+        .m_type = CHANNEL_MESSAGE,
+        .m_sub_mem_id = sub->m_id,
+        .m_sender_id = srv->m_id,
+    };
+
+    mutex_lock(&srv->m_sub_lock);
+
+    // длина видна раньше номера: подписчик, прочитавший новый номер, получит и ее
+    WRITE_ONCE(hdr->m_len, len);
+    srv->m_channel_seq++;
+    smp_store_release(&hdr->m_seq, srv->m_channel_seq << 1);
+
+    // данные уже лежат в общей подобласти: каждому подписчику уходит только запись в кольцо
+    list_for_each_entry(entry, &srv->m_subscribers, list)
+    {
+        data.m_reciver_id = entry->m_client->m_id;
+
+        // отстающий подписчик не теряет данные: следующее уведомление приведет его к последнему сообщению
+        if (!reg_task_send_ring_notification(entry->m_reg_task, &data))
+            delivered++;
+    }
+    mutex_unlock(&srv->m_sub_lock);
+
+    INF("Channel (ID:%d) published %zu bytes to %d subscribers", srv->m_id, len, delivered);
+    return delivered;
+}
+
+// подписан ли на канал клиент процесса reg_task
+static bool channel_is_subscriber(struct server_t *srv, struct reg_task_t *reg_task)
+{
+    struct channel_sub_t *entry;
+    bool found = false;
+
+    mutex_lock(&srv->m_sub_lock);
+    list_for_each_entry(entry, &srv->m_subscribers, list)
+    {
+        if (entry->m_reg_task == reg_task)
+        {
+            found = true;
+            break;
+        }
+    }
+    mutex_unlock(&srv->m_sub_lock);
+    return found;
+}
+
+// изменение счетчика ждущих исполнителей и его копии, которую читает издатель
+static void channel_queue_add_waiter(struct server_t *srv, int delta)
+{
+    struct shm_queue_header *qhdr = srv->m_channel_mem->m_vaddr;
+
+    spin_lock(&srv->m_queue_lock);
+    srv->m_queue_waiters += delta;
+    WRITE_ONCE(qhdr->m_waiters, srv->m_queue_waiters);
+    spin_unlock(&srv->m_queue_lock);
+}
+
+int channel_queue_wait(struct server_t *srv, struct reg_task_t *reg_task, unsigned int timeout_ms)
+{
+    struct shm_queue_header *qhdr = srv->m_channel_mem->m_vaddr;
+    long timeout = timeout_ms ? msecs_to_jiffies(timeout_ms) : MAX_SCHEDULE_TIMEOUT;
+    int ret = 0;
+    DEFINE_WAIT(wait);
+
+    if (!channel_is_subscriber(srv, reg_task))
+    {
+        ERR("Process is not subscribed to job queue (ID:%d)", srv->m_id);
+        return -EACCES;
+    }
+
+    // счетчик виден издателю раньше, чем исполнитель проверит очередь:
+    // либо исполнитель увидит новое задание, либо издатель увидит ждущего и разбудит его
+    channel_queue_add_waiter(srv, 1);
+    smp_mb();
+
+    for (;;)
+    {
+        // в очереди ждет только исполнитель, которого разбудит следующее задание
+        prepare_to_wait_exclusive(&srv->m_queue_wq, &wait, TASK_INTERRUPTIBLE);
+
+        // позиции пишут процессы: неверные значения дают лишь ложное пробуждение
+        if (READ_ONCE(qhdr->m_tail) != READ_ONCE(qhdr->m_head))
+            break;
+        if (READ_ONCE(srv->m_channel_closed))
+        {
+            ret = -ENOENT;
+            break;
+        }
+        if (signal_pending(current))
+        {
+            ret = -EINTR;
+            break;
+        }
+        if (!timeout)
+        {
+            ret = -ETIMEDOUT;
+            break;
+        }
+        timeout = schedule_timeout(timeout);
+    }
+    finish_wait(&srv->m_queue_wq, &wait);
+
+    channel_queue_add_waiter(srv, -1);
+    return ret;
+}
+
+int channel_queue_post(struct server_t *srv)
+{
+    if (!READ_ONCE(srv->m_queue_waiters))
+        return 0;
+
+    // ожидание исключающее: просыпается один исполнитель
+    wake_up_interruptible(&srv->m_queue_wq);
+    return 1;
+}
+
+int channel_subscribers(struct server_t *srv)
+{
+    mutex_lock(&srv->m_sub_lock);
+    int count = srv->m_sub_count;
+    mutex_unlock(&srv->m_sub_lock);
+    return count;
+}
+
+// отображение держит ссылку на канал: подобласть вернется в пул после последнего munmap
+static void channel_vm_open(struct vm_area_struct *vma)
+{
+    server_get(vma->vm_private_data);
+}
+
+static void channel_vm_close(struct vm_area_struct *vma)
+{
+    server_put(vma->vm_private_data);
+}
+
+// подобласть канала не меняется, пока жив сервер: страницы подставляются без блокировок
+static vm_fault_t channel_vm_fault(struct vm_fault *vmf)
+{
+    struct server_t *srv = vmf->vma->vm_private_data;
+    struct sub_mem_t *sub = srv->m_channel_mem;
+    unsigned long off = vmf->address - vmf->vma->vm_start;
+
+    if (off >= sub->m_size)
+        return VM_FAULT_SIGBUS;
+    return vmf_insert_mixed(vmf->vma, vmf->address, pfn_to_pfn_t(submem_pfn(sub, off)));
+}
+
+static const struct vm_operations_struct channel_vm_ops = {
+    .open = channel_vm_open,
+    .close = channel_vm_close,
+    .fault = channel_vm_fault,
+};
+
+int channel_mmap(struct server_t *srv, struct reg_task_t *reg_task, struct vm_area_struct *vma)
+{
+    unsigned long size = vma->vm_end - vma->vm_start;
+    if (size > srv->m_channel_mem->m_size)
+    {
+        ERR("Requested mapping (%lu bytes) is bigger than channel (%zu bytes)", size, srv->m_channel_mem->m_size);
+        return -EINVAL;
+    }
+
+    // копия при записи отвязала бы процесс от издателя
+    if (!(vma->vm_flags & VM_SHARED))
+    {
+        ERR("Channel memory can be mapped only shared");
+        return -EINVAL;
+    }
+
+    mutex_lock(&srv->m_lock);
+    bool publisher = srv->m_task_p && srv->m_task_p->m_reg_task == reg_task;
+    mutex_unlock(&srv->m_lock);
+
+    // подписчик только читает: запрет записи нельзя снять через mprotect.
+    // Исполнители очереди забирают задания сами и пишут в ячейки
+    if (!publisher)
+    {
+        if (!channel_is_subscriber(srv, reg_task))
+        {
+            ERR("Process is not subscribed to channel (ID:%d)", srv->m_id);
+            return -EACCES;
+        }
+        if (!(srv->m_flags & SERVER_FLAG_QUEUE))
+        {
+            if (vma->vm_flags & VM_WRITE)
+            {
+                ERR("Subscriber can map channel (ID:%d) only for reading", srv->m_id);
+                return -EPERM;
+            }
+            vm_flags_clear(vma, VM_MAYWRITE);
+        }
+    }
+
+    vm_flags_set(vma, VM_MIXEDMAP | VM_DONTEXPAND | VM_DONTDUMP);
+    vma->vm_private_data = srv;
+    vma->vm_ops = &channel_vm_ops;
+    channel_vm_open(vma);
+    return 0;
+}
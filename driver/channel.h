@@ -0,0 +1,82 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "client.h"
+#include "ripc.h"
+#include "server.h"
+
+#include <linux/list.h>
+#include <linux/mm_types.h>
+
+/**
+ * Канал публикации: сервер с SERVER_FLAG_CHANNEL владеет одной подобластью,
+ * которую издатель отображает для записи, а подписчики - только для чтения.
+ * Публикация не копирует данные: драйвер обновляет заголовок подобласти
+ * и за один проход по подписчикам кладет уведомление в кольцо каждого процесса.
+ * Канал состояния (SERVER_FLAG_STATE) не уведомляет: подписка лишь дает право отобразить подобласть.
+ * Очередь заданий (SERVER_FLAG_QUEUE) отображается исполнителям для записи: задания они забирают сами,
+ * а драйвер только будит одного ждущего исполнителя на каждое задание.
+ */
+
+// подписчик канала (запись в server_t::m_subscribers)
+struct channel_sub_t
+{
+    struct client_t *m_client;     // подписанный клиент (запись держит на него ссылку)
+    struct reg_task_t *m_reg_task; // процесс клиента, которому уходят уведомления
+    struct list_head list;
+};
+
+/**
+ * @brief Выделение подобласти канала при создании сервера
+ * @return int 0 - успех, -ENOMEM - нет свободной подобласти
+ */
+int channel_init(struct server_t *srv, size_t region_size);
+
+// закрытие канала при удалении сервера: подписчики отпускаются, новые не принимаются
+void channel_close(struct server_t *srv);
+
+// возврат подобласти канала в пул (с последней ссылкой на сервер, когда отображений уже нет)
+void channel_release(struct server_t *srv);
+
+/**
+ * @brief Подписка клиента на канал. У клиента может быть одна подписка.
+ * @return int 0 - успех, -EBUSY - клиент уже подписан, -ENOSPC - у канала нет мест, -ENOENT - канал закрыт
+ */
+int channel_subscribe(struct server_t *srv, struct client_t *cli);
+
+/**
+ * @brief Отписка клиента от канала
+ * @return int 0 - успех, -ENOENT - клиент не подписан
+ */
+int channel_unsubscribe(struct client_t *cli);
+
+/**
+ * @brief Публикация сообщения длиной len, уже записанного издателем после заголовка подобласти
+ * @return int количество подписчиков, получивших уведомление, или <0 - ошибка (-EINVAL - канал состояния)
+ */
+int channel_publish(struct server_t *srv, size_t len);
+
+/**
+ * @brief Ожидание задания исполнителем очереди (исключающее: одно задание будит одного исполнителя)
+ * @return int 0 - в очереди есть задания, -ETIMEDOUT, -EINTR, -ENOENT - очередь удалена,
+ * -EACCES - процесс не подписан на очередь
+ */
+int channel_queue_wait(struct server_t *srv, struct reg_task_t *reg_task, unsigned int timeout_ms);
+
+/**
+ * @brief Пробуждение одного ждущего исполнителя после нового задания
+ * @return int 1 - исполнитель разбужен, 0 - ждущих нет
+ */
+int channel_queue_post(struct server_t *srv);
+
+// количество подписчиков канала
+int channel_subscribers(struct server_t *srv);
+
+/**
+ * @brief Отображение подобласти канала (channel_id, 0): издателю - для записи, подписчику - только для чтения
+ * (исполнителю очереди - для записи)
+ * @return int 0 - успех, -EACCES - процесс не издатель и не подписчик, -EPERM - подписчик просит запись
+ */
+int channel_mmap(struct server_t *srv, struct reg_task_t *reg_task, struct vm_area_struct *vma);
+
+#endif // !CHANNEL_H
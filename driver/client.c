@@ -1,19 +1,45 @@
 #include "client.h"
+#include "channel.h"
 #include "connection.h"
 #include "err.h"
 #include "task.h"
 
 #include "id.h"
 #include <linux/mm.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
 
-// Список соединений и его блокировка
+// Список клиентов и его блокировка
 LIST_HEAD(g_clients_list);
 DEFINE_MUTEX(g_clients_lock);
 
+// Таблица клиентов по id
+DEFINE_XARRAY(g_clients_xa);
+
+// Кэш объектов клиентов
+static struct kmem_cache *g_clients_cache;
+
+int client_cache_create(void)
+{
+    g_clients_cache = KMEM_CACHE(client_t, 0);
+    if (!g_clients_cache)
+    {
+        ERR("Cant create client cache");
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void client_cache_destroy(void)
+{
+    kmem_cache_destroy(g_clients_cache);
+    g_clients_cache = NULL;
+}
+
 // создание клиента
 struct client_t *client_create(void)
 {
-    struct client_t *cli = kmalloc(sizeof(*cli), GFP_KERNEL);
+    struct client_t *cli = kmem_cache_alloc(g_clients_cache, GFP_KERNEL);
     if (!cli)
     {
         ERR("Cant allocate memory for client");
@@ -23,10 +49,25 @@ struct client_t *client_create(void)
     // Инициализация полей
     cli->m_id = generate_id(&g_id_gen);
     cli->m_conn_p = NULL;
+    cli->m_channel_p = NULL;
     cli->m_task_p = NULL;
+    atomic_set(&cli->m_call_state, CLIENT_CALL_IDLE);
+    init_waitqueue_head(&cli->m_call_wq);
+
+    // первая ссылка принадлежит таблице клиентов
+    kref_init(&cli->m_ref);
+
+    // добавление в таблицу по id
+    if (xa_err(xa_store(&g_clients_xa, cli->m_id, cli, GFP_KERNEL)))
+    {
+        ERR("Cant add client (ID:%d) to id table", cli->m_id);
+        free_id(&g_id_gen, cli->m_id);
+        kmem_cache_free(g_clients_cache, cli);
+        return NULL;
+    }
 
     mutex_lock(&g_clients_lock);
-    list_add_tail(&cli->list, &g_clients_list);
+    list_add_tail_rcu(&cli->list, &g_clients_list);
     mutex_unlock(&g_clients_lock);
 
     INF("Client %d created", cli->m_id);
@@ -54,18 +95,60 @@ void client_add_task(struct client_t *cli, struct clients_list_t *task)
     cli->m_task_p = task;
 }
 
+int client_call_wait(struct client_t *cli, unsigned int timeout_ms)
+{
+    if (!cli)
+    {
+        ERR("empty param");
+        return -EINVAL;
+    }
+
+    long timeout = timeout_ms ? msecs_to_jiffies(timeout_ms) : MAX_SCHEDULE_TIMEOUT;
+    long ret = wait_event_interruptible_timeout(cli->m_call_wq,
+                                                atomic_read(&cli->m_call_state) != CLIENT_CALL_WAITING, timeout);
+
+    // сбрасываем состояние: ответ, пришедший после этого, уйдет обычным уведомлением
+    int state = atomic_xchg(&cli->m_call_state, CLIENT_CALL_IDLE);
+    switch (state)
+    {
+    case CLIENT_CALL_REPLIED:
+        return 0;
+    case CLIENT_CALL_ABORTED:
+        INF("Call of client %d aborted", cli->m_id);
+        return -ECONNRESET;
+    default:
+        INF("Call of client %d interrupted (%ld)", cli->m_id, ret);
+        return ret < 0 ? -EINTR : -ETIMEDOUT;
+    }
+}
+
+int client_call_complete(struct client_t *cli, enum client_call_state state)
+{
+    if (!cli)
+    {
+        ERR("empty param");
+        return 0;
+    }
+
+    if (atomic_cmpxchg(&cli->m_call_state, CLIENT_CALL_WAITING, state) != CLIENT_CALL_WAITING)
+        return 0;
+
+    wake_up_interruptible(&cli->m_call_wq);
+    return 1;
+}
+
 void client_cleanup_connection(struct client_t *cli)
 {
     if (!cli)
         return;
-    struct connection_t *conn = cli->m_conn_p;
+    struct connection_t *conn = client_get_connection(cli);
 
     if (conn)
     {
         INF("Cleaning up connection for client %d", cli->m_id);
-        cli->m_conn_p = NULL; // Убираем ссылку у клиента
-        // Вызываем delete_connection, которая обработает все остальное
+        // Вызываем delete_connection, которая обработает все остальное (и уберет ссылку у клиента)
         delete_connection(conn);
+        connection_put(conn);
     }
     else
     {
@@ -85,13 +168,61 @@ void client_destroy(struct client_t *cli)
 
     INF("Destroying client (ID:%d))\n", cli->m_id);
 
+    // подписка держит ссылку на клиента и на процесс, которому уходят уведомления канала
+    channel_unsubscribe(cli);
+
     // удаление из глобального списка
     mutex_lock(&g_clients_lock);
-    list_del(&cli->list);
+    list_del_rcu(&cli->list);
     mutex_unlock(&g_clients_lock);
 
+    // удаление из таблицы до освобождения id, чтобы id не переиспользовался раньше
+    xa_erase(&g_clients_xa, cli->m_id);
     free_id(&g_id_gen, cli->m_id);
-    kfree(cli);
+
+    // ссылка таблицы: объект живет, пока его держат соединение или текущие запросы
+    client_put(cli);
+}
+
+// возврат памяти клиента в кэш после читателей под RCU
+static void client_free_rcu(struct rcu_head *head)
+{
+    kmem_cache_free(g_clients_cache, container_of(head, struct client_t, m_rcu));
+}
+
+// освобождение клиента после последней ссылки
+static void client_release(struct kref *ref)
+{
+    struct client_t *cli = container_of(ref, struct client_t, m_ref);
+
+    INF("Client %d freed", cli->m_id);
+
+    // читатели под RCU могут еще держать указатель
+    call_rcu(&cli->m_rcu, client_free_rcu);
+}
+
+void client_get(struct client_t *cli)
+{
+    if (cli)
+        kref_get(&cli->m_ref);
+}
+
+void client_put(struct client_t *cli)
+{
+    if (cli)
+        kref_put(&cli->m_ref, client_release);
+}
+
+struct connection_t *client_get_connection(struct client_t *cli)
+{
+    if (!cli)
+        return NULL;
+
+    rcu_read_lock();
+    struct connection_t *con = connection_tryget(rcu_dereference(cli->m_conn_p));
+    rcu_read_unlock();
+
+    return con;
 }
 
 void client_add_connection(struct client_t *cli, struct connection_t *con)
@@ -108,7 +239,8 @@ void client_add_connection(struct client_t *cli, struct connection_t *con)
         return;
     }
 
-    cli->m_conn_p = con;
+    // соединение полностью инициализировано до публикации читателям
+    rcu_assign_pointer(cli->m_conn_p, con);
 }
 
 // поиск клиента по id
@@ -121,24 +253,27 @@ struct client_t *find_client_by_id(int id)
         return NULL;
     }
 
-    mutex_lock(&g_clients_lock);
+    // объект освобождается через RCU, поэтому ссылку можно взять без глобальных блокировок
+    rcu_read_lock();
+    struct client_t *client = xa_load(&g_clients_xa, id);
+    if (client && !kref_get_unless_zero(&client->m_ref))
+        client = NULL;
+    rcu_read_unlock();
 
-    // проходимся по каждому клиенту и ищем подходящего
-    struct client_t *client = NULL;
+    return client;
+}
 
-    // Итерируемся по списку клиентов
-    list_for_each_entry(client, &g_clients_list, list)
+struct client_t *find_client_by_id_owner(int id, struct reg_task_t *reg_task)
+{
+    struct client_t *client = find_client_by_id(id);
+
+    if (client && (!client->m_task_p || client->m_task_p->m_reg_task != reg_task))
     {
-        if (client->m_id == id)
-        {
-            mutex_unlock(&g_clients_lock);
-            // Нашли совпадение - сохраняем результат
-            return client;
-        }
+        INF("Client (ID:%d) is not registered by this task", id);
+        client_put(client);
+        return NULL;
     }
-    mutex_unlock(&g_clients_lock);
-
-    return NULL;
+    return client;
 }
 
 struct client_t *find_client_by_id_pid(int id, pid_t pid)
@@ -150,26 +285,15 @@ struct client_t *find_client_by_id_pid(int id, pid_t pid)
         return NULL;
     }
 
-    mutex_lock(&g_clients_lock);
+    struct client_t *client = find_client_by_id(id);
 
-    // проходимся по каждому клиенту и ищем подходящего
-    struct client_t *client = NULL;
+    // if (client && client->m_task_p->m_reg_task->m_task_p->pid != pid)
+    //     return NULL;
 
-    // Итерируемся по списку клиентов
-    list_for_each_entry(client, &g_clients_list, list)
-    {
-        if (/*client->m_task_p->m_reg_task->m_task_p->pid == pid &&*/
-            client->m_id == id)
-        {
-            INF("FOUND client (ID:%d)(PID:%d)", client->m_id, client->m_task_p->m_reg_task->m_task_p->pid);
-            mutex_unlock(&g_clients_lock);
-            // Нашли совпадение - сохраняем результат
-            return client;
-        }
-    }
-    mutex_unlock(&g_clients_lock);
+    if (client)
+        INF("FOUND client (ID:%d)", client->m_id);
 
-    return NULL;
+    return client;
 }
 
 void client_get_data(struct client_t *cli, struct st_client *dest)
@@ -183,10 +307,12 @@ void client_get_data(struct client_t *cli, struct st_client *dest)
     INF("Getting data from client");
 
     dest->id = cli->m_id;
-    if (cli->m_conn_p && cli->m_conn_p->m_server_p)
-        dest->srv_id = cli->m_conn_p->m_server_p->m_id;
+    struct connection_t *con = client_get_connection(cli);
+    if (con && con->m_server_p)
+        dest->srv_id = con->m_server_p->m_id;
     else
         dest->srv_id = -1;
+    connection_put(con);
 }
 
 /**
@@ -4,28 +4,55 @@
 #include "connection.h"
 #include "ripc.h"
 
+#include <linux/atomic.h>
+#include <linux/kref.h>
 #include <linux/list.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/xarray.h>
 
 /**
  * Определение структуры клиента и операций над ней
  */
 
+// состояние синхронного вызова IOCTL_CLIENT_CALL
+enum client_call_state
+{
+    CLIENT_CALL_IDLE,    // вызова нет
+    CLIENT_CALL_WAITING, // поток клиента спит в ожидании ответа
+    CLIENT_CALL_REPLIED, // сервер ответил
+    CLIENT_CALL_ABORTED, // соединение разорвано
+};
+
 struct client_t
 {
     int m_id;                        // id клиента в процессе
     struct clients_list_t *m_task_p; // указатель на задачу, где зарегистрирован сервер
-    struct connection_t *m_conn_p;   // указатель на соединение с сервером и пмаятью
+    struct connection_t *m_conn_p;   // указатель на соединение с сервером и пмаятью (читается под RCU)
+    struct server_t *m_channel_p;    // канал, на который подписан клиент (подписка держит на него ссылку)
+    atomic_t m_call_state;           // состояние синхронного вызова (enum client_call_state)
+    wait_queue_head_t m_call_wq;     // очередь ожидания ответа на синхронный вызов
+    struct kref m_ref;               // счетчик ссылок: таблица клиентов, соединение, текущие запросы
+    struct rcu_head m_rcu;           // отложенное освобождение после читателей
     struct list_head list;           // список клиентов
 };
 
-// Список соединений и его блокировка
+// Список клиентов: изменяется под g_clients_lock, читается под RCU
 extern struct list_head g_clients_list;
 extern struct mutex g_clients_lock;
 
+// Таблица клиентов по id
+extern struct xarray g_clients_xa;
+
 /**
  * Операции над объектом соединения
  */
+
+// создание и удаление кэша объектов клиентов (при загрузке и выгрузке модуля)
+int client_cache_create(void);
+void client_cache_destroy(void);
+
 // создание клиента
 struct client_t *client_create(void);
 
@@ -35,18 +62,49 @@ void client_add_task(struct client_t *cli, struct clients_list_t *task);
 // очистка соединения клиента
 void client_cleanup_connection(struct client_t *cli);
 
-// удаление клиента
+// удаление клиента из таблиц, память освобождается с последней ссылкой
 void client_destroy(struct client_t *cli);
 
+// захват и освобождение ссылки на клиента
+void client_get(struct client_t *cli);
+void client_put(struct client_t *cli);
+
+/**
+ * @brief Получение соединения клиента со ссылкой
+ * @return struct connection_t* соединение (освобождается через connection_put) или NULL, если его нет
+ */
+struct connection_t *client_get_connection(struct client_t *cli);
+
 // подключение клиента к соединению
 void client_add_connection(struct client_t *cli, struct connection_t *con);
 
-// поиск клиента по id
+// поиск клиента по id, возвращает клиента со ссылкой (освобождается через client_put)
 struct client_t *find_client_by_id(int id);
 
-// поиск клиента по id и pid
+// поиск клиента по id и pid, возвращает клиента со ссылкой (освобождается через client_put)
 struct client_t *find_client_by_id_pid(int id, pid_t pid);
 
+struct reg_task_t;
+
+// поиск клиента, зарегистрированного через открытое устройство reg_task (любым потоком процесса),
+// возвращает клиента со ссылкой (освобождается через client_put)
+struct client_t *find_client_by_id_owner(int id, struct reg_task_t *reg_task);
+
+/**
+ * @brief Ожидание ответа сервера на синхронный вызов.
+ * Состояние CLIENT_CALL_WAITING должно быть выставлено до отправки запроса.
+ * @param timeout_ms время ожидания (0 - без ограничения)
+ * @return int 0 - ответ получен, -ETIMEDOUT, -EINTR или -ECONNRESET
+ */
+int client_call_wait(struct client_t *cli, unsigned int timeout_ms);
+
+/**
+ * @brief Завершение синхронного вызова клиента
+ * @param state CLIENT_CALL_REPLIED или CLIENT_CALL_ABORTED
+ * @return int 1 - клиент ждал и был разбужен, 0 - клиент не ждал
+ */
+int client_call_complete(struct client_t *cli, enum client_call_state state);
+
 // получение информации о клиенте
 void client_get_data(struct client_t* cli, struct st_client* dest);
 
@@ -0,0 +1,255 @@
+#include "conn_file.h"
+#include "err.h"
+#include "id_pack.h"
+
+#include <linux/anon_inodes.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+// место дескриптора стороны в соединении
+static struct conn_file_t **conn_file_slot(struct connection_t *con, enum notif_sender side)
+{
+    return side == CLIENT ? &con->m_client_file : &con->m_server_file;
+}
+
+// дескриптор отвязан, если соединение закрыто или передано другому серверу
+static bool conn_file_detached(struct conn_file_t *cf)
+{
+    struct connection_t *con = cf->m_conn;
+
+    spin_lock(&con->m_file_lock);
+    bool detached = *conn_file_slot(con, cf->m_side) != cf;
+    spin_unlock(&con->m_file_lock);
+
+    return detached || atomic_read(&con->m_closed);
+}
+
+static int conn_file_release(struct inode *inode, struct file *filp)
+{
+    struct conn_file_t *cf = filp->private_data;
+    struct connection_t *con = cf->m_conn;
+
+    // после этого уведомления стороны снова уходят процессу
+    spin_lock(&con->m_file_lock);
+    if (*conn_file_slot(con, cf->m_side) == cf)
+        *conn_file_slot(con, cf->m_side) = NULL;
+    spin_unlock(&con->m_file_lock);
+
+    INF("Connection file of %s closed", cf->m_side == CLIENT ? "client" : "server");
+    connection_put(con);
+    kfree(cf);
+    return 0;
+}
+
+static ssize_t conn_file_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos)
+{
+    struct conn_file_t *cf = filp->private_data;
+    struct connection_t *con = cf->m_conn;
+    struct notification_data batch[CONN_NOTIF_SLOTS];
+    size_t size = sizeof(struct notification_data);
+    int n = 0, ret;
+
+    if (count < size)
+    {
+        ERR("Not enough space");
+        return -EMSGSIZE;
+    }
+
+    for (;;)
+    {
+        // слоты разбираются по порядку типов: ответ читается раньше разрыва соединения
+        spin_lock(&con->m_file_lock);
+        for (int slot = 0; slot < CONN_NOTIF_SLOTS && (size_t)n < count / size; slot++)
+        {
+            if (!test_and_clear_bit(slot, &cf->m_pending_mask))
+                continue;
+            batch[n++] = cf->m_pending[slot];
+        }
+        spin_unlock(&con->m_file_lock);
+
+        if (n)
+            break;
+
+        // после закрытия или передачи соединения уведомлений больше не будет: конец файла
+        if (conn_file_detached(cf))
+            return 0;
+
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+
+        ret = wait_event_interruptible(cf->m_wq, READ_ONCE(cf->m_pending_mask) || conn_file_detached(cf));
+        if (ret)
+            return ret;
+    }
+
+    if (copy_to_user(buf, batch, n * size))
+    {
+        ERR("copy_to_user error");
+        return -EFAULT;
+    }
+    return n * size;
+}
+
+static __poll_t conn_file_poll(struct file *filp, poll_table *wait)
+{
+    struct conn_file_t *cf = filp->private_data;
+    __poll_t mask = 0;
+
+    poll_wait(filp, &cf->m_wq, wait);
+
+    if (READ_ONCE(cf->m_pending_mask))
+        mask |= EPOLLIN | EPOLLRDNORM;
+
+    // после закрытия или передачи соединения уведомлений больше не будет
+    if (conn_file_detached(cf))
+        mask |= EPOLLHUP;
+    return mask;
+}
+
+static int conn_file_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct conn_file_t *cf = filp->private_data;
+    struct connection_t *con = cf->m_conn;
+    u32 packed_id;
+
+    // у дескриптора одна область: смещение выбирает драйвер
+    if (vma->vm_pgoff != 0)
+    {
+        ERR("Connection file can be mapped only from offset 0");
+        return -EINVAL;
+    }
+
+    // отображение получает смещение стороны в устройстве: так его снимают рост, обмен областей и передача
+    if (cf->m_side == CLIENT)
+    {
+        packed_id = pack_ids(con->m_client_p->m_id, 0);
+    }
+    else
+    {
+        down_read(&con->m_mem_sem);
+        struct sub_mem_t *sub = con->m_mem_p;
+        packed_id = sub ? pack_ids(READ_ONCE(con->m_server_p)->m_id, sub->m_id) : (u32)-EINVAL;
+        up_read(&con->m_mem_sem);
+    }
+
+    if (packed_id == (u32)-EINVAL || conn_file_detached(cf))
+    {
+        ERR("Connection is closed or moved to another server");
+        return -ENOENT;
+    }
+    vma->vm_pgoff = packed_id;
+
+    int ret = connection_mmap(con, vma);
+
+    // клиент, отобразивший область, объявляет соединение серверу
+    if (!ret && cf->m_side == CLIENT)
+        connection_client_mapped(con);
+    return ret;
+}
+
+static const struct file_operations conn_file_fops = {
+    .owner = THIS_MODULE,
+    .release = conn_file_release,
+    .read = conn_file_read,
+    .poll = conn_file_poll,
+    .mmap = conn_file_mmap,
+};
+
+int conn_file_create(struct connection_t *con, enum notif_sender side, struct file *dev_filp)
+{
+    int ret;
+
+    struct conn_file_t *cf = kzalloc(sizeof(*cf), GFP_KERNEL);
+    if (!cf)
+    {
+        ERR("Cant allocate memory for connection file");
+        return -ENOMEM;
+    }
+
+    // файл держит ссылку на соединение до release
+    if (!connection_tryget(con))
+    {
+        ERR("Connection is already closed");
+        kfree(cf);
+        return -ENOENT;
+    }
+    cf->m_conn = con;
+    cf->m_side = side;
+    init_waitqueue_head(&cf->m_wq);
+
+    int fd = get_unused_fd_flags(O_CLOEXEC);
+    if (fd < 0)
+    {
+        ret = fd;
+        goto put_conn;
+    }
+
+    struct file *file = anon_inode_getfile("[ripc_conn]", &conn_file_fops, cf, O_RDWR);
+    if (IS_ERR(file))
+    {
+        ret = PTR_ERR(file);
+        goto put_fd;
+    }
+
+    // отображения дескриптора лежат рядом с отображениями устройства
+    file->f_mapping = dev_filp->f_mapping;
+
+    spin_lock(&con->m_file_lock);
+    if (*conn_file_slot(con, side))
+    {
+        spin_unlock(&con->m_file_lock);
+        ERR("Connection side already has a file");
+
+        // release отпустит ссылку на соединение и память
+        fput(file);
+        put_unused_fd(fd);
+        return -EBUSY;
+    }
+    *conn_file_slot(con, side) = cf;
+    spin_unlock(&con->m_file_lock);
+
+    fd_install(fd, file);
+    INF("Connection file (FD:%d) created for %s", fd, side == CLIENT ? "client" : "server");
+    return fd;
+
+put_fd:
+    put_unused_fd(fd);
+put_conn:
+    connection_put(con);
+    kfree(cf);
+    return ret;
+}
+
+void conn_file_detach(struct connection_t *con, enum notif_sender side)
+{
+    spin_lock(&con->m_file_lock);
+    struct conn_file_t *cf = *conn_file_slot(con, side);
+    if (cf)
+    {
+        // ждущий в read получит конец файла, poll - EPOLLHUP
+        *conn_file_slot(con, side) = NULL;
+        wake_up_interruptible(&cf->m_wq);
+    }
+    spin_unlock(&con->m_file_lock);
+}
+
+int conn_file_push(struct connection_t *con, enum notif_sender receiver, const struct notification_data *data)
+{
+    int slot = CONN_NOTIF_SLOT(data->m_who_sends, data->m_type);
+
+    spin_lock(&con->m_file_lock);
+    struct conn_file_t *cf = *conn_file_slot(con, receiver);
+    if (cf)
+    {
+        // одинаковые уведомления склеиваются: владелец прочитает последнее
+        cf->m_pending[slot] = *data;
+        set_bit(slot, &cf->m_pending_mask);
+        wake_up_interruptible(&cf->m_wq);
+    }
+    spin_unlock(&con->m_file_lock);
+
+    return cf != NULL;
+}
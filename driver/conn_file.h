@@ -0,0 +1,47 @@
+#ifndef CONN_FILE_H
+#define CONN_FILE_H
+
+#include "connection.h"
+#include "ripc.h"
+
+#include <linux/fs.h>
+#include <linux/wait.h>
+
+/**
+ * Дескриптор соединения: отдельный файл на сторону соединения. Владелец ждет в poll/epoll
+ * только свои соединения, а драйвер находит соединение по private_data без поиска по id.
+ * Уведомления стороны с дескриптором не попадают в общую очередь процесса.
+ * Пустой read ждет уведомления (с O_NONBLOCK - -EAGAIN) и возвращает 0, когда дескриптор отвязан.
+ */
+struct conn_file_t
+{
+    struct connection_t *m_conn; // соединение (файл держит на него ссылку)
+    enum notif_sender m_side;    // сторона, которой принадлежит дескриптор (CLIENT или SERVER)
+    wait_queue_head_t m_wq;      // ожидание уведомлений в poll
+
+    // уведомления (под m_conn->m_file_lock): по слоту на пару (отправитель, тип), как в соединении
+    struct notification_data m_pending[CONN_NOTIF_SLOTS];
+    unsigned long m_pending_mask;
+};
+
+/**
+ * @brief Создание дескриптора соединения для стороны side
+ * @param dev_filp файл устройства: отображения дескриптора попадают в его address_space,
+ * поэтому рост и обмен областей снимают их вместе с обычными отображениями
+ * @return int дескриптор или <0 - ошибка (-EBUSY - у стороны уже есть дескриптор, -ENOENT - соединение закрыто)
+ */
+int conn_file_create(struct connection_t *con, enum notif_sender side, struct file *dev_filp);
+
+/**
+ * @brief Отвязка дескриптора стороны от соединения (закрытие или передача соединения).
+ * Уже доставленные уведомления остаются в дескрипторе, новые уходят процессу.
+ */
+void conn_file_detach(struct connection_t *con, enum notif_sender side);
+
+/**
+ * @brief Доставка уведомления в дескриптор стороны-получателя
+ * @return int 1 - уведомление ждет в дескрипторе, 0 - у получателя нет дескриптора
+ */
+int conn_file_push(struct connection_t *con, enum notif_sender receiver, const struct notification_data *data);
+
+#endif // !CONN_FILE_H
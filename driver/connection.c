@@ -1,13 +1,38 @@
 #include "connection.h"
+#include "conn_file.h"
 #include "err.h"
 
+#include <linux/huge_mm.h>
 #include <linux/mm.h>
+#include <linux/pfn_t.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
 #include "task.h"
 
 // Список соединений и его блокировка
 LIST_HEAD(g_conns_list);
 DEFINE_MUTEX(g_conns_lock);
 
+// Кэш объектов соединений
+static struct kmem_cache *g_conns_cache;
+
+int connection_cache_create(void)
+{
+    g_conns_cache = KMEM_CACHE(connection_t, 0);
+    if (!g_conns_cache)
+    {
+        ERR("Cant create connection cache");
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void connection_cache_destroy(void)
+{
+    kmem_cache_destroy(g_conns_cache);
+    g_conns_cache = NULL;
+}
+
 // создание соединения
 struct connection_t *create_connection(
     struct client_t *client,
@@ -20,7 +45,7 @@ struct connection_t *create_connection(
         return NULL;
     }
 
-    struct connection_t *con = kmalloc(sizeof(*con), GFP_KERNEL);
+    struct connection_t *con = kmem_cache_alloc(g_conns_cache, GFP_KERNEL);
 
     if (!con)
     {
@@ -31,13 +56,28 @@ struct connection_t *create_connection(
     // инициализация полей
     con->m_client_p = client;
     con->m_mem_p = mem;
+    init_rwsem(&con->m_mem_sem);
+    con->m_mapping = NULL;
     con->m_server_p = server;
+    con->m_srv_conn = NULL;
     INIT_LIST_HEAD(&con->list);
     atomic_set(&con->m_serv_mmaped, 0);
+    atomic_set(&con->m_closed, 0);
+    con->m_notif_busy = 0;
+    spin_lock_init(&con->m_file_lock);
+    con->m_client_file = NULL;
+    con->m_server_file = NULL;
+
+    // первая ссылка принадлежит связи клиента с сервером и снимается в delete_connection
+    kref_init(&con->m_ref);
+
+    // стороны живут не меньше соединения
+    client_get(client);
+    server_get(server);
 
     // добавление в глобальный список
     mutex_lock(&g_conns_lock);
-    list_add_tail(&con->list, &g_conns_list);
+    list_add_tail_rcu(&con->list, &g_conns_list);
     mutex_unlock(&g_conns_lock);
 
     INF("Created new connection btw serv: %d client: %d shm: %d",
@@ -62,42 +102,509 @@ struct connection_t *find_connection(
 
     // проходимся по списку и ищем общую память между двумя процессами
     struct connection_t *con = NULL;
-    mutex_lock(&g_conns_lock);
-    list_for_each_entry(con, &g_conns_list, list)
+    rcu_read_lock();
+    list_for_each_entry_rcu(con, &g_conns_list, list)
     {
         if ((con->m_client_p->m_task_p->m_reg_task->m_task_p == task1 &&
              con->m_server_p->m_task_p->m_reg_task->m_task_p == task2) ||
             (con->m_client_p->m_task_p->m_reg_task->m_task_p == task2 &&
              con->m_server_p->m_task_p->m_reg_task->m_task_p == task1))
         {
-            INF("FOUND connection");
-            mutex_unlock(&g_conns_lock);
+            con = connection_tryget(con);
+            rcu_read_unlock();
+            INF("%s connection", con ? "FOUND" : "Closed");
             return con;
         }
     }
     INF("Connection not found");
-    mutex_unlock(&g_conns_lock);
+    rcu_read_unlock();
 
     return NULL;
 }
 
+struct connection_t *connection_tryget(struct connection_t *con)
+{
+    if (!con || atomic_read(&con->m_closed) || !kref_get_unless_zero(&con->m_ref))
+        return NULL;
+    return con;
+}
+
+// возврат памяти соединения в кэш после читателей под RCU
+static void connection_free_rcu(struct rcu_head *head)
+{
+    kmem_cache_free(g_conns_cache, container_of(head, struct connection_t, m_rcu));
+}
+
+// освобождение соединения после последней ссылки
+static void connection_release(struct kref *ref)
+{
+    struct connection_t *con = container_of(ref, struct connection_t, m_ref);
+
+    INF("Connection structure freed.");
+
+    client_put(con->m_client_p);
+    server_put(con->m_server_p);
+
+    // читатели под RCU могут еще держать указатель
+    call_rcu(&con->m_rcu, connection_free_rcu);
+}
+
+void connection_put(struct connection_t *con)
+{
+    if (con)
+        kref_put(&con->m_ref, connection_release);
+}
+
+/**
+ * Отображение памяти соединения
+ */
+
+size_t connection_region_limit(struct connection_t *con)
+{
+    if (con->m_server_p->m_flags & SERVER_FLAG_HUGE_PAGES)
+        return SHM_HUGE_REGION_SIZE;
+    return PAGE_SIZE << shm_size_to_order(con->m_server_p->m_max_region_size);
+}
+
+// снятие отображений подобласти у обеих сторон: при следующем обращении страницы подставятся заново
+static void connection_unmap(struct connection_t *con, struct sub_mem_t *sub)
+{
+    struct address_space *mapping = READ_ONCE(con->m_mapping);
+    loff_t len = connection_region_limit(con);
+
+    // область еще никто не отображал
+    if (!mapping)
+        return;
+
+    // клиент отображает (client_id, 0), сервер - (server_id, sub_mem_id)
+    unmap_mapping_range(mapping, (loff_t)pack_ids(con->m_client_p->m_id, 0) << PAGE_SHIFT, len, 1);
+    unmap_mapping_range(mapping, (loff_t)pack_ids(con->m_server_p->m_id, sub->m_id) << PAGE_SHIFT, len, 1);
+}
+
+struct server_t *connection_route_request(struct connection_t *con)
+{
+    struct server_t *home = con->m_server_p;
+    if (!(home->m_flags & SERVER_FLAG_ROUTE))
+        return NULL;
+
+    // URL - первый заголовок запроса; копия снимается до выбора сервера,
+    // клиент не пишет в страницу запроса, пока тот не ответил
+    char url[MAX_ROUTE_PREFIX];
+    size_t len = 0;
+
+    down_read(&con->m_mem_sem);
+    struct sub_mem_t *sub = con->m_mem_p;
+    if (sub)
+    {
+        struct shm_doorbell *db = sub->m_vaddr;
+        const char *msg = (const char *)sub->m_vaddr + SHM_REQUEST_OFFSET;
+        size_t header_len = min_t(size_t, READ_ONCE(db->m_request.m_header_len), sizeof(url));
+
+        // заголовок не выходит за половину запроса
+        if (SHM_REQUEST_OFFSET + header_len > SHM_RESPONSE_OFFSET(sub->m_size))
+            header_len = 0;
+        memcpy(url, msg, header_len);
+        while (len < header_len && url[len] != '\t')
+            len++;
+    }
+    up_read(&con->m_mem_sem);
+
+    return len ? server_route_request(home, url, len) : NULL;
+}
+
+/**
+ * @brief Смещение в подобласти для смещения off в отображении (SHM_RESPONSE_OFFSET).
+ * @return смещение или ULONG_MAX, если подобласть еще не выросла до этого места
+ */
+static unsigned long connection_sub_offset(struct connection_t *con, struct sub_mem_t *sub, unsigned long off)
+{
+    unsigned long map_half = SHM_RESPONSE_OFFSET(connection_region_limit(con));
+    unsigned long sub_half = SHM_RESPONSE_OFFSET(sub->m_size);
+    unsigned long base = 0;
+
+    if (off >= map_half)
+    {
+        off -= map_half;
+        base = sub_half;
+    }
+    return off < sub_half ? base + off : ULONG_MAX;
+}
+
+// отображение держит ссылку на соединение
+static void connection_vm_open(struct vm_area_struct *vma)
+{
+    struct connection_t *con = vma->vm_private_data;
+    kref_get(&con->m_ref);
+}
+
+static void connection_vm_close(struct vm_area_struct *vma)
+{
+    connection_put(vma->vm_private_data);
+}
+
+// отображение нельзя разрезать: смещение в подобласти считается от vm_start
+static int connection_vm_may_split(struct vm_area_struct *vma, unsigned long addr)
+{
+    return -EINVAL;
+}
+
+// отображение сервера, отдавшего соединение другому участнику группы (сервер отображает (server_id, sub_mem_id))
+static bool connection_vma_revoked(struct connection_t *con, struct vm_area_struct *vma)
+{
+    u32 packed_id = (u32)vma->vm_pgoff;
+    return unpack_id2(packed_id) != 0 && unpack_id1(packed_id) != READ_ONCE(con->m_server_p)->m_id;
+}
+
+// подстановка одной страницы текущей подобласти соединения
+static vm_fault_t connection_vm_fault(struct vm_fault *vmf)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    struct connection_t *con = vma->vm_private_data;
+    unsigned long off = vmf->address - vma->vm_start;
+    vm_fault_t ret = VM_FAULT_SIGBUS;
+
+    // страница вставляется под блокировкой: замена подобласти снимет ее вместе с остальными
+    down_read(&con->m_mem_sem);
+    struct sub_mem_t *sub = con->m_mem_p;
+
+    if (!sub || connection_vma_revoked(con, vma))
+        goto out;
+
+    // половина ответа лежит в середине отображения, а в подобласти - сразу после половины запроса
+    off = connection_sub_offset(con, sub, off);
+
+    // обращение за пределами половины, еще не выросшей до ограничения сервера
+    if (off >= sub->m_size)
+        goto out;
+
+    ret = vmf_insert_mixed(vma, vmf->address, pfn_to_pfn_t(submem_pfn(sub, off)));
+
+out:
+    up_read(&con->m_mem_sem);
+    return ret;
+}
+
+// подобласть на огромной странице - одной записью PMD, если процесс выровнял адрес отображения
+static vm_fault_t connection_vm_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+    vm_fault_t ret = VM_FAULT_FALLBACK;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    struct vm_area_struct *vma = vmf->vma;
+    struct connection_t *con = vma->vm_private_data;
+    unsigned long addr = vmf->address & HPAGE_PMD_MASK;
+
+    if (order != HPAGE_PMD_ORDER || SHM_HUGE_REGION_SIZE != HPAGE_PMD_SIZE || addr != vma->vm_start ||
+        vma->vm_end - vma->vm_start != HPAGE_PMD_SIZE)
+        return ret;
+
+    down_read(&con->m_mem_sem);
+    struct sub_mem_t *sub = con->m_mem_p;
+    if (sub && sub->m_shm->m_class == SHM_HUGE_CLASS && !connection_vma_revoked(con, vma))
+        ret = vmf_insert_pfn_pmd(vmf, pfn_to_pfn_t(page_to_pfn(sub->m_page)), vmf->flags & FAULT_FLAG_WRITE);
+    up_read(&con->m_mem_sem);
+#endif
+    return ret;
+}
+
+static const struct vm_operations_struct connection_vm_ops = {
+    .open = connection_vm_open,
+    .close = connection_vm_close,
+    .may_split = connection_vm_may_split,
+    .fault = connection_vm_fault,
+    .huge_fault = connection_vm_huge_fault,
+};
+
+int connection_mmap(struct connection_t *con, struct vm_area_struct *vma)
+{
+    if (!con || !vma)
+    {
+        ERR("There is not connection or vma");
+        return -EINVAL;
+    }
+
+    // отображение резервирует место под выросшую область, но не больше ограничения сервера
+    unsigned long size = vma->vm_end - vma->vm_start;
+    if (size > connection_region_limit(con))
+    {
+        ERR("Requested mapping (%lu bytes) is bigger than region limit (%zu bytes)", size,
+            connection_region_limit(con));
+        return -EINVAL;
+    }
+
+    // копия при записи отвязала бы процесс от соседа
+    if (!(vma->vm_flags & VM_SHARED))
+    {
+        ERR("Connection memory can be mapped only shared");
+        return -EINVAL;
+    }
+
+    // страницы подставляются при первом обращении из текущей подобласти соединения
+    WRITE_ONCE(con->m_mapping, vma->vm_file->f_mapping);
+    vm_flags_set(vma, VM_MIXEDMAP | VM_DONTEXPAND | VM_DONTDUMP);
+    if (con->m_server_p->m_flags & SERVER_FLAG_HUGE_PAGES)
+        vm_flags_set(vma, VM_HUGEPAGE);
+    vma->vm_private_data = con;
+    vma->vm_ops = &connection_vm_ops;
+    connection_vm_open(vma);
+    return 0;
+}
+
+void connection_client_mapped(struct connection_t *con)
+{
+    // чтобы сервер не удалился или не изменился, пока уведомление отправляется
+    mutex_lock(&con->m_server_p->m_lock);
+
+    if (notification_send(CLIENT, NEW_CONNECTION, con) != 0)
+        ERR("notification sending failed");
+
+    // устанавливаем флаг в значение: память отображена на сервере
+    atomic_set(&con->m_serv_mmaped, 1);
+    mutex_unlock(&con->m_server_p->m_lock);
+}
+
+int connection_resize_region(struct connection_t *con, size_t size)
+{
+    struct sub_mem_t *old, *new;
+    int ret;
+
+    if (!con)
+    {
+        ERR("NULL connection");
+        return -EINVAL;
+    }
+
+    if (size > connection_region_limit(con))
+    {
+        ERR("Requested region size (%zu bytes) is bigger than region limit (%zu bytes)", size,
+            connection_region_limit(con));
+        return -EINVAL;
+    }
+
+    down_write(&con->m_mem_sem);
+    old = con->m_mem_p;
+    if (!old || atomic_read(&con->m_closed))
+    {
+        ERR("Connection is closed");
+        ret = -ENOENT;
+        goto out;
+    }
+
+    // области уже хватает; подобласть на огромной странице занимает ее целиком и не растет
+    if (size <= old->m_size || old->m_shm->m_class == SHM_HUGE_CLASS)
+    {
+        ret = old->m_size;
+        goto out;
+    }
+
+    // огромных страниц не нашлось при подключении, а обычные подобласти ограничены SHM_REGION_MAX_SIZE
+    if (size > SHM_REGION_MAX_SIZE)
+    {
+        ERR("Regular sub mem cant be bigger than %lu bytes", (unsigned long)SHM_REGION_MAX_SIZE);
+        ret = -EINVAL;
+        goto out;
+    }
+
+    new = get_free_submem(con->m_server_p->m_numa_node, size);
+    if (!new)
+    {
+        ERR("There is no free sub mem (SIZE: %zu)", size);
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    // стороны больше не видят старую подобласть: перенос данных ни с кем не гоняется;
+    // половины запроса и ответа переносятся каждая в начало своей половины
+    connection_unmap(con, old);
+    memcpy(new->m_vaddr, old->m_vaddr, SHM_RESPONSE_OFFSET(old->m_size));
+    memcpy(new->m_vaddr + SHM_RESPONSE_OFFSET(new->m_size), old->m_vaddr + SHM_RESPONSE_OFFSET(old->m_size),
+           SHM_RESPONSE_OFFSET(old->m_size));
+    submem_publish_size(new);
+
+    INF("Region of connection btw client %d and server %d grown (ID: %d)(%zu -> %zu bytes)",
+        con->m_client_p->m_id, con->m_server_p->m_id, old->m_id, old->m_size, new->m_size);
+
+    submem_replace(&con->m_mem_p, new);
+    ret = new->m_size;
+
+out:
+    up_write(&con->m_mem_sem);
+    return ret;
+}
+
+int connection_migrate(struct connection_t *con, struct server_t *target)
+{
+    struct server_t *old = con->m_server_p;
+    struct serv_conn_list_t *entry;
+    struct shm_doorbell *db;
+    struct sub_mem_t *sub;
+    bool in_flight = false;
+    int ret = 0;
+
+    // подстановка страниц, рост области и закрытие соединения ждут конца передачи
+    down_write(&con->m_mem_sem);
+    sub = con->m_mem_p;
+    if (atomic_read(&con->m_closed) || !sub)
+    {
+        ret = -ENOENT;
+        goto out;
+    }
+
+    // на запрос в работе может ответить только текущий сервер
+    db = sub->m_vaddr;
+    if (READ_ONCE(db->m_req_seq) != READ_ONCE(db->m_resp_seq))
+    {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    // старый сервер теряет страницы подобласти, повторно они ему не подставятся
+    if (READ_ONCE(con->m_mapping))
+        unmap_mapping_range(con->m_mapping, (loff_t)pack_ids(old->m_id, sub->m_id) << PAGE_SHIFT,
+                            connection_region_limit(con), 1);
+
+    // клиент, видящий флаг опроса старого сервера, не уведомлял бы драйвер
+    WRITE_ONCE(db->m_server_polling, 0);
+
+    // запись в списке старого сервера заменяется записью у нового
+    mutex_lock(&old->m_con_list_lock);
+    entry = con->m_srv_conn;
+    if (entry)
+        list_del(&entry->list);
+    con->m_srv_conn = NULL;
+    mutex_unlock(&old->m_con_list_lock);
+    if (entry)
+        server_conn_entry_free(old, entry);
+
+    server_get(target);
+    WRITE_ONCE(con->m_server_p, target);
+    server_add_connection(target, con);
+
+    // дескриптор старого сервера больше не получает уведомлений соединения
+    conn_file_detach(con, SERVER);
+
+    // старый сервер остается зарегистрированным: его держат таблицы серверов
+    server_put(old);
+
+    // звонок читается, пока подобласть не может уйти другому соединению. Запрос, записанный позже,
+    // клиент объявит уже новому серверу: m_server_p сменился под этой же блокировкой
+    in_flight = READ_ONCE(db->m_req_seq) != READ_ONCE(db->m_resp_seq);
+
+    INF("Connection of client %d moved from server %d to server %d (SUB MEM ID: %d)", con->m_client_p->m_id,
+        old->m_id, target->m_id, sub->m_id);
+
+out:
+    up_write(&con->m_mem_sem);
+    if (ret)
+        return ret;
+
+    // новый сервер отображает область по уведомлению
+    if ((ret = notification_send(CLIENT, NEW_CONNECTION, con)) != 0)
+        ERR("Failed to notify server (ID:%d) about moved connection", target->m_id);
+
+    // запрос, отправленный клиентом во время передачи, мог уйти старому серверу (повтор сервер отбросит по номеру);
+    // иначе ответ уже лежит в области, а разбудить клиента старый сервер больше не сможет.
+    // Соединение держит ссылка вызывающего; если его уже закрыли, уведомления просто не доставятся
+    if (in_flight)
+        notification_send(CLIENT, NEW_MESSAGE, con);
+    else
+        client_call_complete(con->m_client_p, CLIENT_CALL_REPLIED);
+    return ret;
+}
+
+// процесс reg_task - клиент соединения, и его запрос еще обрабатывает сервер
+static bool connection_client_busy(struct connection_t *con, struct sub_mem_t *sub, struct reg_task_t *reg_task)
+{
+    struct shm_doorbell *db = sub->m_vaddr;
+    return con->m_client_p->m_task_p->m_reg_task == reg_task &&
+           READ_ONCE(db->m_req_seq) != READ_ONCE(db->m_resp_seq);
+}
+
+int connection_swap_regions(struct connection_t *a, struct connection_t *b, struct reg_task_t *reg_task)
+{
+    struct connection_t *first = a < b ? a : b;
+    struct connection_t *second = a < b ? b : a;
+    struct shm_doorbell db_a, db_b;
+    struct sub_mem_t *sa, *sb;
+    int ret = 0;
+
+    if (a == b)
+        return -EINVAL;
+
+    // порядок захвата по адресу: встречный обмен тех же соединений не заблокируется
+    down_write(&first->m_mem_sem);
+    down_write_nested(&second->m_mem_sem, SINGLE_DEPTH_NESTING);
+    sa = a->m_mem_p;
+    sb = b->m_mem_p;
+    if (atomic_read(&a->m_closed) || atomic_read(&b->m_closed) || !sa || !sb)
+    {
+        ret = -ENOENT;
+        goto out;
+    }
+
+    // данные меняются целиком, поэтому подобласти должны совпадать по размеру и виду памяти
+    if (sa->m_size != sb->m_size || sa->m_shm->m_class != sb->m_shm->m_class)
+    {
+        ERR("Cant swap regions of different size (%zu and %zu bytes)", sa->m_size, sb->m_size);
+        ret = -EINVAL;
+        goto out;
+    }
+
+    // сервер, еще работающий над запросом процесса, пишет в свою подобласть
+    if (connection_client_busy(a, sa, reg_task) || connection_client_busy(b, sb, reg_task))
+    {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    // все стороны теряют страницы: при следующем обращении подставятся из новой подобласти
+    connection_unmap(a, sa);
+    connection_unmap(b, sb);
+
+    // счетчики и флаги остаются у соединения, описания сообщений переходят вместе с данными
+    memcpy(&db_a, sa->m_vaddr, sizeof(db_a));
+    memcpy(&db_b, sb->m_vaddr, sizeof(db_b));
+    swap(db_a.m_request, db_b.m_request);
+    swap(db_a.m_response, db_b.m_response);
+    memcpy(sb->m_vaddr, &db_a, sizeof(db_a));
+    memcpy(sa->m_vaddr, &db_b, sizeof(db_b));
+
+    submem_swap(&a->m_mem_p, &b->m_mem_p);
+
+    INF("Regions of connections (SUB MEM ID: %d) and (SUB MEM ID: %d) swapped (%zu bytes)", sb->m_id, sa->m_id,
+        sa->m_size);
+
+out:
+    up_write(&second->m_mem_sem);
+    up_write(&first->m_mem_sem);
+    return ret;
+}
+
 // отсоединение sub_mem от соединения
 static void safe_disconnect_submem(struct connection_t *conn)
 {
-    if (conn && conn->m_mem_p)
+    if (!conn)
+        return;
+
+    // ожидание текущих обращений к страницам и роста области
+    down_write(&conn->m_mem_sem);
+    if (conn->m_mem_p)
     {
         struct sub_mem_t *sub = conn->m_mem_p;
         INF("Disconnecting sub_mem %d from conn %p", sub->m_id, conn);
+
+        // подобласть достанется другому соединению: у сторон не должно остаться ее страниц
+        connection_unmap(conn, sub);
         if (sub->m_conn_p == conn)
         {
-            sub->m_conn_p = NULL; // Помечаем sub_mem как свободную
+            submem_release(sub); // Помечаем sub_mem как свободную
         }
         else
         {
             INF("sub_mem %d connection pointer mismatch!", sub->m_id);
         }
-        conn->m_mem_p = NULL; // Убираем ссылку из соединения
+        WRITE_ONCE(conn->m_mem_p, NULL); // Убираем ссылку из соединения
     }
+    up_write(&conn->m_mem_sem);
 }
 
 // удаление соединения
@@ -112,6 +619,13 @@ void delete_connection(struct connection_t *conn)
 
     int ret = 0;
 
+    // соединение закрывают и клиент, и сервер: работу выполняет первый
+    if (atomic_xchg(&conn->m_closed, 1))
+    {
+        INF("Connection is already being deleted");
+        return;
+    }
+
     INF("Deleting connection: ClientID=%d, ServerID=%d, SubMemID=%d",
         conn->m_client_p ? conn->m_client_p->m_id : -1,
         conn->m_server_p ? conn->m_server_p->m_id : -1,
@@ -129,6 +643,13 @@ void delete_connection(struct connection_t *conn)
         ERR("Bad notification sending to client. code: %d", ret);
     }
 
+    // запросы клиента могли уходить другим участникам группы: они тоже забывают соединение
+    server_route_notify(conn->m_server_p, REMOTE_DISCONNECT, conn);
+
+    // REMOTE_DISCONNECT уже лежит в дескрипторах сторон: после него read вернет конец файла
+    conn_file_detach(conn, CLIENT);
+    conn_file_detach(conn, SERVER);
+
     // Отсоединяем sub_mem
     safe_disconnect_submem(conn);
 
@@ -139,10 +660,13 @@ void delete_connection(struct connection_t *conn)
     // отсоединение от клиента
     if (conn->m_client_p)
     {
+        // будим клиента, если он ждет ответа в синхронном вызове
+        client_call_complete(conn->m_client_p, CLIENT_CALL_ABORTED);
+
         // Сервер ушел, уведомляем клиента
         if (conn->m_client_p->m_conn_p == conn)
         {
-            conn->m_client_p->m_conn_p = NULL;
+            RCU_INIT_POINTER(conn->m_client_p->m_conn_p, NULL);
             INF("Cleared connection pointer in client %d", conn->m_client_p->m_id);
         }
         else
@@ -150,7 +674,7 @@ void delete_connection(struct connection_t *conn)
             // Этого не должно быть, если указатели синхронны
             INF("Connection points to client %d, but client points elsewhere!", conn->m_client_p->m_id);
         }
-        conn->m_client_p = NULL; // Обнуляем в соединении
+        // указатель на клиента остается до освобождения соединения вместе со ссылкой на него
     }
 
     // отсоединение от сервера
@@ -159,13 +683,15 @@ void delete_connection(struct connection_t *conn)
         // Клиент ушел, уведомляем сервер и удаляем из его списка
         struct serv_conn_list_t *srv_conn_entry;
         INF("Removing connection from server %d's list", conn->m_server_p->m_id);
-        srv_conn_entry = server_find_conn(conn->m_server_p, conn); // Находим запись в списке сервера
 
+        // запись читается под блокировкой списка, ее может удалить и server_cleanup_connection
         mutex_lock(&conn->m_server_p->m_con_list_lock);
+        srv_conn_entry = conn->m_srv_conn;
         if (srv_conn_entry)
         {
             list_del(&srv_conn_entry->list); // Удаляем из списка сервера
-            kfree(srv_conn_entry);           // Освобождаем элемент списка
+            conn->m_srv_conn = NULL;
+            server_conn_entry_free(conn->m_server_p, srv_conn_entry); // Освобождаем элемент списка
             INF("Connection removed from server %d list.", conn->m_server_p->m_id);
         }
         else
@@ -173,20 +699,16 @@ void delete_connection(struct connection_t *conn)
             INF("Connection not found in server %d's list!", conn->m_server_p->m_id);
         }
         mutex_unlock(&conn->m_server_p->m_con_list_lock);
-        conn->m_server_p = NULL; // Обнуляем в соединении
     }
 
     // удаление из общего списка
     mutex_lock(&g_conns_lock);
-    list_del(&conn->list);
+    list_del_rcu(&conn->list);
     INF("deleted conn from list");
     mutex_unlock(&g_conns_lock);
 
-    // очистка памяти
-    kfree(conn);
-
-    conn = NULL;
-    INF("Connection structure freed.");
+    // снимаем ссылку связи: память освободится, когда ее отпустят текущие запросы
+    connection_put(conn);
 }
 
 void delete_connection_list(void)
@@ -4,24 +4,59 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/atomic.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/rwsem.h>
+#include <linux/spinlock.h>
 
 #include "client.h"
+#include "ripc.h"
 #include "server.h"
 #include "shm.h"
 
+/**
+ * Структура отправленного уведомления (слот в соединении, владелец - m_conn)
+ */
+struct notification_t
+{
+    struct notification_data data;
+    struct connection_t *m_conn; // соединение, в котором лежит слот
+    int m_slot;                  // номер слота в соединении
+    struct list_head list;
+};
+
+// Слот на каждую пару (отправитель, тип): одинаковые уведомления одного соединения склеиваются
+#define CONN_NOTIF_SLOTS ((SENDER_MAX - 1) * (TYPE_MAX - 1))
+#define CONN_NOTIF_SLOT(sender, type) (((sender) - 1) * (TYPE_MAX - 1) + ((type) - 1))
+
 /**
  * Структура, описывающая соединение клиента и сервера
  */
 struct connection_t
 {
-    struct client_t *m_client_p;
-    struct server_t *m_server_p;
-    struct sub_mem_t *m_mem_p;
+    struct client_t *m_client_p;         // клиент (соединение держит на него ссылку)
+    struct server_t *m_server_p;         // сервер (соединение держит на него ссылку)
+    struct sub_mem_t *m_mem_p;           // подобласть, NULL после закрытия соединения
+    struct rw_semaphore m_mem_sem;       // замена подобласти (запись) против подстановки ее страниц (чтение)
+    struct address_space *m_mapping;     // отображения устройства, в которых лежит подобласть
+    struct serv_conn_list_t *m_srv_conn; // запись соединения в списке сервера
     atomic_t m_serv_mmaped; // отображена ли общая память на сервер
+    atomic_t m_closed;      // соединение закрыто (delete_connection уже вызван)
+    struct kref m_ref;      // счетчик ссылок: связь клиента с сервером и текущие запросы
+    struct rcu_head m_rcu;  // отложенное освобождение после читателей
     struct list_head list;
+
+    // уведомления, не поместившиеся в кольцо процесса, лежат здесь: отправка не выделяет память
+    struct notification_t m_notif_slots[CONN_NOTIF_SLOTS];
+    unsigned long m_notif_busy; // занятые слоты (битовая маска)
+
+    // дескрипторы сторон (conn_file_t): уведомления стороны с дескриптором уходят в него, а не процессу
+    spinlock_t m_file_lock;
+    struct conn_file_t *m_client_file;
+    struct conn_file_t *m_server_file;
 };
 
-// Список соединений и его блокировка
+// Список соединений: изменяется под g_conns_lock, читается под RCU
 extern struct list_head g_conns_list;
 extern struct mutex g_conns_lock;
 
@@ -29,20 +64,81 @@ extern struct mutex g_conns_lock;
  * Операции над объектом соединения
  */
 
+// создание и удаление кэша объектов соединений (при загрузке и выгрузке модуля)
+int connection_cache_create(void);
+void connection_cache_destroy(void);
+
 // создание соединения
 struct connection_t *create_connection(
     struct client_t *client,
     struct server_t *server,
     struct sub_mem_t *mem);
 
-// поиск соединения между двумя процессами
+// поиск соединения между двумя процессами, возвращает соединение со ссылкой
 struct connection_t *find_connection(
     struct task_struct *task1,
     struct task_struct *task2);
 
-// удаление соединения
+/**
+ * @brief Закрытие соединения: уведомляет стороны, освобождает подобласть и отвязывает клиента и сервер.
+ * Повторный вызов ничего не делает. Вызывающий должен держать ссылку на соединение.
+ */
 void delete_connection(struct connection_t *con);
 
+/**
+ * @brief Захват ссылки на соединение, найденное под rcu_read_lock
+ * @return struct connection_t* con или NULL, если соединение уже закрыто
+ */
+struct connection_t *connection_tryget(struct connection_t *con);
+
+// освобождение ссылки на соединение
+void connection_put(struct connection_t *con);
+
+/**
+ * @brief Выбор участника группы с маршрутизацией по URL текущего запроса соединения
+ * @return struct server_t* сервер со ссылкой (освобождается через server_put) или NULL - запрос остается у сервера соединения
+ */
+struct server_t *connection_route_request(struct connection_t *con);
+
+/**
+ * Отображение памяти соединения
+ */
+
+// размер отображения памяти соединения: область может вырасти до ограничения сервера
+size_t connection_region_limit(struct connection_t *con);
+
+/**
+ * @brief Отображение области соединения в процесс. Страницы подставляются при первом обращении
+ * из текущей подобласти соединения, поэтому отображение переживает ее замену при росте.
+ * @return int 0 - успех, <0 - ошибка
+ */
+int connection_mmap(struct connection_t *con, struct vm_area_struct *vma);
+
+// клиент отобразил область: сервер получает NEW_CONNECTION
+void connection_client_mapped(struct connection_t *con);
+
+/**
+ * @brief Увеличение области соединения до size байт: данные переносятся в подобласть большего порядка,
+ * id подобласти не меняется, отображения сторон перестраиваются при следующем обращении.
+ * @return int текущий размер области (>0) или ошибка (<0)
+ */
+int connection_resize_region(struct connection_t *con, size_t size);
+
+/**
+ * @brief Передача соединения другому серверу той же группы. Клиент продолжает работать с той же областью,
+ * старый сервер теряет ее отображение, новый получает NEW_CONNECTION. Вызывающий держит ссылку на соединение.
+ * @return int 0 - успех, -EBUSY - запрос клиента еще в работе, <0 - ошибка
+ */
+int connection_migrate(struct connection_t *con, struct server_t *target);
+
+/**
+ * @brief Обмен областями двух соединений процесса reg_task без копирования данных: страницы подставляются
+ * сторонам заново, счетчики управляющего блока остаются у соединений, описания сообщений - у данных.
+ * Так прокси передает запрос следующему серверу и получает его ответ обратно.
+ * @return int 0 - успех, -EINVAL - разные размеры областей, -EBUSY - запрос процесса еще обрабатывается
+ */
+int connection_swap_regions(struct connection_t *a, struct connection_t *b, struct reg_task_t *reg_task);
+
 /**
  * Операции над глобальным списком серверов
  */
@@ -6,15 +6,18 @@ DEFINE_ID_GENERATOR(g_id_gen);
 int generate_id(struct ida *name)
 {
     // Используем ida_alloc_range для ограничения максимального значения ID
-    // Диапазон [0, MAX_ID_VALUE] включительно.
-    int id = ida_alloc_range(name, 0, MAX_ID_VALUE, GFP_KERNEL);
+    // Диапазон [1, MAX_ID_VALUE - 1] включительно: MAX_ID_VALUE зарезервирован
+    // под отображение кольца уведомлений (NOTIF_RING_MMAP_ID), а 0 означает
+    // "без подобласти" в запакованных id (client_id, 0) - подобласти создаются
+    // при загрузке модуля и иначе могли бы получить его.
+    int id = ida_alloc_range(name, 1, MAX_ID_VALUE - 1, GFP_KERNEL);
 
     if (id < 0)
     {
         // -ENOSPC означает, что в заданном диапазоне нет свободных ID
         if (id == -ENOSPC)
         {
-            ERR("Cannot allocate ID: No free IDs in range [0, %u]", MAX_ID_VALUE);
+            ERR("Cannot allocate ID: No free IDs in range [1, %u]", MAX_ID_VALUE - 1);
         }
         else
         {
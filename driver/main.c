@@ -1,5 +1,7 @@
 #include "../include/ripc.h" // константы для драйвера
+#include "channel.h"    // каналы публикации
 #include "client.h"
+#include "conn_file.h"  // дескрипторы соединений
 #include "connection.h" // объект соединения
 #include "err.h"        // макросы для логов
 #include "server.h"
@@ -37,6 +39,97 @@ static dev_t g_dev_num;           // Номер устройства (major+mino
 static struct class *g_dev_class; // Класс устройства
 static struct cdev g_cdev;        // Структура символьного устройства
 
+/**
+ * @brief Оповещение клиента о готовом ответе сервера в подобласти sub_mem_id
+ * @return int 0 - успех, <0 - ошибка
+ */
+static int server_reply(struct server_t *server, int sub_mem_id)
+{
+    int ret = 0;
+
+    // поиск нужного соединения: в группе с маршрутизацией отвечает участник, получивший запрос
+    struct connection_t *conn = server_get_routed_conn_by_sub_mem_id(server, sub_mem_id);
+
+    // если нет соединения с этой памятью
+    if (!conn)
+    {
+        ERR("There is no connection btw server (ID:%d) and sub_mem (ID:%d)", server->m_id, sub_mem_id);
+        return -ENOENT;
+    }
+
+    // получаем клиент (соединение держит на него ссылку)
+    struct client_t *client = conn->m_client_p;
+
+    // Если нет указателя на клиент
+    if (!client)
+    {
+        ERR("Ivalid connection object: null client ptr (SERVER ID:%d) (SUB MEM ID: %d)", server->m_id, sub_mem_id);
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    // если клиент спит в IOCTL_CLIENT_CALL, будим его напрямую, без уведомления
+    if (client_call_complete(client, CLIENT_CALL_REPLIED))
+    {
+        INF("Client %d woken up directly", client->m_id);
+        goto out;
+    }
+
+    if ((ret = notification_send(SERVER, NEW_MESSAGE, conn)) != 0)
+    {
+        ERR("sending notif failed");
+    }
+
+out:
+    connection_put(conn);
+    return ret;
+}
+
+/**
+ * @brief Поиск соединения по запакованным id {(client_id, 0) or (server_id, sub_mem_id)}.
+ * Клиент или сервер должен быть зарегистрирован через то же открытое устройство reg_task.
+ * @return struct connection_t* соединение со ссылкой или NULL (код ошибки в *err)
+ */
+static struct connection_t *find_conn_by_packed_id(u32 packed_id, struct reg_task_t *reg_task, int *err)
+{
+    struct connection_t *conn = NULL;
+    int id, sub_mem_id;
+
+    UNPACK_SC_SHM(packed_id, id, sub_mem_id);
+
+    // для клиента передается (client_id, 0)
+    if (sub_mem_id == 0)
+    {
+        struct client_t *client = find_client_by_id_owner(id, reg_task);
+        conn = client ? client_get_connection(client) : NULL;
+        client_put(client);
+        if (!conn)
+        {
+            ERR("There is no connected client with id %d", id);
+            *err = -ENOENT;
+        }
+        return conn;
+    }
+
+    // запрос приходит от процесса сервера
+    struct server_t *server = find_server_by_id_owner(id, reg_task);
+    if (!server)
+    {
+        ERR("There is no server with id %d", id);
+        *err = -ENODATA;
+        return NULL;
+    }
+
+    conn = server_get_routed_conn_by_sub_mem_id(server, sub_mem_id);
+    if (!conn)
+    {
+        ERR("There is no connection btw server (ID:%d) and sub_mem (ID:%d)", id, sub_mem_id);
+        *err = -ENOENT;
+    }
+    server_put(server);
+    return conn;
+}
+
 /**
  * Обработчик ioctl()
  */
@@ -47,7 +140,7 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     struct server_t *server = NULL;
     struct client_t *client = NULL;
     struct connection_t *conn = NULL;
-    struct serv_conn_list_t *scon = NULL;
+    struct sub_mem_t *sub = NULL;
     int sub_mem_id;
     int server_id;
     int ret = 0;
@@ -58,6 +151,31 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     // для подключения клиента к серверу
     struct connect_to_server con;
 
+    // для синхронного вызова
+    struct client_call call;
+
+    // для ответа и приема следующего запроса сервером
+    struct server_reply_recv rr;
+
+    // для роста области соединения
+    struct region_resize rs;
+
+    // для передачи соединения другому серверу
+    struct server_migrate mg;
+    struct server_t *target = NULL;
+
+    // для обмена областями двух соединений
+    struct region_swap sw;
+    struct connection_t *peer = NULL;
+
+    // для каналов публикации
+    struct channel_subscribe cs;
+    struct channel_publish cp;
+    struct queue_wait qw;
+
+    // для дескрипторов соединений
+    struct server_accept sa;
+
     // если нет описания структуры, то выходим
     if (!reg_task)
     {
@@ -83,34 +201,63 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (!reg_task_can_add_server(reg_task))
         {
             ERR("cannot add server to PID");
-            return -ENOSPC;
+            ret = -ENOSPC;
+            goto out;
         }
 
         // копируем имя из userspace
         if (copy_from_user(&reg, (void __user *)arg, sizeof(reg)))
         {
             ERR("copy_from_user failed\n");
-            return -EFAULT;
+            ret = -EFAULT;
+            goto out;
         }
 
-        // ищем сервер по имени
+        // ищем сервер по имени: занятое имя можно разделить только с группой
         server = find_server_by_name(reg.name);
-        if (server)
+        if (server && !((reg.flags & SERVER_FLAG_GROUP) && server->m_group))
         {
             ERR("server already exists: %d:%s", server->m_id, server->m_name);
-            return -EEXIST;
+            ret = -EEXIST;
+            goto out;
+        }
+        server_put(server);
+        server = NULL;
+
+        // узел NUMA должен существовать и иметь память
+        if (reg.numa_node != SERVER_NUMA_NODE_AUTO && !shm_node_valid(reg.numa_node))
+        {
+            ERR("incorrect NUMA node: %d", reg.numa_node);
+            ret = -EINVAL;
+            goto out;
         }
 
         // создаем сервер
-        server = server_create(reg.name);
+        reg.route_prefix[MAX_ROUTE_PREFIX - 1] = '\0';
+        server = server_create(reg.name, reg.max_region_size, reg.flags, reg.numa_node, reg.route_prefix);
+        if (!server)
+        {
+            ERR("cant create server: %s", reg.name);
+            server = find_server_by_name(reg.name);
+            ret = server ? -EEXIST : -ENOMEM;
+            goto out;
+        }
 
+        // ссылка на время обработки команды (список серверов держит свою)
+        server_get(server);
+
+        // возвращаем id и фактическое ограничение размера подобласти
         reg.server_id = server->m_id;
+        reg.max_region_size = server->m_max_region_size;
+        reg.flags = server->m_flags;
+        reg.numa_node = server->m_numa_node;
 
         // отправляем id обратно в userspace
         if (copy_to_user((void __user *)arg, &reg, sizeof(reg)))
         {
             ERR("cant sand back server's id: %d:%s", server->m_id, server->m_name);
-            return -EFAULT;
+            ret = -EFAULT;
+            goto out;
         }
 
         // регистрируем сервер в процессе
@@ -136,17 +283,28 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (!reg_task_can_add_client(reg_task))
         {
             ERR("cannot add client to PID");
-            return -ENOSPC;
+            ret = -ENOSPC;
+            goto out;
         }
 
         // создали новго клиента
         client = client_create();
+        if (!client)
+        {
+            ERR("REGISTER_CLIENT: cant create client");
+            ret = -ENOMEM;
+            goto out;
+        }
+
+        // ссылка на время обработки команды (список клиентов держит свою)
+        client_get(client);
 
         // отправляем id обратно в userspace
         if (copy_to_user((void __user *)arg, &client->m_id, sizeof(client->m_id)))
         {
             ERR("REGISTER_CLIENT: cant sand back clients's id: %d", client->m_id);
-            return -EFAULT;
+            ret = -EFAULT;
+            goto out;
         }
 
         // регистрируем клиент в процессе
@@ -171,36 +329,78 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (copy_from_user(&con, (void __user *)arg, sizeof(con)))
         {
             ERR("CONNECT_TO_SERVER: copy_from_user failed\n");
-            return -EFAULT;
+            ret = -EFAULT;
+            goto out;
         }
 
         // ищем клиента с con.id
         client = find_client_by_id(con.client_id);
+        if (!client)
+        {
+            ERR("CONNECT_TO_SERVER: there is no client with id: %d", con.client_id);
+            ret = -ENOENT;
+            goto out;
+        }
 
         // если клиент подключен к серверу, то выходим
-        if (client->m_conn_p)
+        if (READ_ONCE(client->m_conn_p))
         {
             INF("CONNECT_TO_SERVER: client %d already connected to server %s", con.client_id, con.server_name);
-            return -EEXIST;
+            ret = -EEXIST;
+            goto out;
         }
 
-        // ищем сервер с подходящим именем
-        server = find_server_by_name(con.server_name);
+        // ищем сервер с подходящим именем (в группе - участника, которому достается подключение)
+        server = pick_server_by_name(con.server_name);
 
         // если не нашли сервер
         if (!server)
         {
             ERR("CONNECT_TO_SERVER: there is no server with name: %s", con.server_name);
-            return -ENODATA;
+            ret = -ENODATA;
+            goto out;
         }
 
         // подключаем клиента к серверу
-        ret = connect_client_to_server(server, client);
+        ret = connect_client_to_server(server, client, con.region_size);
 
         if (ret != 0)
         {
             ERR("CONNECT_TO_SERVER: connect_client_to_server: %d", ret);
-            return ret;
+            goto out;
+        }
+
+        // соединение могли разорвать сразу после создания
+        conn = client_get_connection(client);
+        if (!conn)
+        {
+            ERR("CONNECT_TO_SERVER: connection is already closed (CLIENT ID:%d)", client->m_id);
+            ret = -ECONNRESET;
+            goto out;
+        }
+
+        // отправляем выделенный размер подобласти обратно в userspace
+        con.region_size = conn->m_mem_p->m_size;
+
+        // уведомления клиента будут приходить в его дескриптор соединения
+        con.conn_fd = -1;
+        if (con.flags & CONNECT_FLAG_FD)
+        {
+            con.conn_fd = conn_file_create(conn, CLIENT, filp);
+            if (con.conn_fd < 0)
+            {
+                ERR("CONNECT_TO_SERVER: cant create connection file (CLIENT ID:%d)", client->m_id);
+                ret = con.conn_fd;
+                goto out;
+            }
+        }
+
+        // дескриптор уже установлен: при ошибке копирования процесс закроет его вместе с остальными
+        if (copy_to_user((void __user *)arg, &con, sizeof(con)))
+        {
+            ERR("CONNECT_TO_SERVER: cant send back region size (CLIENT ID:%d)", client->m_id);
+            ret = -EFAULT;
+            goto out;
         }
         break;
 
@@ -217,26 +417,26 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (!client)
         {
             ERR("There is no client with id %d", id);
-            return -ENODATA;
+            ret = -ENODATA;
+            goto out;
         }
 
-        conn = client->m_conn_p;
+        conn = client_get_connection(client);
 
         // если есть клиент, но он не подключен
         if (!conn)
         {
             ERR("There is no connection in client (ID:%d)", id);
-            return -ENOENT;
+            ret = -ENOENT;
+            goto out;
         }
 
-        // получаем сервер
-        server = conn->m_server_p;
-
         // Если нет указателя на сервер
-        if (!server)
+        if (!conn->m_server_p)
         {
             ERR("Ivalid connection object: null server ptr (CLIENT ID:%d)", client->m_id);
-            return -ENOMEM;
+            ret = -ENOMEM;
+            goto out;
         }
 
         // отправка уведомления
@@ -259,33 +459,102 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         // если сервер не найден
         if (!server)
         {
-            ERR("There is no server with id %d", id);
-            return -ENODATA;
+            ERR("There is no server with id %d", server_id);
+            ret = -ENODATA;
+            goto out;
         }
 
-        // поиск нужного соединения
-        conn = server_find_conn_by_sub_mem_id(server, sub_mem_id)->conn;
+        // отправка ответа клиенту
+        ret = server_reply(server, sub_mem_id);
+        break;
 
-        // если нет соединения с этой памятью
-        if (!conn)
+    case IOCTL_CLIENT_CALL:
+
+        INF("IOCTL_CLIENT_CALL");
+        if (copy_from_user(&call, (void __user *)arg, sizeof(call)))
         {
-            ERR("There is no connection btw server (ID:%d) and sub_mem (ID:%d)", server_id, sub_mem_id);
-            return -ENOENT;
+            ERR("CLIENT_CALL: copy_from_user failed");
+            ret = -EFAULT;
+            goto out;
         }
 
-        // получаем клиент
-        client = conn->m_client_p;
-
-        // Если нет указателя на клиент
+        // поиск нужного клиента
+        client = find_client_by_id_pid(call.client_id, current->pid);
         if (!client)
         {
-            ERR("Ivalid connection object: null client ptr (SERVER ID:%d) (SUB MEM ID: %d)", server_id, sub_mem_id);
-            return -ENOMEM;
+            ERR("There is no client with id %d", call.client_id);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        conn = client_get_connection(client);
+        if (!conn || !conn->m_server_p)
+        {
+            ERR("There is no connection in client (ID:%d)", call.client_id);
+            ret = -ENOENT;
+            goto out;
         }
 
-        if ((ret = notification_send(SERVER, NEW_MESSAGE, conn)) != 0)
+        // состояние выставляется до отправки, чтобы не пропустить быстрый ответ
+        if (atomic_cmpxchg(&client->m_call_state, CLIENT_CALL_IDLE, CLIENT_CALL_WAITING) != CLIENT_CALL_IDLE)
+        {
+            ERR("Client %d is already waiting for response", call.client_id);
+            ret = -EBUSY;
+            goto out;
+        }
+
+        // отправка уведомления серверу
+        if ((ret = notification_send(CLIENT, NEW_MESSAGE, conn)) != 0)
         {
             ERR("sending notif failed");
+            atomic_set(&client->m_call_state, CLIENT_CALL_IDLE);
+            goto out;
+        }
+
+        // ждем IOCTL_SERVER_END_WRITING по этому соединению (ссылки держатся на время сна)
+        ret = client_call_wait(client, call.timeout_ms);
+        break;
+
+    case IOCTL_SERVER_REPLY_RECV:
+
+        INF("IOCTL_SERVER_REPLY_RECV");
+        if (copy_from_user(&rr, (void __user *)arg, sizeof(rr)))
+        {
+            ERR("SERVER_REPLY_RECV: copy_from_user failed");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // поиск нужного сервера
+        server = find_server_by_id_owner(rr.server_id, reg_task);
+        if (!server)
+        {
+            ERR("There is no server with id %d", rr.server_id);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        // отправляем ответ на предыдущий запрос
+        if (rr.reply_sub_mem_id >= 0 && (ret = server_reply(server, rr.reply_sub_mem_id)) != 0)
+            goto out;
+
+        // сервер выходит из цикла обработки запросов
+        if (rr.flags & SERVER_RECV_STOP)
+        {
+            server_recv_stop(server);
+            ret = 0;
+            goto out;
+        }
+
+        // ждем следующий запрос к серверу
+        if ((ret = server_recv_wait(server, rr.timeout_ms, &rr.ntf)) != 0)
+            goto out;
+
+        if (copy_to_user((void __user *)arg, &rr, sizeof(rr)))
+        {
+            ERR("SERVER_REPLY_RECV: cant send back request (SERVER ID:%d)", server->m_id);
+            ret = -EFAULT;
+            goto out;
         }
         break;
 
@@ -302,16 +571,18 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (!client)
         {
             ERR("There is no client with id: %d", client_id);
-            return -ENOENT;
+            ret = -ENOENT;
+            goto out;
         }
 
         // получение соединения
-        conn = client->m_conn_p;
+        conn = client_get_connection(client);
 
         if (!conn)
         {
             ERR("There is no connection in client (ID:%d)(PID:%d)", client_id, reg_task->m_task_p->pid);
-            return -ENOENT;
+            ret = -ENOENT;
+            goto out;
         }
 
         // уведомляем сервер о разрыве соединения
@@ -336,38 +607,28 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         // если сервер не найден
         if (!server)
         {
-            ERR("There is no server with id %d", id);
-            return -ENODATA;
+            ERR("There is no server with id %d", server_id);
+            ret = -ENODATA;
+            goto out;
         }
 
         // поиск нужного соединения
-        scon = server_find_conn_by_sub_mem_id(server, sub_mem_id);
-
-        // если не нашлось такого серверного соединения
-        if (!scon)
-        {
-            ERR("There is no server connection unit for connection btw server (ID:%d) and sub_mem (ID:%d)", server_id,
-                sub_mem_id);
-            return -ENOENT;
-        }
-
-        conn = scon->conn;
+        conn = server_get_conn_by_sub_mem_id(server, sub_mem_id);
 
         // если нет соединения с этой памятью
         if (!conn)
         {
             ERR("There is no connection btw server (ID:%d) and sub_mem (ID:%d)", server_id, sub_mem_id);
-            return -ENOENT;
+            ret = -ENOENT;
+            goto out;
         }
 
-        // получаем клиент
-        client = conn->m_client_p;
-
         // Если нет указателя на клиент
-        if (!client)
+        if (!conn->m_client_p)
         {
             ERR("Ivalid connection object: null client ptr (SERVER ID:%d) (SUB MEM ID: %d)", server_id, sub_mem_id);
-            return -ENOMEM;
+            ret = -ENOMEM;
+            goto out;
         }
 
         if ((ret = notification_send(SERVER, REMOTE_DISCONNECT, conn)) != 0)
@@ -376,7 +637,7 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         }
 
         // удаляем соединение
-        server_cleanup_connection(server, scon);
+        server_cleanup_connection(server, conn);
         break;
 
     case IOCTL_CLIENT_UNREGISTER:
@@ -392,16 +653,18 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (!client)
         {
             ERR("There is no client with id: %d", client_id);
-            return -ENOENT;
+            ret = -ENOENT;
+            goto out;
         }
 
         // получение соединения
-        conn = client->m_conn_p;
+        conn = client_get_connection(client);
 
         if (!conn)
         {
             ERR("There is no connection in client (ID:%d)(PID:%d)", client_id, reg_task->m_task_p->pid);
-            return -ENOENT;
+            ret = -ENOENT;
+            goto out;
         }
 
         // уведомляем сервер о разрыве соединения
@@ -432,7 +695,8 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         if (!server)
         {
             ERR("There is no server with id %d", server_id);
-            return -ENODATA;
+            ret = -ENODATA;
+            goto out;
         }
 
         // удаляем соединения
@@ -446,14 +710,297 @@ static long ipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     case IOCTL_REGISTER_MONITOR:
 
         INF("IOCTL_REGISTER_MONITOR");
-        return reg_task_set_monitor(reg_task);
+        ret = reg_task_set_monitor(reg_task);
+        goto out;
 
         break;
 
+    case IOCTL_GET_REGION_SIZE:
+
+        INF("IOCTL_GET_REGION_SIZE");
+        conn = find_conn_by_packed_id((u32)arg, reg_task, &ret);
+        if (!conn)
+            goto out;
+
+        sub = READ_ONCE(conn->m_mem_p);
+        if (!sub)
+        {
+            ERR("Connection without sub mem");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // размер возвращается результатом ioctl
+        ret = sub->m_size;
+        goto out;
+
+    case IOCTL_REGION_RESIZE:
+
+        INF("IOCTL_REGION_RESIZE");
+        if (copy_from_user(&rs, (void __user *)arg, sizeof(rs)))
+        {
+            ERR("cant copy region resize request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        conn = find_conn_by_packed_id(rs.packed_id, reg_task, &ret);
+        if (!conn)
+            goto out;
+
+        // 0 - только узнать текущий размер
+        ret = connection_resize_region(conn, rs.size);
+        if (ret < 0)
+            goto out;
+
+        rs.size = ret;
+        rs.max_size = connection_region_limit(conn);
+        ret = 0;
+        if (copy_to_user((void __user *)arg, &rs, sizeof(rs)))
+        {
+            ERR("cant send back region size");
+            ret = -EFAULT;
+        }
+        goto out;
+
+    case IOCTL_SERVER_MIGRATE:
+
+        INF("IOCTL_SERVER_MIGRATE");
+        if (copy_from_user(&mg, (void __user *)arg, sizeof(mg)))
+        {
+            ERR("cant copy migration request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // отдать соединение может только процесс, в котором зарегистрирован сервер
+        server = find_server_by_id_owner(mg.server_id, reg_task);
+        target = find_server_by_id(mg.target_id);
+        if (!server || !target || server == target)
+        {
+            ERR("Invalid migration from server %d to server %d", mg.server_id, mg.target_id);
+            ret = -ENODATA;
+            goto migrate_out;
+        }
+
+        // клиент отображает область размером с ограничение сервера и ничего не знает о смене владельца:
+        // соединение переходит только к участнику той же группы с тем же ограничением;
+        // в группе с маршрутизацией запросы и так распределяются по одному
+        if (!server->m_group || target->m_group != server->m_group || (server->m_flags & SERVER_FLAG_ROUTE) ||
+            target->m_max_region_size != server->m_max_region_size ||
+            ((target->m_flags ^ server->m_flags) & SERVER_FLAG_HUGE_PAGES))
+        {
+            ERR("Server %d cant take connections of server %d", target->m_id, server->m_id);
+            ret = -EINVAL;
+            goto migrate_out;
+        }
+
+        conn = server_get_conn_by_sub_mem_id(server, mg.sub_mem_id);
+        if (!conn)
+        {
+            ERR("There is no connection btw server (ID:%d) and sub_mem (ID:%d)", mg.server_id, mg.sub_mem_id);
+            ret = -ENOENT;
+            goto migrate_out;
+        }
+
+        ret = connection_migrate(conn, target);
+
+    migrate_out:
+        server_put(target);
+        goto out;
+
+    case IOCTL_REGION_SWAP:
+
+        INF("IOCTL_REGION_SWAP");
+        if (copy_from_user(&sw, (void __user *)arg, sizeof(sw)))
+        {
+            ERR("cant copy region swap request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // оба соединения должны принадлежать вызывающему процессу
+        conn = find_conn_by_packed_id(sw.packed_a, reg_task, &ret);
+        if (!conn)
+            goto out;
+        peer = find_conn_by_packed_id(sw.packed_b, reg_task, &ret);
+        if (!peer)
+            goto out;
+
+        ret = connection_swap_regions(conn, peer, reg_task);
+        connection_put(peer);
+        goto out;
+
+    case IOCTL_CHANNEL_SUBSCRIBE:
+
+        INF("IOCTL_CHANNEL_SUBSCRIBE");
+        if (copy_from_user(&cs, (void __user *)arg, sizeof(cs)))
+        {
+            ERR("cant copy subscribe request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // подписать можно только клиента своего процесса
+        client = find_client_by_id(cs.client_id);
+        if (!client || client->m_task_p->m_reg_task != reg_task)
+        {
+            ERR("There is no client with id %d in process (PID:%d)", cs.client_id, reg_task->m_task_p->pid);
+            ret = -ENOENT;
+            goto out;
+        }
+
+        cs.channel_name[MAX_SERVER_NAME - 1] = '\0';
+        server = find_server_by_name(cs.channel_name);
+        if (!server || !(server->m_flags & SERVER_FLAG_CHANNEL))
+        {
+            ERR("There is no channel with name: %s", cs.channel_name);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        if ((ret = channel_subscribe(server, client)) != 0)
+            goto out;
+
+        // подписчик отображает подобласть канала по (channel_id, 0)
+        cs.channel_id = server->m_id;
+        cs.region_size = server->m_channel_mem->m_size;
+        cs.flags = server->m_flags;
+        if (copy_to_user((void __user *)arg, &cs, sizeof(cs)))
+        {
+            ERR("cant send back channel id: %d", server->m_id);
+            channel_unsubscribe(client);
+            ret = -EFAULT;
+        }
+        goto out;
+
+    case IOCTL_CHANNEL_UNSUBSCRIBE:
+
+        INF("IOCTL_CHANNEL_UNSUBSCRIBE");
+        client = find_client_by_id(unpack_id1((u32)arg));
+        if (!client || client->m_task_p->m_reg_task != reg_task)
+        {
+            ERR("There is no client with id %d in process (PID:%d)", unpack_id1((u32)arg), reg_task->m_task_p->pid);
+            ret = -ENOENT;
+            goto out;
+        }
+
+        ret = channel_unsubscribe(client);
+        goto out;
+
+    case IOCTL_CHANNEL_PUBLISH:
+
+        INF("IOCTL_CHANNEL_PUBLISH");
+        if (copy_from_user(&cp, (void __user *)arg, sizeof(cp)))
+        {
+            ERR("cant copy publish request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // публикует только процесс издателя
+        server = find_server_by_id_owner(cp.channel_id, reg_task);
+        if (!server || !(server->m_flags & SERVER_FLAG_CHANNEL))
+        {
+            ERR("There is no channel with id %d", cp.channel_id);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        // в ответ - количество подписчиков, которых достигло уведомление
+        ret = channel_publish(server, cp.len);
+        goto out;
+
+    case IOCTL_SERVER_ACCEPT:
+
+        INF("IOCTL_SERVER_ACCEPT");
+        if (copy_from_user(&sa, (void __user *)arg, sizeof(sa)))
+        {
+            ERR("cant copy accept request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        // дескриптор получает только процесс сервера соединения
+        server = find_server_by_id_owner(sa.server_id, reg_task);
+        if (!server)
+        {
+            ERR("There is no server with id %d", sa.server_id);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        conn = server_get_conn_by_sub_mem_id(server, sa.sub_mem_id);
+        if (!conn)
+        {
+            ERR("There is no connection btw server (ID:%d) and sub_mem (ID:%d)", sa.server_id, sa.sub_mem_id);
+            ret = -ENOENT;
+            goto out;
+        }
+
+        sa.conn_fd = conn_file_create(conn, SERVER, filp);
+        if (sa.conn_fd < 0)
+        {
+            ret = sa.conn_fd;
+            goto out;
+        }
+        if (copy_to_user((void __user *)arg, &sa, sizeof(sa)))
+        {
+            ERR("cant send back connection fd of server (ID:%d)", sa.server_id);
+            ret = -EFAULT;
+        }
+        goto out;
+
+    case IOCTL_QUEUE_WAIT:
+
+        INF("IOCTL_QUEUE_WAIT");
+        if (copy_from_user(&qw, (void __user *)arg, sizeof(qw)))
+        {
+            ERR("cant copy queue wait request");
+            ret = -EFAULT;
+            goto out;
+        }
+
+        server = find_server_by_id(qw.channel_id);
+        if (!server || !(server->m_flags & SERVER_FLAG_QUEUE))
+        {
+            ERR("There is no job queue with id %d", qw.channel_id);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        // ссылка на очередь держится до конца ожидания
+        ret = channel_queue_wait(server, reg_task, qw.timeout_ms);
+        goto out;
+
+    case IOCTL_QUEUE_POST:
+
+        INF("IOCTL_QUEUE_POST");
+
+        // будит исполнителей только процесс издателя
+        server = find_server_by_id_owner((int)arg, reg_task);
+        if (!server || !(server->m_flags & SERVER_FLAG_QUEUE))
+        {
+            ERR("There is no job queue with id %d", (int)arg);
+            ret = -ENODATA;
+            goto out;
+        }
+
+        // в ответ - разбужен ли исполнитель
+        ret = channel_queue_post(server);
+        goto out;
+
     default:
         INF("Unknown ioctl command: 0x%x", cmd);
-        return -ENOTTY;
+        ret = -ENOTTY;
+        goto out;
     }
+
+out:
+    // отпускаем ссылки, взятые при поиске объектов
+    connection_put(conn);
+    server_put(server);
+    client_put(client);
     return ret;
 }
 
@@ -470,7 +1017,6 @@ static int ipc_mmap(struct file *file, struct vm_area_struct *vma)
     struct server_t *server = NULL;
     struct sub_mem_t *sub = NULL;
     struct connection_t *conn = NULL;
-    struct serv_conn_list_t *srv_conn = NULL;
     u32 packed_cli_sub_id = 0;
 
     // id не может быть отрицательным
@@ -484,6 +1030,10 @@ static int ipc_mmap(struct file *file, struct vm_area_struct *vma)
 
     INF("packed_id=0x%x (from vma->vm_pgoff), target_id=%d, sub_mem_id=%d", packed_id, target_id, sub_id);
 
+    // отображение кольца уведомлений процесса
+    if (packed_id == NOTIF_RING_PACKED_ID)
+        return reg_task_mmap_ring(file->private_data, vma);
+
     /**
      * Нужно найти зарегистрированного клиента или сервера,
      * который запросил отображение памяти
@@ -496,13 +1046,14 @@ static int ipc_mmap(struct file *file, struct vm_area_struct *vma)
     if (client)
     {
         // сохраняем соединение, в котором нужная нам память
-        conn = client->m_conn_p;
+        conn = client_get_connection(client);
 
         // если соединения нет, то и соединять не с чем
-        if (!conn)
+        if (!conn || !conn->m_mem_p)
         {
             ERR("There is no connection (CLIENT ID:%d)", client->m_id);
-            return -EINVAL;
+            ret = -EINVAL;
+            goto out;
         }
 
         // запакованные client_id + shm_id
@@ -519,22 +1070,11 @@ static int ipc_mmap(struct file *file, struct vm_area_struct *vma)
 
         INF("Data packed: (client_id=%d, sub_mem_id=%d)\n", client->m_id, conn->m_mem_p->m_id);
 
-        // чтобы сервер не удалился или не изменился, пока сигнал отправляю
-        mutex_lock(&conn->m_server_p->m_lock);
-
-        // отправка уведомления
-        if ((ret = notification_send(CLIENT, NEW_CONNECTION, conn)) != 0)
-        {
-            ERR("notification sending failed");
-        }
-
-        // устанавливаем флаг в значение: память отображена на сервере
-        atomic_set(&conn->m_serv_mmaped, 1);
-        mutex_unlock(&conn->m_server_p->m_lock);
+        // отправка уведомления NEW_CONNECTION серверу
+        connection_client_mapped(conn);
 
         goto found;
     }
-    client = NULL;
 
     // ищем сервер, если это был не клиент
     server = find_server_by_id(target_id);
@@ -542,64 +1082,71 @@ static int ipc_mmap(struct file *file, struct vm_area_struct *vma)
     // если current+id - это сервер
     if (server)
     {
-        // сохраняем соединение, в котором нужная нам память
-        if (!list_empty(&server->connection_list.list))
+        // подобласть канала одна на издателя и всех подписчиков, соединений у канала нет
+        if (server->m_flags & SERVER_FLAG_CHANNEL)
         {
-            // нужно знать shm_id для поиска памяти
-            if (sub_id != 0)
-            {
-                // ищем нужную память
-                srv_conn = server_find_conn_by_sub_mem_id(server, sub_id);
-
-                // проверка на существование подключенной памяти с таким id
-                if (!srv_conn)
-                {
-                    ERR("Server (ID: %d) (NAME: %s) does not have connection with (SHM MEM ID: %d)", server->m_id,
-                        server->m_name, sub_id);
-                    return -ENOENT;
-                }
-                conn = srv_conn->conn;
-            }
-            else
-            {
-                // Cервер не должен вызывать mmap с shm_id=0, потому что общая память
-                // не может создаться до создания клиента или сервера, которые заберут начальные id.
-                ERR("Server %d (pid %d) called mmap with sub_mem_id=0.", target_id, current->pid);
-                return -EINVAL;
-            }
+            ret = sub_id == 0 ? channel_mmap(server, file->private_data, vma) : -EINVAL;
+            goto out;
         }
-        else
+
+        // нужно знать shm_id для поиска памяти
+        if (sub_id == 0)
+        {
+            // Cервер не должен вызывать mmap с shm_id=0: id 0 не выдается ни одной подобласти.
+            ERR("Server %d (pid %d) called mmap with sub_mem_id=0.", target_id, current->pid);
+            ret = -EINVAL;
+            goto out;
+        }
+
+        // ищем соединение, в котором нужная нам память (запросы к нему может получать и участник группы)
+        conn = server_get_routed_conn_by_sub_mem_id(server, sub_id);
+
+        // проверка на существование подключенной памяти с таким id
+        if (!conn)
         {
-            INF("There is no connection to '%s' server", server->m_name);
-            return -ENOENT;
+            ERR("Server (ID: %d) (NAME: %s) does not have connection with (SHM MEM ID: %d)", server->m_id,
+                server->m_name, sub_id);
+            ret = -ENOENT;
+            goto out;
         }
+
+        // участник группы отображает чужое соединение по смещению сервера соединения:
+        // так перестройка при росте области снимет и его отображение
+        if (conn->m_server_p != server)
+            vma->vm_pgoff = pack_ids(conn->m_server_p->m_id, sub_id);
         goto found;
     }
-    server = NULL;
 
     ERR("No client/server with ID %d found for PID %d\n", target_id, current->pid);
     return -ENOENT;
 
 found:
-    // Проверяем, что соединение и общая память существуют
-    if (!conn || !conn->m_mem_p)
+    // Проверяем, что общая память существует
+    sub = READ_ONCE(conn->m_mem_p);
+    if (!sub)
     {
         ERR("Connection or shared memory is NULL\n");
-        return -EFAULT;
+        ret = -EFAULT;
+        goto out;
     }
-    sub = conn->m_mem_p;
 
-    // Отображаем физическую память в пользовательское пространство
-    ret = remap_pfn_range(vma, vma->vm_start, page_to_pfn(sub->m_pages_p), sub->m_size, vma->vm_page_prot);
+    // Отображаем память соединения в пользовательское пространство (страницы - при обращении)
+    ret = connection_mmap(conn, vma);
 
     if (ret)
     {
-        ERR("remap_pfn_range failed: %d\n", ret);
-        return ret;
+        ERR("connection_mmap failed: %d\n", ret);
+        goto out;
     }
 
     INF("PID %d mapped shm %p (size: %zu)\n", current->pid, sub, sub->m_size);
-    return 0;
+
+out:
+    // отпускаем ссылки, взятые при поиске объектов
+    connection_put(conn);
+    server_put(server);
+    client_put(client);
+    return ret;
 }
 
 // обработчик подключения к драйверу
@@ -695,38 +1242,48 @@ static ssize_t ipc_read(struct file *filp, char __user *buf, size_t count, loff_
     int notif_count = reg_task_get_notif_count(reg_task);
     INF("(PID:%d) notif count: %d", reg_task->m_task_p->pid, notif_count);
 
-    // структура уведомления
-    struct notification_t *notif;
+    // сколько уведомлений помещается в буфер процесса
+    size = sizeof(struct notification_data);
+    if (count < size)
+    {
+        ERR("Not enough space");
+        return -EMSGSIZE;
+    }
 
-    // получаем уведомление
-    notif = reg_task_get_notification(reg_task);
+    // забираем пачку уведомлений за одну блокировку списка
+    LIST_HEAD(batch);
+    int batch_count = reg_task_get_notifications(reg_task, &batch, min_t(size_t, count / size, INT_MAX));
 
     // если получить не удалось
-    if (!notif)
+    if (!batch_count)
     {
         INF("There is no more notifications");
         return -ENOENT;
     }
-    size = sizeof(notif->data);
 
-    // сравниваем размер, получаемого сообщения
-    if (size > count)
+    // копируем данные в user space и удаляем уведомления
+    ssize_t copied = 0;
+    int failed = 0;
+    struct notification_t *notif, *notif_tmp;
+    list_for_each_entry_safe(notif, notif_tmp, &batch, list)
     {
-        ERR("Not enough space");
-        return -EMSGSIZE;
+        list_del(&notif->list);
+        if (!failed && copy_to_user(buf + copied, &notif->data, size))
+        {
+            ERR("copy_to_user error");
+            failed = 1;
+        }
+        else if (!failed)
+            copied += size;
+        notification_delete(notif);
     }
 
-    // копируем данные в user space
-    if (copy_to_user(buf, &notif->data, size))
-    {
-        ERR("copy_to_user error");
+    // если часть уведомлений скопировать не удалось, возвращаем то, что успели
+    if (!copied)
         return -EFAULT;
-    }
-
-    // удаляем уведомление из очереди
-    notification_delete(notif);
 
-    return size;
+    INF("(PID:%d) read %zd notifications", reg_task->m_task_p->pid, copied / (ssize_t)size);
+    return copied;
 }
 
 static __poll_t ipc_poll(struct file *filp, poll_table *wait)
@@ -782,12 +1339,24 @@ static int __init ipc_init(void)
     INF("=== RIPC Driver loading ===");
     int result;
 
+    // Кэши объектов создаются до появления устройства
+    if ((result = client_cache_create()) != 0)
+        return result;
+    if ((result = server_cache_create()) != 0)
+        goto server_cache_fail;
+    if ((result = connection_cache_create()) != 0)
+        goto conn_cache_fail;
+
+    // теплый запас подобластей, чтобы первые подключения не выделяли память
+    if ((result = shm_allocator_init()) != 0)
+        goto shm_fail;
+
     // Выделение диапазона устройств
     result = alloc_chrdev_region(&g_dev_num, g_minor, g_dev_count, DEVICE_NAME);
     if (result < 0)
     {
         ERR("Failed to allocate char device region");
-        return result;
+        goto chrdev_fail;
     }
     g_major = MAJOR(g_dev_num);
 
@@ -834,6 +1403,18 @@ device_fail:
 class_fail:
     unregister_chrdev_region(g_dev_num, g_dev_count);
 
+    // удаление пулов памяти при ошибке
+chrdev_fail:
+    delete_shm_list();
+
+    // удаление кэшей при ошибке
+shm_fail:
+    connection_cache_destroy();
+conn_cache_fail:
+    server_cache_destroy();
+server_cache_fail:
+    client_cache_destroy();
+
     return result;
 }
 
@@ -906,6 +1487,12 @@ static void __exit ipc_exit(void)
         INF("Character device region (Major: %d) unregistered.", g_major);
     }
 
+    // объекты освобождаются через call_rcu: ждем обратные вызовы до удаления кэшей
+    rcu_barrier();
+    connection_cache_destroy();
+    server_cache_destroy();
+    client_cache_destroy();
+
     INF("RIPC driver unloaded successfully.");
 }
 
@@ -1,24 +1,148 @@
 #include "server.h"
+#include "channel.h"
 #include "client.h"
+#include "conn_file.h"
 #include "err.h"
 #include "ripc.h"
 #include "shm.h"
 #include "task.h"
 
 #include <linux/mm.h>     // операции с памятью
-#include <linux/sched.h>  // для current
-#include <linux/string.h> // операции над строками
+#include <linux/rculist.h>    // hlist с RCU
+#include <linux/slab.h>       // кэши объектов
+#include <linux/sched.h>      // для current
+#include <linux/string.h>     // операции над строками
+#include <linux/stringhash.h> // хеш имени сервера
+#include <linux/topology.h>   // узел NUMA текущего процессора
 
 // Список соединений и его блокировка
 LIST_HEAD(g_servers_list);
 DEFINE_MUTEX(g_servers_lock);
 
+// Индекс серверов по имени
+DEFINE_HASHTABLE(g_servers_by_name, SERVERS_NAME_HASH_BITS);
+
+// Таблица серверов по id
+DEFINE_XARRAY(g_servers_xa);
+
+// Кэши объектов серверов и записей их списков соединений
+static struct kmem_cache *g_servers_cache;
+static struct kmem_cache *g_srv_conns_cache;
+
+int server_cache_create(void)
+{
+    g_servers_cache = KMEM_CACHE(server_t, 0);
+    g_srv_conns_cache = KMEM_CACHE(serv_conn_list_t, 0);
+    if (!g_servers_cache || !g_srv_conns_cache)
+    {
+        ERR("Cant create server caches");
+        server_cache_destroy();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void server_cache_destroy(void)
+{
+    kmem_cache_destroy(g_srv_conns_cache);
+    kmem_cache_destroy(g_servers_cache);
+    g_srv_conns_cache = NULL;
+    g_servers_cache = NULL;
+}
+
+void server_conn_entry_free(struct server_t *srv, struct serv_conn_list_t *entry)
+{
+    atomic_dec(&srv->m_conn_count);
+    kmem_cache_free(g_srv_conns_cache, entry);
+}
+
+// хеш имени сервера
+static u32 server_name_hash(const char *name)
+{
+    return full_name_hash(NULL, name, strnlen(name, MAX_SERVER_NAME));
+}
+
+// поиск сервера в индексе, вызывается под rcu_read_lock или g_servers_lock
+static struct server_t *server_hash_lookup(const char *name)
+{
+    struct server_t *srv = NULL;
+    hash_for_each_possible_rcu(g_servers_by_name, srv, m_name_node, server_name_hash(name),
+                               lockdep_is_held(&g_servers_lock))
+    {
+        if (strcmp(srv->m_name, name) == 0)
+            return srv;
+    }
+    return NULL;
+}
+
+/**
+ * Группы серверов
+ */
+
+// создание группы первым участником
+static struct server_group_t *server_group_create(unsigned int flags)
+{
+    struct server_group_t *grp = kzalloc(sizeof(*grp), GFP_KERNEL);
+    if (!grp)
+        return NULL;
+
+    grp->m_flags = flags & (SERVER_FLAG_BALANCE_LEAST | SERVER_FLAG_ROUTE);
+    INIT_LIST_HEAD(&grp->m_members);
+    atomic_set(&grp->m_next, 0);
+    kref_init(&grp->m_ref);
+    return grp;
+}
+
+// освобождение группы после ухода последнего участника
+static void server_group_release(struct kref *ref)
+{
+    struct server_group_t *grp = container_of(ref, struct server_group_t, m_ref);
+
+    // список участников читается под RCU
+    kfree_rcu(grp, m_rcu);
+}
+
+static void server_group_put(struct server_group_t *grp)
+{
+    if (grp)
+        kref_put(&grp->m_ref, server_group_release);
+}
+
+// выбор участника группы для нового подключения, вызывается под rcu_read_lock
+static struct server_t *server_group_pick(struct server_group_t *grp)
+{
+    struct server_t *srv, *best = NULL;
+
+    // участник с наименьшим числом соединений: одновременные подключения могут выбрать одного и того же
+    if (grp->m_flags & SERVER_FLAG_BALANCE_LEAST)
+    {
+        list_for_each_entry_rcu(srv, &grp->m_members, m_group_node)
+        {
+            if (!best || atomic_read(&srv->m_conn_count) < atomic_read(&best->m_conn_count))
+                best = srv;
+        }
+        return best;
+    }
+
+    // по кругу: если состав группы успел измениться, подключение получает первый участник
+    unsigned int next = (unsigned int)atomic_inc_return(&grp->m_next) % max(READ_ONCE(grp->m_count), 1);
+    list_for_each_entry_rcu(srv, &grp->m_members, m_group_node)
+    {
+        if (!best)
+            best = srv;
+        if (next-- == 0)
+            return srv;
+    }
+    return best;
+}
+
 /**
  * Операции над объектом соединения
  */
 
 // создание сервера
-struct server_t *server_create(const char *name)
+struct server_t *server_create(const char *name, size_t max_region_size, unsigned int flags, int numa_node,
+                               const char *route_prefix)
 {
     // проверка входных данные
     if (!name || strlen(name) == 0)
@@ -28,7 +152,7 @@ struct server_t *server_create(const char *name)
     }
 
     // выделение и проверка памяти
-    struct server_t *srv = kmalloc(sizeof(*srv), GFP_KERNEL);
+    struct server_t *srv = kmem_cache_alloc(g_servers_cache, GFP_KERNEL);
     if (!srv)
     {
         ERR("server_create: Cant allocate memory for server");
@@ -40,19 +164,123 @@ struct server_t *server_create(const char *name)
     srv->m_id = generate_id(&g_id_gen);
     INIT_LIST_HEAD(&srv->connection_list.list);
     srv->m_task_p = NULL;
+    srv->m_group = NULL;
+    INIT_LIST_HEAD(&srv->m_group_node);
+    atomic_set(&srv->m_conn_count, 0);
+    strscpy(srv->m_route_prefix, route_prefix ? route_prefix : "", MAX_ROUTE_PREFIX);
+    srv->m_route_len = strlen(srv->m_route_prefix);
+
+    // канал состояния - это канал публикации без уведомлений, очередь заданий - с уведомлением одного исполнителя
+    if (flags & SERVER_FLAG_QUEUE)
+        flags &= ~SERVER_FLAG_STATE;
+    if (flags & (SERVER_FLAG_STATE | SERVER_FLAG_QUEUE))
+        flags |= SERVER_FLAG_CHANNEL;
+
+    // у канала нет соединений: распределять между участниками группы нечего
+    if (flags & SERVER_FLAG_CHANNEL)
+        flags &= ~(SERVER_FLAG_GROUP | SERVER_FLAG_BALANCE_LEAST | SERVER_FLAG_ROUTE);
+
+    // маршрутизация запросов работает только внутри группы
+    if (flags & SERVER_FLAG_ROUTE)
+        flags |= SERVER_FLAG_GROUP;
+
+    // ограничение размера подобласти: 0 - максимально допустимый драйвером
+    if (max_region_size == 0 || max_region_size > SHM_REGION_MAX_SIZE)
+        max_region_size = SHM_REGION_MAX_SIZE;
+
+    // запрос и ответ занимают хотя бы по странице
+    max_region_size = max_t(size_t, max_region_size, SHM_REGION_PAGE_SIZE);
+    srv->m_max_region_size = max_region_size;
+
+    // подобласть на огромной странице всегда занимает ее целиком
+    srv->m_flags = flags & (SERVER_FLAG_HUGE_PAGES | SERVER_FLAG_CHANNEL | SERVER_FLAG_STATE | SERVER_FLAG_QUEUE);
+    if (srv->m_flags & SERVER_FLAG_HUGE_PAGES)
+        srv->m_max_region_size = SHM_HUGE_REGION_SIZE;
+
+    // без явного узла память соединений будет рядом с потоком, зарегистрировавшим сервер
+    srv->m_numa_node = numa_node == SERVER_NUMA_NODE_AUTO ? numa_mem_id() : numa_node;
+
+    // подобласть канала выделяется сразу: издатель пишет в нее до появления подписчиков
+    if ((srv->m_flags & SERVER_FLAG_CHANNEL) && channel_init(srv, srv->m_max_region_size))
+    {
+        free_id(&g_id_gen, srv->m_id);
+        kmem_cache_free(g_servers_cache, srv);
+        return NULL;
+    }
 
     // инициализация блокировок
     mutex_init(&srv->m_lock);
     mutex_init(&srv->m_con_list_lock);
 
-    // добавление в главный список
+    // первая ссылка принадлежит таблицам серверов
+    kref_init(&srv->m_ref);
+
+    // прямой прием запросов выключен, пока сервер не вызовет IOCTL_SERVER_REPLY_RECV
+    spin_lock_init(&srv->m_recv_lock);
+    srv->m_recv_direct = 0;
+    srv->m_recv_head = 0;
+    srv->m_recv_tail = 0;
+    init_waitqueue_head(&srv->m_recv_wq);
+
+    // группа, в которую входит сервер
+    struct server_group_t *grp = NULL;
+
+    // добавление в главный список и индекс по имени,
+    // повторная проверка имени под блокировкой закрывает гонку двух регистраций
     mutex_lock(&g_servers_lock);
-    list_add_tail(&srv->list, &g_servers_list);
+    struct server_t *existing = server_hash_lookup(srv->m_name);
+
+    // имя можно разделить только с группой, и только если об этом просили явно
+    if (existing && !(existing->m_group && (flags & SERVER_FLAG_GROUP)))
+    {
+        mutex_unlock(&g_servers_lock);
+        ERR("Server '%s' already exists", srv->m_name);
+        goto failed_insert;
+    }
+
+    // первый участник создает группу, остальные входят в нее и получают ее политику распределения
+    if (flags & SERVER_FLAG_GROUP)
+    {
+        grp = existing ? existing->m_group : server_group_create(flags);
+        if (!grp)
+        {
+            mutex_unlock(&g_servers_lock);
+            ERR("Cant allocate group for server '%s'", srv->m_name);
+            goto failed_insert;
+        }
+        if (existing)
+            kref_get(&grp->m_ref);
+    }
+
+    if (xa_err(xa_store(&g_servers_xa, srv->m_id, srv, GFP_KERNEL)))
+    {
+        mutex_unlock(&g_servers_lock);
+        ERR("Cant add server (ID:%d) to id table", srv->m_id);
+        goto failed_group;
+    }
+    list_add_tail_rcu(&srv->list, &g_servers_list);
+    hash_add_rcu(g_servers_by_name, &srv->m_name_node, server_name_hash(srv->m_name));
+    if (grp)
+    {
+        srv->m_group = grp;
+        srv->m_flags |= SERVER_FLAG_GROUP | grp->m_flags;
+        list_add_tail_rcu(&srv->m_group_node, &grp->m_members);
+        WRITE_ONCE(grp->m_count, grp->m_count + 1);
+    }
     mutex_unlock(&g_servers_lock);
 
-    INF("Server '%s' (ID: %d) created", srv->m_name, srv->m_id);
+    INF("Server '%s' (ID: %d) created%s", srv->m_name, srv->m_id, grp ? " in group" : "");
 
     return srv;
+
+failed_group:
+    server_group_put(grp);
+failed_insert:
+    if (srv->m_flags & SERVER_FLAG_CHANNEL)
+        channel_release(srv);
+    free_id(&g_id_gen, srv->m_id);
+    kmem_cache_free(g_servers_cache, srv);
+    return NULL;
 }
 
 void server_add_task(struct server_t *srv, struct servers_list_t *task)
@@ -79,64 +307,63 @@ void server_add_task(struct server_t *srv, struct servers_list_t *task)
     mutex_unlock(&srv->m_lock);
 }
 
-void server_cleanup_connection(struct server_t *srv, struct serv_conn_list_t *scon)
+void server_cleanup_connection(struct server_t *srv, struct connection_t *conn)
 {
-    if (!srv || !scon)
+    if (!srv || !conn)
     {
         ERR("Invalid params");
         return;
     }
 
     // проверка на принадлежность соединения серверу
-    if (scon->conn->m_server_p != srv)
+    if (conn->m_server_p != srv)
     {
         ERR("ABORT: Server is not the owner of this connection");
         return;
     }
 
-    // удаление соединения
-    mutex_lock(&srv->m_lock);
-    mutex_lock(&srv->m_con_list_lock);
+    INF("Processing connection for client %d, sub_mem %d", conn->m_client_p ? conn->m_client_p->m_id : -1,
+        conn->m_mem_p ? conn->m_mem_p->m_id : -1);
 
-    struct connection_t *conn = scon->conn;
-    list_del(&scon->list);
-    kfree(scon);
-
-    if (conn)
-    {
-        INF("Processing connection for client %d, sub_mem %d", conn->m_client_p ? conn->m_client_p->m_id : -1,
-            conn->m_mem_p ? conn->m_mem_p->m_id : -1);
-        // Вызываем delete_connection, которая обработает и другую сторону
-        // и удалит соединение из глобального списка.
-        // Разблокируем мьютекс сервера перед вызовом, т.к. delete_connection
-        // может блокировать глобальный список соединений.
-        mutex_unlock(&srv->m_con_list_lock);
-        mutex_unlock(&srv->m_lock);
-
-        delete_connection(conn); // Удалит соединение, отсоединит sub_mem и клиента
-
-        mutex_lock(&srv->m_lock);
-        mutex_lock(&srv->m_con_list_lock); // Снова блокируем для след. итерации
-    }
-    else
-    {
-        INF("Found NULL connection pointer in server's connection list");
-    }
-
-    mutex_unlock(&srv->m_con_list_lock);
-    mutex_unlock(&srv->m_lock);
+    // Вызываем delete_connection, которая обработает и другую сторону,
+    // удалит запись из списка сервера и соединение из глобального списка.
+    delete_connection(conn);
 }
 
 void server_cleanup_connections(struct server_t *srv)
 {
-    struct serv_conn_list_t *srv_conn_entry, *tmp;
-
     if (!srv)
         return;
     INF("Cleaning up connections for server %d ('%s')", srv->m_id, srv->m_name);
-    list_for_each_entry_safe(srv_conn_entry, tmp, &srv->connection_list.list, list)
+
+    // запись удаляет delete_connection, поэтому каждый раз берем первую оставшуюся
+    for (;;)
     {
-        server_cleanup_connection(srv, srv_conn_entry);
+        mutex_lock(&srv->m_con_list_lock);
+        struct serv_conn_list_t *srv_conn_entry =
+            list_first_entry_or_null(&srv->connection_list.list, struct serv_conn_list_t, list);
+
+        // пока запись в списке, ссылка связи на соединение еще не снята
+        struct connection_t *conn = srv_conn_entry ? srv_conn_entry->conn : NULL;
+        if (conn)
+            kref_get(&conn->m_ref);
+        mutex_unlock(&srv->m_con_list_lock);
+
+        if (!srv_conn_entry)
+            break;
+
+        if (!conn)
+        {
+            INF("Found NULL connection pointer in server's connection list");
+            mutex_lock(&srv->m_con_list_lock);
+            list_del(&srv_conn_entry->list);
+            mutex_unlock(&srv->m_con_list_lock);
+            server_conn_entry_free(srv, srv_conn_entry);
+            continue;
+        }
+
+        server_cleanup_connection(srv, conn);
+        connection_put(conn);
     }
     INF("Finished cleaning connections for server %d", srv->m_id);
 }
@@ -153,43 +380,278 @@ void server_destroy(struct server_t *srv)
 
     INF("Destroying server (ID:%d)(NAME:%s)", srv->m_id, srv->m_name);
 
-    // удаление сервера из глобального списка
+    // удаление сервера из глобального списка и индекса
     mutex_lock(&g_servers_lock);
     mutex_lock(&srv->m_lock);
-    list_del(&srv->list);
+    list_del_rcu(&srv->list);
+    hash_del_rcu(&srv->m_name_node);
+    xa_erase(&g_servers_xa, srv->m_id);
+
+    // новые подключения группы достаются оставшимся участникам
+    if (srv->m_group)
+    {
+        list_del_rcu(&srv->m_group_node);
+        WRITE_ONCE(srv->m_group->m_count, srv->m_group->m_count - 1);
+    }
     mutex_unlock(&srv->m_lock);
     mutex_unlock(&g_servers_lock);
 
+    // подписки держат ссылки на канал
+    if (srv->m_flags & SERVER_FLAG_CHANNEL)
+        channel_close(srv);
+
     free_id(&g_id_gen, srv->m_id);
+
+    // ссылка таблиц: объект живет, пока его держат соединения или текущие запросы
+    server_put(srv);
+}
+
+// возврат памяти сервера в кэш после читателей под RCU
+static void server_free_rcu(struct rcu_head *head)
+{
+    kmem_cache_free(g_servers_cache, container_of(head, struct server_t, m_rcu));
+}
+
+// освобождение сервера после последней ссылки
+static void server_release(struct kref *ref)
+{
+    struct server_t *srv = container_of(ref, struct server_t, m_ref);
+
+    INF("Server %d freed", srv->m_id);
+
     mutex_destroy(&srv->m_lock);
     mutex_destroy(&srv->m_con_list_lock);
-    kfree(srv);
+    server_group_put(srv->m_group);
+
+    // отображений канала больше нет: они держали ссылки
+    if (srv->m_flags & SERVER_FLAG_CHANNEL)
+        channel_release(srv);
+
+    // читатели под RCU могут еще держать указатель
+    call_rcu(&srv->m_rcu, server_free_rcu);
+}
+
+void server_get(struct server_t *srv)
+{
+    if (srv)
+        kref_get(&srv->m_ref);
+}
+
+void server_put(struct server_t *srv)
+{
+    if (srv)
+        kref_put(&srv->m_ref, server_release);
+}
+
+// захват ссылки на сервер, найденный под rcu_read_lock
+static struct server_t *server_tryget(struct server_t *srv)
+{
+    if (srv && !kref_get_unless_zero(&srv->m_ref))
+        return NULL;
+    return srv;
+}
+
+int server_recv_push(struct server_t *srv, const struct notification_data *data)
+{
+    if (!srv || !data)
+    {
+        ERR("empty param");
+        return 0;
+    }
+
+    int queued = 0;
+    spin_lock(&srv->m_recv_lock);
+    if (srv->m_recv_direct && srv->m_recv_head - srv->m_recv_tail < SERVER_RECV_QUEUE_SIZE)
+    {
+        srv->m_recv_queue[srv->m_recv_head++ % SERVER_RECV_QUEUE_SIZE] = *data;
+        queued = 1;
+    }
+    spin_unlock(&srv->m_recv_lock);
+
+    if (queued)
+        wake_up_interruptible(&srv->m_recv_wq);
+    return queued;
+}
+
+// извлечение запроса из очереди прямого приема
+static int server_recv_pop(struct server_t *srv, struct notification_data *out)
+{
+    int popped = 0;
+    spin_lock(&srv->m_recv_lock);
+    if (srv->m_recv_head != srv->m_recv_tail)
+    {
+        *out = srv->m_recv_queue[srv->m_recv_tail++ % SERVER_RECV_QUEUE_SIZE];
+        popped = 1;
+    }
+    spin_unlock(&srv->m_recv_lock);
+    return popped;
+}
+
+int server_recv_wait(struct server_t *srv, unsigned int timeout_ms, struct notification_data *out)
+{
+    if (!srv || !out)
+    {
+        ERR("empty param");
+        return -EINVAL;
+    }
+
+    // с этого момента запросы к серверу идут в его очередь
+    spin_lock(&srv->m_recv_lock);
+    srv->m_recv_direct = 1;
+    spin_unlock(&srv->m_recv_lock);
+
+    long timeout = timeout_ms ? msecs_to_jiffies(timeout_ms) : MAX_SCHEDULE_TIMEOUT;
+    long ret = wait_event_interruptible_timeout(srv->m_recv_wq, server_recv_pop(srv, out), timeout);
+
+    if (ret > 0)
+        return 0;
+    if (ret < 0)
+        return -EINTR;
+
+    // запросов не было: сервер больше не ждет, возвращаем обычную доставку
+    server_recv_stop(srv);
+    return -ETIMEDOUT;
+}
+
+void server_recv_stop(struct server_t *srv)
+{
+    if (!srv)
+    {
+        ERR("empty param");
+        return;
+    }
+
+    struct notification_data pending[SERVER_RECV_QUEUE_SIZE];
+    int count = 0;
+
+    spin_lock(&srv->m_recv_lock);
+    srv->m_recv_direct = 0;
+    while (srv->m_recv_head != srv->m_recv_tail)
+        pending[count++] = srv->m_recv_queue[srv->m_recv_tail++ % SERVER_RECV_QUEUE_SIZE];
+    spin_unlock(&srv->m_recv_lock);
+
+    // не принятые запросы доставляются процессу сервера обычным путем
+    for (int i = 0; i < count; i++)
+    {
+        // запрос закрытого соединения не нужен: сервер получит REMOTE_DISCONNECT
+        struct connection_t *conn = server_get_routed_conn_by_sub_mem_id(srv, pending[i].m_sub_mem_id);
+        if (!conn)
+            continue;
+
+        // у соединения есть дескриптор сервера: запрос ждет в нем
+        int passed = conn->m_server_p == srv && conn_file_push(conn, SERVER, &pending[i]);
+        if (!passed && (!srv->m_task_p || reg_task_send_notification(srv->m_task_p->m_reg_task, conn, &pending[i])))
+            ERR("Lost request to server (ID:%d) from client (ID:%d)", srv->m_id, pending[i].m_sender_id);
+        connection_put(conn);
+    }
 }
 
 // поиск сервера по имени
 struct server_t *find_server_by_name(const char *name)
 {
-    mutex_lock(&g_servers_lock);
-    struct server_t *srv = NULL;
-    list_for_each_entry(srv, &g_servers_list, list)
+    if (!name)
     {
-        if(!srv)
-        {
-            ERR("NULL server entry");
-            mutex_unlock(&g_servers_lock);
-            return NULL;
-        }
+        ERR("Invalid server name");
+        return NULL;
+    }
 
-        INF("Got a new server '%s'", srv->m_name);
+    // читатели не берут g_servers_lock
+    rcu_read_lock();
+    struct server_t *srv = server_tryget(server_hash_lookup(name));
+    rcu_read_unlock();
 
-        if (strcmp(srv->m_name, name) == 0)
-        {
-            mutex_unlock(&g_servers_lock);
-            return srv;
-        }
+    INF("Server '%s' %s", name, srv ? "found" : "not found");
+    return srv;
+}
+
+struct server_t *pick_server_by_name(const char *name)
+{
+    if (!name)
+    {
+        ERR("Invalid server name");
+        return NULL;
     }
-    mutex_unlock(&g_servers_lock);
-    return NULL;
+
+    rcu_read_lock();
+    struct server_t *srv = server_hash_lookup(name);
+    struct server_t *picked = NULL;
+
+    // выбранный участник мог как раз уходить: тогда подключение получает найденный по имени
+    if (srv && srv->m_group)
+        picked = server_tryget(server_group_pick(srv->m_group));
+    if (!picked)
+        picked = server_tryget(srv);
+    rcu_read_unlock();
+
+    INF("Server '%s' %s", name, picked ? "picked" : "not found");
+    return picked;
+}
+
+/**
+ * Маршрутизация запросов в группе (SERVER_FLAG_ROUTE): запрос получает участник
+ * с самым длинным префиксом, с которого начинается URL. Пустой префикс подходит любому URL,
+ * при равной длине запрос остается у сервера соединения, поэтому участники без префикса
+ * просто делят подключения, как в обычной группе.
+ */
+struct server_t *server_route_request(struct server_t *home, const char *url, size_t len)
+{
+    struct server_group_t *grp = home ? home->m_group : NULL;
+    if (!grp || !(grp->m_flags & SERVER_FLAG_ROUTE) || !url)
+        return NULL;
+
+    struct server_t *srv, *best = NULL;
+    rcu_read_lock();
+    list_for_each_entry_rcu(srv, &grp->m_members, m_group_node)
+    {
+        if (srv->m_route_len > len || strncmp(srv->m_route_prefix, url, srv->m_route_len))
+            continue;
+        if (!best || srv->m_route_len > best->m_route_len || (srv == home && srv->m_route_len == best->m_route_len))
+            best = srv;
+    }
+
+    // уходящий участник запрос не получит: он остается у сервера соединения
+    best = (best && best != home) ? server_tryget(best) : NULL;
+    rcu_read_unlock();
+
+    if (best)
+        INF("Request '%.*s' routed from server (ID:%d) to server (ID:%d)", (int)len, url, home->m_id, best->m_id);
+    return best;
+}
+
+void server_route_notify(struct server_t *home, enum notif_type type, struct connection_t *con)
+{
+    struct server_group_t *grp = home ? home->m_group : NULL;
+    if (!grp || !(grp->m_flags & SERVER_FLAG_ROUTE))
+        return;
+
+    // отправка может спать: под RCU только берутся ссылки на участников, уведомления уходят после
+    int count = READ_ONCE(grp->m_count), taken = 0;
+    struct server_t **members = kmalloc_array(max(count, 1), sizeof(*members), GFP_KERNEL);
+    if (!members)
+    {
+        ERR("Cant allocate memory to notify group '%s'", home->m_name);
+        return;
+    }
+
+    // участник, вступивший после подсчета, запросов этого соединения еще не получал
+    struct server_t *srv;
+    rcu_read_lock();
+    list_for_each_entry_rcu(srv, &grp->m_members, m_group_node)
+    {
+        if (taken == count)
+            break;
+        if (srv != home && (members[taken] = server_tryget(srv)))
+            taken++;
+    }
+    rcu_read_unlock();
+
+    for (int i = 0; i < taken; i++)
+    {
+        if (notification_send_to_server(members[i], type, con))
+            ERR("Failed to notify server (ID:%d) in group '%s'", members[i]->m_id, home->m_name);
+        server_put(members[i]);
+    }
+    kfree(members);
 }
 
 // поиск сервера
@@ -203,38 +665,30 @@ struct server_t *find_server_by_id_pid(int id, pid_t pid)
     }
     INF("Finding server with ID: %d PID: %d", id, pid);
 
-    mutex_lock(&g_servers_lock);
+    struct server_t *server = find_server_by_id(id);
 
-    // проходимся по каждому клиенту и ищем подходящего
-    struct server_t *server = NULL;
-
-    // Итерируемся по списку клиентов
-    list_for_each_entry(server, &g_servers_list, list)
+    if (!server || !server->m_task_p || server->m_task_p->m_reg_task->m_task_p->pid != pid)
     {
-        if (!server)
-        {
-            ERR("NULL server entry");
-            mutex_unlock(&g_servers_lock);
-            return NULL;
-        }
+        INF("Server not found with (ID:%d)(PID:%d)", id, pid);
+        server_put(server);
+        return NULL;
+    }
 
-        mutex_lock(&server->m_lock);
+    INF("FOUND server (ID:%d)(PID:%d)(NAME:%s)", server->m_id, pid, server->m_name);
+    return server;
+}
 
-        if (server->m_task_p && server->m_task_p->m_reg_task->m_task_p->pid == pid && server->m_id == id)
-        {
-            INF("FOUND server (ID:%d)(PID:%d)(NAME:%s)", server->m_id, server->m_task_p->m_reg_task->m_task_p->pid,
-                server->m_name);
+struct server_t *find_server_by_id_owner(int id, struct reg_task_t *reg_task)
+{
+    struct server_t *server = find_server_by_id(id);
 
-            mutex_unlock(&server->m_lock);
-            mutex_unlock(&g_servers_lock);
-            return server;
-        }
-        mutex_unlock(&server->m_lock);
+    if (!server || !server->m_task_p || server->m_task_p->m_reg_task != reg_task)
+    {
+        INF("Server (ID:%d) is not registered by this task", id);
+        server_put(server);
+        return NULL;
     }
-    INF("Server not found with (ID:%d)(PID:%d)", id, pid);
-    mutex_unlock(&g_servers_lock);
-
-    return NULL;
+    return server;
 }
 
 struct server_t *find_server_by_id(int id)
@@ -247,38 +701,14 @@ struct server_t *find_server_by_id(int id)
     }
     INF("Finding server with ID: %d", id);
 
-    mutex_lock(&g_servers_lock);
+    rcu_read_lock();
+    struct server_t *server = server_tryget(xa_load(&g_servers_xa, id));
+    rcu_read_unlock();
 
-    // проходимся по каждому клиенту и ищем подходящего
-    struct server_t *server = NULL;
+    if (!server)
+        INF("Server not found with (ID:%d)", id);
 
-    // Итерируемся по списку клиентов
-    list_for_each_entry(server, &g_servers_list, list)
-    {
-        if (!server)
-        {
-            ERR("NULL server entry");
-            mutex_unlock(&g_servers_lock);
-            return NULL;
-        }
-
-        mutex_lock(&server->m_lock);
-
-        if (server->m_id == id)
-        {
-            INF("FOUND server (ID:%d)(PID:%d)(NAME:%s)", server->m_id, server->m_task_p->m_reg_task->m_task_p->pid,
-                server->m_name);
-
-            mutex_unlock(&server->m_lock);
-            mutex_unlock(&g_servers_lock);
-            return server;
-        }
-        mutex_unlock(&server->m_lock);
-    }
-    mutex_unlock(&g_servers_lock);
-    INF("Server not found with (ID:%d)", id);
-
-    return NULL;
+    return server;
 }
 
 // поиск клиента из списка сервера по task_struct
@@ -304,9 +734,11 @@ struct client_t *find_client_by_task_from_server(struct task_struct *task, struc
         if (conn->conn->m_client_p->m_task_p->m_reg_task->m_task_p == task)
         {
             // Нашли совпадение - сохраняем результат
+            struct client_t *client = conn->conn->m_client_p;
+            client_get(client);
             mutex_unlock(&serv->m_con_list_lock);
             mutex_unlock(&serv->m_lock);
-            return conn->conn->m_client_p;
+            return client;
         }
     }
     mutex_unlock(&serv->m_con_list_lock);
@@ -315,13 +747,50 @@ struct client_t *find_client_by_task_from_server(struct task_struct *task, struc
 }
 
 // добавление клиента к серверу
-int connect_client_to_server(struct server_t *server, struct client_t *client)
+int connect_client_to_server(struct server_t *server, struct client_t *client, size_t region_size)
 {
     INF("Connecting client (ID:%d)(PID:%d) to server (ID:%d)(PID:%d)", client->m_id,
         client->m_task_p->m_reg_task->m_task_p->pid, server->m_id, server->m_task_p->m_reg_task->m_task_p->pid);
 
+    // к каналу не подключаются, на него подписываются (IOCTL_CHANNEL_SUBSCRIBE)
+    if (server->m_flags & SERVER_FLAG_CHANNEL)
+    {
+        ERR("CONNECT_TO_SERVER: server (ID:%d) is a channel", server->m_id);
+        return -EINVAL;
+    }
+
+    // размер подобласти согласуется с ограничением сервера
+    if (region_size == 0)
+        region_size = SHM_REGION_PAGE_SIZE;
+    region_size = min(region_size, server->m_max_region_size);
+
     // ищем свободную подобласть памяти
-    struct sub_mem_t *sub = get_free_submem();
+    struct sub_mem_t *sub = NULL;
+    if (server->m_flags & SERVER_FLAG_HUGE_PAGES)
+    {
+        sub = get_free_huge_submem(server->m_numa_node);
+
+        // огромных страниц может не найтись из-за фрагментации памяти
+        if (!sub)
+        {
+            INF("CONNECT_TO_SERVER: no huge sub mem, falling back to regular pages");
+            region_size = min(region_size, (size_t)SHM_REGION_MAX_SIZE);
+        }
+    }
+    if (!sub)
+        sub = get_free_submem(server->m_numa_node, region_size);
+    if (!sub)
+    {
+        ERR("CONNECT_TO_SERVER: there is no free sub mem (SIZE: %zu)", region_size);
+        return -ENOMEM;
+    }
+
+    // подобласть из запаса уже обнулена, включая дверной звонок: остается сообщить сторонам ее размер
+    submem_publish_size(sub);
+
+    // запрос может уйти другому участнику группы, поэтому сервер соединения не должен забирать его со звонка
+    if (server->m_flags & SERVER_FLAG_ROUTE)
+        submem_publish_routed(sub);
 
     // создаем объект соединения
     struct connection_t *con = create_connection(client, server, sub);
@@ -330,6 +799,7 @@ int connect_client_to_server(struct server_t *server, struct client_t *client)
     if (!con)
     {
         ERR("CONNECT_TO_SERVER: failed to create connection_t object");
+        submem_release(sub);
         goto falied_create_con;
     }
 
@@ -359,7 +829,7 @@ void server_add_connection(struct server_t *srv, struct connection_t *con)
 
     mutex_lock(&srv->m_lock);
     // создание объекта списка соединения
-    struct serv_conn_list_t *s_con = kmalloc(sizeof(*s_con), GFP_KERNEL);
+    struct serv_conn_list_t *s_con = kmem_cache_alloc(g_srv_conns_cache, GFP_KERNEL);
     if (!s_con)
     {
         ERR("Failed to allocate memory for serv_conn_list_t");
@@ -372,36 +842,15 @@ void server_add_connection(struct server_t *srv, struct connection_t *con)
 
     // блокировка списка соединений сервера для добавления нового соединения
     mutex_lock(&srv->m_con_list_lock);
+    con->m_srv_conn = s_con;
     list_add(&s_con->list, &srv->connection_list.list);
+    atomic_inc(&srv->m_conn_count);
     mutex_unlock(&srv->m_con_list_lock);
     mutex_unlock(&srv->m_lock);
 }
 
-// удалить подключение
-void server_delete_connection(struct server_t *srv, struct serv_conn_list_t *con)
-{
-    // проверка на существование подключения
-    if (!con | !srv)
-    {
-        ERR("there is no connection or server object");
-        return;
-    }
-
-    // глобальная блокировка серверов для удаления подключения
-    if (con->conn)
-    {
-        con->conn->m_server_p = NULL;
-        delete_connection(con->conn);
-        INF("server disconnected");
-    }
-    else
-        INF("server doesnt have con ptr");
-
-    list_del(&con->list);
-    kfree(con);
-}
-
-struct serv_conn_list_t *server_find_conn_by_sub_mem_id(struct server_t *srv, int sub_mem_id)
+// поиск соединения подобласти, которое принадлежит srv или (routed) его группе с маршрутизацией
+static struct connection_t *server_find_conn(struct server_t *srv, int sub_mem_id, bool routed)
 {
     // проверяем входные данные
     if (!srv || !IS_ID_VALID(sub_mem_id))
@@ -411,59 +860,37 @@ struct serv_conn_list_t *server_find_conn_by_sub_mem_id(struct server_t *srv, in
     }
     INF("Finding connection in server (ID: %d)(NAME: %s) with (SUB MEM ID: %d)", srv->m_id, srv->m_name, sub_mem_id);
 
-    // соединение с клиентом и памятью
-    struct serv_conn_list_t *conn = NULL;
-
-    mutex_lock(&srv->m_lock);
-    mutex_lock(&srv->m_con_list_lock);
-    // Итерируемся по списку подключений
-    list_for_each_entry(conn, &srv->connection_list.list, list)
+    // подобласть знает свое соединение; подобласти живут до выгрузки модуля, соединения освобождаются через RCU
+    // простаивающий пул могут освободить, поэтому подобласть ищется тоже под RCU
+    struct connection_t *con = NULL;
+    rcu_read_lock();
+    struct sub_mem_t *sub = find_submem_by_id(sub_mem_id);
+    if (sub)
     {
-        if (conn && conn->conn && conn->conn->m_mem_p && conn->conn->m_mem_p->m_id == sub_mem_id)
-        {
-            // Нашли совпадение - сохраняем результат
-            mutex_unlock(&srv->m_con_list_lock);
-            mutex_unlock(&srv->m_lock);
-            return conn;
-        }
+        con = rcu_dereference(sub->m_conn_p);
+
+        // соединение принадлежит другому серверу
+        struct server_t *home = con ? READ_ONCE(con->m_server_p) : NULL;
+        bool own = home && (home == srv || (routed && srv->m_group && (srv->m_flags & SERVER_FLAG_ROUTE) &&
+                                            home->m_group == srv->m_group));
+        con = own ? connection_tryget(con) : NULL;
     }
-    mutex_unlock(&srv->m_con_list_lock);
-    mutex_unlock(&srv->m_lock);
-    INF("Connection not found in server (ID: %d)(NAME: %s) with (SUB MEM ID: %d)", srv->m_id, srv->m_name, sub_mem_id);
-    return NULL;
+    rcu_read_unlock();
+
+    if (!con)
+        INF("Connection not found in server (ID: %d)(NAME: %s) with (SUB MEM ID: %d)", srv->m_id, srv->m_name,
+            sub_mem_id);
+    return con;
 }
 
-struct serv_conn_list_t *server_find_conn(struct server_t *srv, struct connection_t *con)
+struct connection_t *server_get_conn_by_sub_mem_id(struct server_t *srv, int sub_mem_id)
 {
-    // проверяем входные данные
-    if (!srv || !con)
-    {
-        ERR("Invalid input params");
-        return NULL;
-    }
-    INF("Finding connection in server (ID: %d)(NAME: %s)", srv->m_id, srv->m_name);
-
-    // соединение с клиентом и памятью
-    struct serv_conn_list_t *conn = NULL;
+    return server_find_conn(srv, sub_mem_id, false);
+}
 
-    mutex_lock(&srv->m_lock);
-    mutex_lock(&srv->m_con_list_lock);
-    // Итерируемся по списку подключений
-    list_for_each_entry(conn, &srv->connection_list.list, list)
-    {
-        if (conn && conn->conn && conn->conn == con)
-        {
-            // Нашли совпадение - сохраняем результат
-            INF("Connection found");
-            mutex_unlock(&srv->m_con_list_lock);
-            mutex_unlock(&srv->m_lock);
-            return conn;
-        }
-    }
-    mutex_unlock(&srv->m_con_list_lock);
-    mutex_unlock(&srv->m_lock);
-    INF("Connection not found in server (ID: %d)(NAME: %s)", srv->m_id, srv->m_name);
-    return NULL;
+struct connection_t *server_get_routed_conn_by_sub_mem_id(struct server_t *srv, int sub_mem_id)
+{
+    return server_find_conn(srv, sub_mem_id, true);
 }
 
 void server_get_data(struct server_t *srv, struct st_server *dest)
@@ -479,6 +906,11 @@ void server_get_data(struct server_t *srv, struct st_server *dest)
     mutex_lock(&srv->m_lock);
     
     dest->id = srv->m_id;
+    dest->numa_node = srv->m_numa_node;
+    dest->group_size = srv->m_group ? READ_ONCE(srv->m_group->m_count) : 0;
+    strscpy(dest->route_prefix, srv->m_route_prefix, MAX_ROUTE_PREFIX);
+    dest->subscribers = (srv->m_flags & SERVER_FLAG_CHANNEL) ? channel_subscribers(srv) : -1;
+    dest->flags = srv->m_flags;
     strncpy(dest->name, srv->m_name, MAX_SERVER_NAME);
     dest->name[MAX_SERVER_NAME-1] = '\0';
     dest->conn_count = 0;
@@ -508,6 +940,7 @@ void server_get_data(struct server_t *srv, struct st_server *dest)
 
         // копируем данные о соединениях
         dest->conn_ids[dest->conn_count] = conn->conn->m_client_p->m_id;
+        dest->conn_nodes[dest->conn_count] = conn->conn->m_mem_p ? conn->conn->m_mem_p->m_node : NUMA_NO_NODE;
         dest->conn_count++;
     }
 
@@ -524,8 +957,7 @@ get_data_failed:
 // удаление списка
 void delete_server_list()
 {
-    mutex_lock(&g_servers_lock);
+    // server_destroy сам берет g_servers_lock
     struct server_t *server, *server_tmp;
     list_for_each_entry_safe(server, server_tmp, &g_servers_list, list) server_destroy(server);
-    mutex_unlock(&g_servers_lock);
 }
\ No newline at end of file
@@ -4,17 +4,43 @@
 #include "ripc.h"
 #include "connection.h"
 
+#include <linux/hashtable.h>
+#include <linux/kref.h>
 #include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/xarray.h>
 
 /**
  * Определение структуры сервера и операций над ней
  */
 
+// Размер очереди прямого приема: у каждого клиента не больше одного запроса в полете
+#define SERVER_RECV_QUEUE_SIZE MAX_CLIENTS_PER_SERVER
+
+/**
+ * Группа серверов с одним именем: каждое новое подключение получает один из участников.
+ * Состав меняется под g_servers_lock, читается под RCU.
+ */
+struct server_group_t
+{
+    unsigned int m_flags;       // политика распределения (SERVER_FLAG_BALANCE_LEAST, SERVER_FLAG_ROUTE)
+    struct list_head m_members; // участники группы (server_t::m_group_node)
+    int m_count;                // количество участников
+    atomic_t m_next;            // счетчик выдачи по кругу
+    struct kref m_ref;          // ссылки участников
+    struct rcu_head m_rcu;      // отложенное освобождение после читателей
+};
+
 struct server_t
 {
     char m_name[MAX_SERVER_NAME];
     int m_id;                    // id клиента в процессе
     struct servers_list_t* m_task_p; // указатель на задачу, где зарегистрирован сервер
+    size_t m_max_region_size;    // максимальный размер подобласти на одно соединение
+    unsigned int m_flags;        // SERVER_FLAG_*
+    int m_numa_node;             // узел NUMA, на котором выделяются подобласти соединений
     struct serv_conn_list_t
     {
         struct connection_t *conn; // указатель на соединение
@@ -23,65 +49,157 @@ struct server_t
     struct mutex m_con_list_lock; // блокировка списка соединений
     struct mutex m_lock;          // блокировка доступа к серверу
     struct list_head list;        // список серверов
+    struct hlist_node m_name_node; // узел в индексе серверов по имени
+    struct server_group_t *m_group;   // группа серверов с этим именем (NULL - сервер один)
+    struct list_head m_group_node;    // узел в списке участников группы
+    atomic_t m_conn_count;            // количество соединений (для распределения в группе)
+    char m_route_prefix[MAX_ROUTE_PREFIX]; // префикс URL запросов участника в группе с маршрутизацией
+    size_t m_route_len;                    // длина префикса (0 - участник принимает любые запросы)
+    struct kref m_ref;             // счетчик ссылок: таблицы серверов, соединения, текущие запросы
+    struct rcu_head m_rcu;         // отложенное освобождение после читателей
+
+    // канал публикации (SERVER_FLAG_CHANNEL): одна подобласть на всех подписчиков
+    struct sub_mem_t *m_channel_mem; // подобласть канала, возвращается в пул вместе с сервером
+    struct list_head m_subscribers;  // подписчики (channel_sub_t)
+    struct mutex m_sub_lock;         // блокировка подписчиков и публикации
+    int m_sub_count;                 // количество подписчиков
+    int m_channel_closed;            // сервер удаляется: новые подписки не принимаются
+    unsigned int m_channel_seq;      // количество публикаций
+    wait_queue_head_t m_queue_wq;    // исполнители очереди заданий, ждущие задание (будятся по одному)
+    spinlock_t m_queue_lock;         // блокировка счетчика ждущих исполнителей
+    int m_queue_waiters;             // ждущие исполнители (копия - в заголовке очереди для издателя)
+
+    // прямой прием запросов через IOCTL_SERVER_REPLY_RECV, минуя уведомления процесса
+    spinlock_t m_recv_lock;                                        // блокировка очереди запросов
+    int m_recv_direct;                                             // включен ли прямой прием
+    unsigned int m_recv_head;                                      // позиция записи
+    unsigned int m_recv_tail;                                      // позиция чтения
+    struct notification_data m_recv_queue[SERVER_RECV_QUEUE_SIZE]; // очередь запросов NEW_MESSAGE
+    wait_queue_head_t m_recv_wq;                                   // ожидание следующего запроса
 };
 
-// Список серверов и его блокировка
+// Список серверов: изменяется под g_servers_lock, читается под RCU
 extern struct list_head g_servers_list;
 extern struct mutex g_servers_lock;
 
+// Индекс серверов по имени: изменяется под g_servers_lock, читается под RCU
+#define SERVERS_NAME_HASH_BITS 10
+extern DECLARE_HASHTABLE(g_servers_by_name, SERVERS_NAME_HASH_BITS);
+
+// Таблица серверов по id
+extern struct xarray g_servers_xa;
+
 /**
  * Операции над сервером
  */
 
+// создание и удаление кэшей объектов сервера (при загрузке и выгрузке модуля)
+int server_cache_create(void);
+void server_cache_destroy(void);
+
+// освобождение записи, удаленной из списка соединений сервера
+void server_conn_entry_free(struct server_t *srv, struct serv_conn_list_t *entry);
+
 // создание сервера
-struct server_t *server_create(const char *name);
+struct server_t *server_create(const char *name, size_t max_region_size, unsigned int flags, int numa_node,
+                               const char *route_prefix);
 
 // прикрепление к определенному процессу
 void server_add_task(struct server_t *srv, struct servers_list_t*task);
 
-// очистка одного соединения сервера
+// очистка одного соединения сервера (вызывающий держит ссылку на соединение)
 void server_cleanup_connection(
-    struct server_t* srv, struct serv_conn_list_t* scon);
+    struct server_t* srv, struct connection_t* conn);
 
 // очистка всех соединений сервера
 void server_cleanup_connections(struct server_t *srv);
 
-// удаление сервера
+// удаление сервера из таблиц, память освобождается с последней ссылкой
 void server_destroy(struct server_t *srv);
 
-// поиск сервера по имени
+// захват и освобождение ссылки на сервер
+void server_get(struct server_t *srv);
+void server_put(struct server_t *srv);
+
+// поиск сервера по имени, возвращает сервер со ссылкой (освобождается через server_put)
 struct server_t *find_server_by_name(const char *name);
 
-// поиск сервера по id и pid
+// выбор участника группы с этим именем для нового подключения, возвращает сервер со ссылкой
+struct server_t *pick_server_by_name(const char *name);
+
+/**
+ * @brief Выбор участника группы с маршрутизацией для запроса с этим URL
+ * @param home сервер, владеющий соединением
+ * @return struct server_t* другой участник со ссылкой или NULL, если запрос остается у home
+ */
+struct server_t *server_route_request(struct server_t *home, const char *url, size_t len);
+
+// уведомление остальных участников группы с маршрутизацией о событии соединения home
+void server_route_notify(struct server_t *home, enum notif_type type, struct connection_t *con);
+
+// поиск сервера по id и pid, возвращает сервер со ссылкой (освобождается через server_put)
 struct server_t *find_server_by_id_pid(int id, pid_t pid);
 
-// поиск сервера по id и pid
+struct reg_task_t;
+
+/**
+ * @brief Поиск сервера, зарегистрированного через открытое устройство reg_task.
+ * Владелец определяется регистрацией, а не pid: вызывать может любой поток процесса.
+ * @return struct server_t* сервер со ссылкой (освобождается через server_put) или NULL
+ */
+struct server_t *find_server_by_id_owner(int id, struct reg_task_t *reg_task);
+
+// поиск сервера по id, возвращает сервер со ссылкой (освобождается через server_put)
 struct server_t *find_server_by_id(int id);
 
-// поиск клиента из списка сервера по task_struct
+// поиск клиента из списка сервера по task_struct, возвращает клиента со ссылкой
 struct client_t *find_client_by_task_from_server(
     struct task_struct *task, struct server_t *serv);
 
-// добавление клиента к серверу
-int connect_client_to_server(struct server_t *srv, struct client_t *cli);
+// добавление клиента к серверу с подобластью не меньше region_size байт
+int connect_client_to_server(struct server_t *srv, struct client_t *cli, size_t region_size);
 
 // добавление соединения
 void server_add_connection(struct server_t *srv, struct connection_t *con);
 
-// удаление соединения
-void server_delete_connection(struct server_t *srv, struct serv_conn_list_t *con);
-
-// поиск соединения с необходимой памятью
-struct serv_conn_list_t *server_find_conn_by_sub_mem_id(
+/**
+ * @brief Поиск соединения сервера с необходимой памятью
+ * @return struct connection_t* соединение со ссылкой (освобождается через connection_put) или NULL
+ */
+struct connection_t *server_get_conn_by_sub_mem_id(
     struct server_t *srv, int sub_mem_id);
 
-// поиск соединения по глобальной структуре соединения
-struct serv_conn_list_t *server_find_conn(
-    struct server_t *srv, struct connection_t *con);
+/**
+ * @brief Поиск соединения, запросы которого может получать сервер:
+ * свое соединение или соединение другого участника той же группы с маршрутизацией
+ * @return struct connection_t* соединение со ссылкой (освобождается через connection_put) или NULL
+ */
+struct connection_t *server_get_routed_conn_by_sub_mem_id(
+    struct server_t *srv, int sub_mem_id);
 
 // получение информации о сервере
 void server_get_data(struct server_t* srv, struct st_server* dest);
 
+/**
+ * Прямой прием запросов (IOCTL_SERVER_REPLY_RECV)
+ */
+
+/**
+ * @brief Передача запроса потоку сервера, ожидающему в IOCTL_SERVER_REPLY_RECV
+ * @return int 1 - запрос поставлен в очередь сервера, 0 - нужно обычное уведомление
+ */
+int server_recv_push(struct server_t *srv, const struct notification_data *data);
+
+/**
+ * @brief Ожидание следующего запроса к серверу. Включает прямой прием.
+ * @param timeout_ms время ожидания (0 - без ограничения)
+ * @return int 0 - запрос записан в out, -ETIMEDOUT или -EINTR
+ */
+int server_recv_wait(struct server_t *srv, unsigned int timeout_ms, struct notification_data *out);
+
+// выключение прямого приема: оставшиеся запросы уходят обычными уведомлениями
+void server_recv_stop(struct server_t *srv);
+
 /**
  * Операции над глобальным списком серверов
  */
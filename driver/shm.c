@@ -1,42 +1,299 @@
 #include "shm.h"
 #include "err.h"
 
+#include <linux/log2.h>
 #include <linux/mm.h>
+#include <linux/nodemask.h>
+#include <linux/numa.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/rculist.h>
+#include <linux/shrinker.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 // Список соединений и его блокировка
 LIST_HEAD(g_shm_list);
 DEFINE_MUTEX(g_shm_lock);
 
+// Таблица подобластей по id
+DEFINE_XARRAY(g_submems_xa);
+
+// Сколько свободных подобластей минимального размера держать наготове на каждом узле NUMA
+static unsigned int shm_warm_subs = 4 * SHM_POOL_SIZE;
+module_param(shm_warm_subs, uint, 0444);
+MODULE_PARM_DESC(shm_warm_subs, "Number of pre-zeroed minimum-size sub regions kept ready on each NUMA node");
+
+// Через сколько секунд простоя пул возвращается системе
+static unsigned int shm_idle_grace_sec = SHM_IDLE_GRACE_SEC;
+module_param(shm_idle_grace_sec, uint, 0644);
+MODULE_PARM_DESC(shm_idle_grace_sec, "Seconds a pool without connections is kept before it is freed");
+
+// Свободные очищенные подобласти по процессорам (только подобласти узла процессора)
+static DEFINE_PER_CPU(struct submem_free_list, g_submem_free);
+
+// Свободные подобласти и желаемый запас по узлам NUMA (nr_node_ids элементов)
+static struct submem_node *g_submem_nodes;
+
+// Освобожденные подобласти, ждущие очистки
+static LLIST_HEAD(g_submem_dirty);
+
+// Фоновая очистка освобожденных подобластей и пополнение запаса
+static void shm_refill_work_fn(struct work_struct *work);
+static DECLARE_WORK(g_shm_refill_work, shm_refill_work_fn);
+static atomic_t g_shm_refill_stopped = ATOMIC_INIT(0);
+
+// Освобождение простаивающих пулов: по таймеру и по запросу ядра при нехватке памяти
+static void shm_reclaim_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(g_shm_reclaim_work, shm_reclaim_work_fn);
+static DEFINE_MUTEX(g_shm_reclaim_lock);
+static struct shrinker *g_shm_shrinker;
+
+/**
+ * Списки свободных подобластей
+ */
+
+static void submem_list_init(struct submem_free_list *fl)
+{
+    spin_lock_init(&fl->m_lock);
+    for (int pool_class = 0; pool_class < SHM_CLASSES; pool_class++)
+        INIT_LIST_HEAD(&fl->m_subs[pool_class]);
+}
+
+// положить очищенную подобласть в список текущего процессора, если он на узле пула, иначе - в общий список узла
+static void submem_free_push(struct sub_mem_t *sub)
+{
+    struct shm_t *shm = sub->m_shm;
+    struct submem_node *sn = &g_submem_nodes[shm->m_node];
+    int cpu = raw_smp_processor_id();
+    struct submem_free_list *fl = cpu_to_node(cpu) == shm->m_node ? per_cpu_ptr(&g_submem_free, cpu) : &sn->m_free;
+
+    spin_lock(&fl->m_lock);
+    list_add(&sub->m_free_node, &fl->m_subs[shm->m_class]);
+    sub->m_free_list = fl;
+    spin_unlock(&fl->m_lock);
+    atomic_inc(&sn->m_free_count[shm->m_class]);
+}
+
+// взять подобласть из списка fl
+static struct sub_mem_t *submem_free_pop_list(struct submem_free_list *fl, int pool_class)
+{
+    struct sub_mem_t *sub;
+
+    spin_lock(&fl->m_lock);
+    sub = list_first_entry_or_null(&fl->m_subs[pool_class], struct sub_mem_t, m_free_node);
+    if (sub)
+        list_del_init(&sub->m_free_node);
+    spin_unlock(&fl->m_lock);
+    return sub;
+}
+
+// взять подобласть узла node: у своего процессора, из общего списка узла, потом у остальных процессоров узла
+static struct sub_mem_t *submem_free_pop(int node, int pool_class)
+{
+    struct submem_node *sn = &g_submem_nodes[node];
+    int this_cpu = raw_smp_processor_id();
+    struct sub_mem_t *sub = NULL;
+    int cpu;
+
+    if (cpu_to_node(this_cpu) == node)
+        sub = submem_free_pop_list(per_cpu_ptr(&g_submem_free, this_cpu), pool_class);
+    if (!sub)
+        sub = submem_free_pop_list(&sn->m_free, pool_class);
+    if (!sub)
+    {
+        for_each_possible_cpu(cpu)
+        {
+            if (cpu == this_cpu || cpu_to_node(cpu) != node)
+                continue;
+            sub = submem_free_pop_list(per_cpu_ptr(&g_submem_free, cpu), pool_class);
+            if (sub)
+                break;
+        }
+    }
+
+    if (sub)
+    {
+        atomic_dec(&sn->m_free_count[pool_class]);
+        atomic_inc(&sub->m_shm->m_used);
+        atomic_set(&sub->m_claimed, 1);
+    }
+    return sub;
+}
+
+// запуск фонового пополнения, если запас какого-то класса узла ниже желаемого
+static void shm_refill_kick(int node, int pool_class)
+{
+    struct submem_node *sn = &g_submem_nodes[node];
+
+    if (atomic_read(&g_shm_refill_stopped))
+        return;
+
+    if (!llist_empty(&g_submem_dirty) ||
+        atomic_read(&sn->m_free_count[pool_class]) < atomic_read(&sn->m_warm_target[pool_class]))
+        queue_work(system_unbound_wq, &g_shm_refill_work);
+}
+
+static void shm_refill_work_fn(struct work_struct *work)
+{
+    // очищаем освобожденные подобласти: новое соединение не должно видеть чужие данные
+    struct llist_node *dirty = llist_del_all(&g_submem_dirty);
+    struct sub_mem_t *sub, *tmp;
+    llist_for_each_entry_safe(sub, tmp, dirty, m_dirty_node)
+    {
+        struct shm_t *shm = sub->m_shm;
+        memset(sub->m_vaddr, 0, sub->m_size);
+        submem_free_push(sub);
+
+        // последняя занятая подобласть вернулась: пул начинает простаивать
+        if (atomic_dec_and_test(&shm->m_used))
+        {
+            WRITE_ONCE(shm->m_idle_since, jiffies);
+            queue_delayed_work(system_unbound_wq, &g_shm_reclaim_work,
+                               msecs_to_jiffies(READ_ONCE(shm_idle_grace_sec) * MSEC_PER_SEC));
+        }
+        cond_resched();
+    }
+
+    // пополняем запас каждого класса на каждом узле до желаемого
+    int node;
+    for_each_node_state(node, N_MEMORY)
+    {
+        struct submem_node *sn = &g_submem_nodes[node];
+
+        for (int pool_class = 0; pool_class < SHM_CLASSES; pool_class++)
+        {
+            while (!atomic_read(&g_shm_refill_stopped) &&
+                   atomic_read(&sn->m_free_count[pool_class]) < atomic_read(&sn->m_warm_target[pool_class]))
+            {
+                if (!shm_create(node, pool_class))
+                {
+                    ERR("Cant refill sub mem pool (NODE: %d)(CLASS: %d)", node, pool_class);
+                    break;
+                }
+            }
+        }
+    }
+}
+
 /**
  * Операции над объектом соединения
  */
 
+// выделение огромных страниц под подобласти пула
+static int shm_alloc_huge_pages(struct shm_t *shm)
+{
+    for (int i = 0; i < SHM_POOL_SIZE; i++)
+    {
+        // без __GFP_NORETRY уплотнение памяти может надолго задержать подключение,
+        // при неудаче сервер получает обычные страницы
+        struct page *page = alloc_pages_node(
+            shm->m_node, GFP_KERNEL | __GFP_ZERO | __GFP_COMP | __GFP_NOWARN | __GFP_NORETRY, SHM_HUGE_ORDER);
+        if (!page)
+        {
+            while (i--)
+                __free_pages(shm->m_sub_mems[i].m_page, SHM_HUGE_ORDER);
+            return -ENOMEM;
+        }
+        shm->m_sub_mems[i].m_page = page;
+    }
+    return 0;
+}
+
+// выделение страниц пула на его узле и отображение их в непрерывный адрес ядра
+static int shm_alloc_pages(struct shm_t *shm)
+{
+    shm->m_pages = kvcalloc(shm->m_num_of_pages, sizeof(*shm->m_pages), GFP_KERNEL);
+    if (!shm->m_pages)
+        return -ENOMEM;
+
+    // узел - предпочтение: при его нехватке страницы возьмутся с соседнего
+    for (int i = 0; i < shm->m_num_of_pages; i++)
+    {
+        shm->m_pages[i] = alloc_pages_node(shm->m_node, GFP_KERNEL | __GFP_ZERO, 0);
+        if (!shm->m_pages[i])
+            goto failed;
+    }
+
+    // VM_USERMAP: память пула отображается в процессы через remap_vmalloc_range,
+    // VM_MAP_PUT_PAGES: vfree сам освободит страницы и массив (в том числе из обратного вызова RCU)
+    shm->m_vaddr = vmap(shm->m_pages, shm->m_num_of_pages, VM_USERMAP | VM_MAP_PUT_PAGES, PAGE_KERNEL);
+    if (!shm->m_vaddr)
+        goto failed;
+    return 0;
+
+failed:
+    for (int i = 0; i < shm->m_num_of_pages && shm->m_pages[i]; i++)
+        __free_page(shm->m_pages[i]);
+    kvfree(shm->m_pages);
+    return -ENOMEM;
+}
+
+// освобождение страниц пула
+static void shm_free_pages(struct shm_t *shm)
+{
+    if (shm->m_class != SHM_HUGE_CLASS)
+    {
+        vfree(shm->m_vaddr);
+        return;
+    }
+
+    for (int i = 0; i < SHM_POOL_SIZE; i++)
+        __free_pages(shm->m_sub_mems[i].m_page, SHM_HUGE_ORDER);
+}
+
 // создание области общей памяти
-struct shm_t *shm_create()
+struct shm_t *shm_create(int node, int pool_class)
 {
-    INF("Create sheared memory pool");
+    INF("Create sheared memory pool (NODE: %d)(CLASS: %d)", node, pool_class);
 
-    // выделяем память под структуру
-    struct shm_t *shm = kmalloc(sizeof(*shm), GFP_KERNEL);
+    if (pool_class < 0 || pool_class >= SHM_CLASSES)
+    {
+        ERR("Incorrect pool class: %d", pool_class);
+        return NULL;
+    }
+    if (!shm_node_valid(node))
+    {
+        ERR("Incorrect NUMA node: %d", node);
+        return NULL;
+    }
+
+    // выделяем память под структуру рядом с памятью пула
+    struct shm_t *shm = kmalloc_node(sizeof(*shm), GFP_KERNEL, node);
     if (!shm)
     {
         ERR("Cant allocate shared memory struct");
         return NULL;
     }
 
-    // аллоцируем страницы памяти
-    shm->m_num_of_pages = SHM_POOL_PAGE_NUMBER;
-    shm->m_pages_p = alloc_pages(GFP_KERNEL | __GFP_ZERO, SHM_REGION_ORDER);
+    shm->m_class = pool_class;
+    shm->m_node = node;
+    shm->m_region_order = pool_class == SHM_HUGE_CLASS ? SHM_HUGE_ORDER : pool_class;
+    shm->m_num_of_pages = SHM_POOL_SIZE << shm->m_region_order;
+    shm->m_size = (size_t)shm->m_num_of_pages * PAGE_SIZE;
+    shm->m_vaddr = NULL;
+    shm->m_pages = NULL;
 
-    if (!shm->m_pages_p)
+    if (pool_class == SHM_HUGE_CLASS)
+    {
+        // каждая подобласть - отдельная физически непрерывная огромная страница,
+        // отображается в процесс одной записью PMD
+        if (shm_alloc_huge_pages(shm))
+        {
+            INF("Cant allocate huge pages for pool");
+            goto failed_page_alloc;
+        }
+    }
+    else
     {
-        ERR("Cant allocate %d pages", shm->m_num_of_pages);
-        goto failed_page_alloc;
+        // аллоцируем страницы памяти: пул не обязан быть физически непрерывным
+        if (shm_alloc_pages(shm))
+        {
+            ERR("Cant allocate %d pages", shm->m_num_of_pages);
+            goto failed_page_alloc;
+        }
     }
 
-    // помечаем страницы невытесняемыми, чтобы ядро их не вытеснило
-    SetPageReserved(shm->m_pages_p);
-
     // инициализация под областей
     for (int i = 0; i < SHM_POOL_SIZE; i++)
     {
@@ -46,25 +303,41 @@ struct shm_t *shm_create()
     // генерация id
     shm->m_id = generate_id(&g_id_gen);
 
-    shm->m_size = SHM_POOL_BYTE_SIZE;
+    // все подобласти свободны
+    atomic_set(&shm->m_used, 0);
+    shm->m_idle_since = jiffies;
+    INIT_LIST_HEAD(&shm->m_reclaim_node);
 
     // добавление в список общих паметей
     INIT_LIST_HEAD(&shm->list);
     mutex_lock(&g_shm_lock);
-    list_add(&shm->list, &g_shm_list);
+    list_add_rcu(&shm->list, &g_shm_list);
     mutex_unlock(&g_shm_lock);
 
-    INF("Shared memory allocated (ID:%d)", shm->m_id);
+    // память выделена обнуленной: подобласти сразу свободны
+    for (int i = 0; i < SHM_POOL_SIZE; i++)
+        submem_free_push(&shm->m_sub_mems[i]);
+
+    INF("Shared memory allocated (ID:%d)(%zu bytes)", shm->m_id, shm->m_size);
 
     return shm;
 
 failed_page_alloc:
-    __free_pages(shm->m_pages_p, SHM_REGION_ORDER);
-
     kfree(shm);
     return NULL;
 }
 
+// освобождение памяти пула после читателей таблицы подобластей
+static void shm_free_rcu(struct rcu_head *head)
+{
+    struct shm_t *shm = container_of(head, struct shm_t, m_rcu);
+
+    // отображения подобласти снимаются при ее возврате в пул, то есть раньше,
+    // чем пул станет простаивающим: к этому моменту страниц пула никто не отображает
+    shm_free_pages(shm);
+    kfree(shm);
+}
+
 // удаление области общей памяти
 void shm_destroy(struct shm_t *shm)
 {
@@ -77,6 +350,11 @@ void shm_destroy(struct shm_t *shm)
 
     INF("Destroying shared memory (ID:%d)(%zu bytes)", shm->m_id, shm->m_size);
 
+    // удаление памяти из общего списка; читатели таблицы подобластей под RCU могут еще обращаться к пулу
+    mutex_lock(&g_shm_lock);
+    list_del_rcu(&shm->list);
+    mutex_unlock(&g_shm_lock);
+
     // освобождение id
     free_id(&g_id_gen, shm->m_id);
 
@@ -84,40 +362,168 @@ void shm_destroy(struct shm_t *shm)
     for (int i = 0; i < SHM_POOL_SIZE; i++)
         submem_clear(&shm->m_sub_mems[i]);
 
-    // очистка страниц памяти
-    ClearPageReserved(shm->m_pages_p);
-    __free_pages(shm->m_pages_p, SHM_REGION_ORDER);
+    // страницы и структура освобождаются после текущих читателей
+    call_rcu(&shm->m_rcu, shm_free_rcu);
+}
+
+/**
+ * Освобождение простаивающих пулов
+ */
+
+// отцепление всех подобластей пула от списков свободных; 0 - какую-то подобласть успели занять
+static int shm_detach_free_subs(struct shm_t *shm)
+{
+    int pool_class = shm->m_class;
+    int detached;
+
+    for (detached = 0; detached < SHM_POOL_SIZE; detached++)
+    {
+        struct sub_mem_t *sub = &shm->m_sub_mems[detached];
+        struct submem_free_list *fl = READ_ONCE(sub->m_free_list);
+        int ok;
+
+        // пул еще не успел положить подобласть в список
+        if (!fl)
+            break;
+
+        // подобласть могли забрать и вернуть в другой список
+        spin_lock(&fl->m_lock);
+        ok = sub->m_free_list == fl && !list_empty(&sub->m_free_node);
+        if (ok)
+            list_del_init(&sub->m_free_node);
+        spin_unlock(&fl->m_lock);
+
+        if (!ok)
+            break;
+        atomic_dec(&g_submem_nodes[shm->m_node].m_free_count[pool_class]);
+    }
+
+    if (detached == SHM_POOL_SIZE)
+        return 1;
+
+    // пул снова в работе: возвращаем отцепленные подобласти
+    while (detached--)
+        submem_free_push(&shm->m_sub_mems[detached]);
+    return 0;
+}
+
+
+/**
+ * @brief Освобождение простаивающих пулов сверх теплого запаса. Вызывается под g_shm_reclaim_lock.
+ * @param ignore_grace освобождать, не дожидаясь паузы shm_idle_grace_sec
+ * @param max_pools сколько пулов освободить не больше
+ * @param pending выставляется в 1, если остались пулы, у которых пауза еще не истекла
+ * @return unsigned long количество освобожденных пулов
+ */
+static unsigned long shm_reclaim_idle(int ignore_grace, unsigned long max_pools, int *pending)
+{
+    unsigned long grace = msecs_to_jiffies(READ_ONCE(shm_idle_grace_sec) * MSEC_PER_SEC);
+    unsigned long freed = 0;
+    struct shm_t *shm, *tmp;
+    LIST_HEAD(victims);
 
-    // удаление памяти из общего списка
     mutex_lock(&g_shm_lock);
-    list_del(&shm->list);
+    list_for_each_entry(shm, &g_shm_list, list)
+    {
+        int pool_class = shm->m_class;
+        struct submem_node *sn = &g_submem_nodes[shm->m_node];
+
+        if (freed >= max_pools)
+            break;
+
+        // в пуле есть выданные подобласти (отображения снимаются при их возврате)
+        if (atomic_read(&shm->m_used))
+            continue;
+
+        if (!ignore_grace && time_before(jiffies, READ_ONCE(shm->m_idle_since) + grace))
+        {
+            if (pending)
+                *pending = 1;
+            continue;
+        }
+
+        // теплый запас не трогаем, иначе фоновая работа тут же создаст пул заново
+        if (atomic_read(&sn->m_free_count[pool_class]) - SHM_POOL_SIZE < atomic_read(&sn->m_warm_target[pool_class]))
+            continue;
+
+        if (!shm_detach_free_subs(shm))
+            continue;
+
+        list_del_rcu(&shm->list);
+        list_add(&shm->m_reclaim_node, &victims);
+        freed++;
+    }
     mutex_unlock(&g_shm_lock);
 
-    // освобождение памяти под структуру
-    kfree(shm);
+    list_for_each_entry_safe(shm, tmp, &victims, m_reclaim_node)
+    {
+        INF("Reclaiming idle shared memory (ID:%d)(%zu bytes)", shm->m_id, shm->m_size);
+
+        // подобласти исчезают из таблицы сразу, память - после текущих читателей
+        for (int i = 0; i < SHM_POOL_SIZE; i++)
+            submem_clear(&shm->m_sub_mems[i]);
+        free_id(&g_id_gen, shm->m_id);
+        call_rcu(&shm->m_rcu, shm_free_rcu);
+    }
+
+    return freed;
 }
 
-struct sub_mem_t *shm_get_free_submem(struct shm_t *shm)
+static void shm_reclaim_work_fn(struct work_struct *work)
 {
-    if (!shm)
+    int pending = 0;
+
+    mutex_lock(&g_shm_reclaim_lock);
+    shm_reclaim_idle(0, ULONG_MAX, &pending);
+    mutex_unlock(&g_shm_reclaim_lock);
+
+    // у части пулов пауза еще не истекла
+    if (pending && !atomic_read(&g_shm_refill_stopped))
+        queue_delayed_work(system_unbound_wq, &g_shm_reclaim_work,
+                           msecs_to_jiffies(READ_ONCE(shm_idle_grace_sec) * MSEC_PER_SEC));
+}
+
+static unsigned long shm_shrinker_count(struct shrinker *shrinker, struct shrink_control *sc)
+{
+    unsigned long idle = 0;
+    struct shm_t *shm;
+
+    rcu_read_lock();
+    list_for_each_entry_rcu(shm, &g_shm_list, list)
     {
-        ERR("There is not shm");
-        return NULL;
+        if (!atomic_read(&shm->m_used))
+            idle++;
     }
+    rcu_read_unlock();
 
-    // поиск свободной области
-    for (int i = 0; i < SHM_POOL_SIZE; i++)
+    return idle ? idle : SHRINK_EMPTY;
+}
+
+static unsigned long shm_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
+{
+    if (!mutex_trylock(&g_shm_reclaim_lock))
+        return SHRINK_STOP;
+
+    // при нехватке памяти запас сохраняется только у порядка SHM_REGION_ORDER (его задает shm_warm_subs),
+    // остальные порядки получат его снова при следующем запросе
+    int node;
+    for_each_node_state(node, N_MEMORY)
     {
-        if (!shm->m_sub_mems[i].m_conn_p)
+        for (int pool_class = 0; pool_class < SHM_CLASSES; pool_class++)
         {
-            INF("FOUND free sub mem (ID: %d)", shm->m_sub_mems[i].m_id);
-            return &shm->m_sub_mems[i];
+            if (pool_class == SHM_REGION_ORDER)
+                continue;
+            atomic_set(&g_submem_nodes[node].m_warm_target[pool_class], 0);
         }
     }
-    INF("free sub mem not found");
 
-    return NULL;
+    unsigned long freed = shm_reclaim_idle(1, sc->nr_to_scan, NULL);
+    mutex_unlock(&g_shm_reclaim_lock);
+
+    INF("Shrinker freed %lu idle pools", freed);
+    return freed ? freed : SHRINK_STOP;
 }
+
 void submem_add_connection(
     struct sub_mem_t *sub,
     struct connection_t *con)
@@ -128,7 +534,7 @@ void submem_add_connection(
         return;
     }
 
-    sub->m_conn_p = con;
+    rcu_assign_pointer(sub->m_conn_p, con);
 }
 
 struct sub_mem_t *submem_init(int id, struct shm_t *shm)
@@ -154,15 +560,30 @@ struct sub_mem_t *submem_init(int id, struct shm_t *shm)
 
     // получение id
     sub->m_id = generate_id(&g_id_gen);
+    if (xa_err(xa_store(&g_submems_xa, sub->m_id, sub, GFP_KERNEL)))
+        ERR("Cant add sub mem (ID:%d) to id table", sub->m_id);
 
     // количество байт на подобласть
-    sub->m_size = SHM_REGION_PAGE_SIZE;
+    sub->m_size = PAGE_SIZE << shm->m_region_order;
 
     // нет текущего подключения
     sub->m_conn_p = NULL;
+    atomic_set(&sub->m_claimed, 0);
+    INIT_LIST_HEAD(&sub->m_free_node);
+    sub->m_free_list = NULL;
 
     // получение страниц памяти для этой подпамяти
-    sub->m_pages_p = shm->m_pages_p + id * SHM_REGION_PAGE_NUMBER;
+    sub->m_pgoff = (unsigned long)id << shm->m_region_order;
+    if (shm->m_class == SHM_HUGE_CLASS)
+    {
+        sub->m_vaddr = page_address(sub->m_page);
+    }
+    else
+    {
+        sub->m_page = shm->m_pages[sub->m_pgoff];
+        sub->m_vaddr = shm->m_vaddr + (sub->m_pgoff << PAGE_SHIFT);
+    }
+    sub->m_node = page_to_nid(sub->m_page);
 
     return sub;
 }
@@ -177,9 +598,21 @@ void submem_clear(struct sub_mem_t *sub)
     INF("Deleting sub mem (ID: %d)(BYTE SIZE: %ld)", sub->m_id, sub->m_size);
 
     // удаление id
+    xa_erase(&g_submems_xa, sub->m_id);
     free_id(&g_id_gen, sub->m_id);
 }
 
+struct sub_mem_t *find_submem_by_id(int id)
+{
+    if (!IS_ID_VALID(id))
+    {
+        ERR("Incorrect id: %d", id);
+        return NULL;
+    }
+
+    return xa_load(&g_submems_xa, id);
+}
+
 int submem_disconnect(struct sub_mem_t *sub, struct connection_t* con)
 {
     if (!sub)
@@ -207,45 +640,267 @@ int submem_disconnect(struct sub_mem_t *sub, struct connection_t* con)
     INF("submem disconnect");
 
     // отключение от соединения
-    sub->m_conn_p = NULL;
+    submem_release(sub);
 
     return 0;
 }
 
+void submem_release(struct sub_mem_t *sub)
+{
+    if (!sub)
+    {
+        ERR("There is not submem");
+        return;
+    }
+
+    // подобласть возвращается один раз, даже если ее отпускают и соединение, и ошибка подключения
+    if (!atomic_xchg(&sub->m_claimed, 0))
+        return;
+
+    RCU_INIT_POINTER(sub->m_conn_p, NULL);
+
+    // очистка памяти - не на пути ioctl: подобласть уходит фоновой работе
+    llist_add(&sub->m_dirty_node, &g_submem_dirty);
+    shm_refill_kick(sub->m_shm->m_node, sub->m_shm->m_class);
+}
+
+void submem_replace(struct sub_mem_t **slot, struct sub_mem_t *new)
+{
+    struct sub_mem_t *old = *slot;
+    int old_id = old->m_id;
+    int new_id = new->m_id;
+
+    // сначала новая подобласть получает соединение и id старой: поиск по id всегда находит соединение
+    rcu_assign_pointer(new->m_conn_p, rcu_dereference_protected(old->m_conn_p, 1));
+    WRITE_ONCE(new->m_id, old_id);
+    xa_store(&g_submems_xa, old_id, new, GFP_KERNEL);
+    WRITE_ONCE(*slot, new);
+
+    // старая подобласть уходит на очистку под id новой
+    RCU_INIT_POINTER(old->m_conn_p, NULL);
+    WRITE_ONCE(old->m_id, new_id);
+    xa_store(&g_submems_xa, new_id, old, GFP_KERNEL);
+    submem_release(old);
+}
+
+void submem_swap(struct sub_mem_t **slot_a, struct sub_mem_t **slot_b)
+{
+    struct sub_mem_t *a = *slot_a;
+    struct sub_mem_t *b = *slot_b;
+    struct connection_t *con_a = rcu_dereference_protected(a->m_conn_p, 1);
+    struct connection_t *con_b = rcu_dereference_protected(b->m_conn_p, 1);
+    int id_a = a->m_id;
+    int id_b = b->m_id;
+
+    // поиск по id в любой момент находит подобласть вместе с ее соединением
+    rcu_assign_pointer(b->m_conn_p, con_a);
+    WRITE_ONCE(b->m_id, id_a);
+    xa_store(&g_submems_xa, id_a, b, GFP_KERNEL);
+    WRITE_ONCE(*slot_a, b);
+
+    rcu_assign_pointer(a->m_conn_p, con_b);
+    WRITE_ONCE(a->m_id, id_b);
+    xa_store(&g_submems_xa, id_b, a, GFP_KERNEL);
+    WRITE_ONCE(*slot_b, a);
+}
+
+unsigned long submem_pfn(struct sub_mem_t *sub, unsigned long off)
+{
+    // огромная страница непрерывна, страницы обычного пула - нет
+    if (sub->m_shm->m_class == SHM_HUGE_CLASS)
+        return page_to_pfn(sub->m_page) + (off >> PAGE_SHIFT);
+    return page_to_pfn(sub->m_shm->m_pages[sub->m_pgoff + (off >> PAGE_SHIFT)]);
+}
+
+void submem_publish_size(struct sub_mem_t *sub)
+{
+    struct shm_doorbell *db = sub->m_vaddr;
+
+    // линии клиента, сервера и драйвера не должны съезжать
+    BUILD_BUG_ON(sizeof(struct shm_doorbell) != 3 * RIPC_CACHE_LINE);
+    WRITE_ONCE(db->m_region_size, sub->m_size);
+}
+
+void submem_publish_routed(struct sub_mem_t *sub)
+{
+    struct shm_doorbell *db = sub->m_vaddr;
+    WRITE_ONCE(db->m_routed, 1);
+}
+
 /**
  * Глобальный список
  */
 
+int shm_allocator_init(void)
+{
+    int cpu, node;
+    for_each_possible_cpu(cpu)
+        submem_list_init(per_cpu_ptr(&g_submem_free, cpu));
+
+    // счетчики обнулены kcalloc
+    g_submem_nodes = kcalloc(nr_node_ids, sizeof(*g_submem_nodes), GFP_KERNEL);
+    if (!g_submem_nodes)
+    {
+        ERR("Cant allocate per node sub mem lists");
+        return -ENOMEM;
+    }
+    for (node = 0; node < nr_node_ids; node++)
+        submem_list_init(&g_submem_nodes[node].m_free);
+
+    // теплый запас минимального порядка создается при загрузке на каждом узле с памятью,
+    // остальные порядки получают запас после первого запроса
+    for_each_node_state(node, N_MEMORY)
+    {
+        struct submem_node *sn = &g_submem_nodes[node];
+
+        atomic_set(&sn->m_warm_target[SHM_REGION_ORDER], shm_warm_subs);
+        while (atomic_read(&sn->m_free_count[SHM_REGION_ORDER]) < shm_warm_subs)
+        {
+            if (!shm_create(node, SHM_REGION_ORDER))
+            {
+                ERR("Cant preallocate sub mem pools (NODE: %d)", node);
+                delete_shm_list();
+                return -ENOMEM;
+            }
+        }
+    }
+
+    // ядро может забрать простаивающие пулы при нехватке памяти
+    g_shm_shrinker = shrinker_alloc(0, "ripc-shm");
+    if (!g_shm_shrinker)
+    {
+        ERR("Cant allocate shm shrinker");
+        delete_shm_list();
+        return -ENOMEM;
+    }
+    g_shm_shrinker->count_objects = shm_shrinker_count;
+    g_shm_shrinker->scan_objects = shm_shrinker_scan;
+    g_shm_shrinker->seeks = DEFAULT_SEEKS;
+    shrinker_register(g_shm_shrinker);
+
+    INF("Sub mem allocator ready (WARM SUBS PER NODE: %u)(NODES: %d)", shm_warm_subs, num_node_state(N_MEMORY));
+    return 0;
+}
+
 // удаление списка
 void delete_shm_list(void)
 {
+    // новые пулы больше не создаются и не освобождаются в фоне
+    atomic_set(&g_shm_refill_stopped, 1);
+    if (g_shm_shrinker)
+    {
+        shrinker_free(g_shm_shrinker);
+        g_shm_shrinker = NULL;
+    }
+    cancel_work_sync(&g_shm_refill_work);
+    cancel_delayed_work_sync(&g_shm_reclaim_work);
+
     struct shm_t *shm, *tmp;
     list_for_each_entry_safe(shm, tmp, &g_shm_list, list)
         shm_destroy(shm);
+
+    // пулы освобождаются через call_rcu: ждем обратные вызовы до выгрузки модуля
+    rcu_barrier();
+
+    kfree(g_submem_nodes);
+    g_submem_nodes = NULL;
 }
 
-struct sub_mem_t *get_free_submem(void)
+int shm_size_to_order(size_t size)
 {
-    INF("Getting free submem");
-    struct shm_t *shm = NULL;
-    struct sub_mem_t *sub = NULL;
+    // меньше страницы запроса и страницы ответа подобласть не бывает
+    if (size <= SHM_REGION_PAGE_SIZE)
+        return SHM_REGION_ORDER;
 
-    // проходимся по всему списку и ищем свободную память
-    list_for_each_entry(shm, &g_shm_list, list)
+    int order = order_base_2(DIV_ROUND_UP(size, PAGE_SIZE));
+    return min(order, SHM_REGION_MAX_ORDER);
+}
+
+void shm_get_data(struct st_shm *dest)
+{
+    if (!dest)
     {
-        sub = shm_get_free_submem(shm);
-        if (sub)
-        {
-            INF("FOUND free submem (ID: %d)", sub->m_id);
-            return sub;
-        }
+        ERR("null params");
+        return;
+    }
+
+    memset(dest, 0, sizeof(*dest));
+
+    struct shm_t *shm;
+    rcu_read_lock();
+    list_for_each_entry_rcu(shm, &g_shm_list, list)
+    {
+        int used = atomic_read(&shm->m_used);
+
+        dest->pools_count++;
+        dest->idle_pools += !used;
+        dest->subs_used += used;
+        dest->bytes += shm->m_size;
     }
+    rcu_read_unlock();
 
-    // если нет свободных подобластей, создаем новую область с подобластями
-    INF("There is no free submem");
-    shm = shm_create();
+    int node;
+    for_each_node_state(node, N_MEMORY)
+    {
+        for (int pool_class = 0; pool_class < SHM_CLASSES; pool_class++)
+            dest->subs_free += atomic_read(&g_submem_nodes[node].m_free_count[pool_class]);
+    }
+}
 
-    // получаем свободную подобласть из нее и возвращаем
-    sub = shm_get_free_submem(shm);
+bool shm_node_valid(int node)
+{
+    return node >= 0 && node < nr_node_ids && node_state(node, N_MEMORY);
+}
+
+// взять свободную подобласть класса pool_class на узле node, при пустом запасе создав пул на месте
+static struct sub_mem_t *submem_get(int node, int pool_class)
+{
+    struct sub_mem_t *sub = submem_free_pop(node, pool_class);
+    if (!sub)
+    {
+        // запас исчерпан: создаем пул на месте (его подобласти могут занять параллельные подключения)
+        INF("There is no free submem (NODE: %d)", node);
+        if (shm_create(node, pool_class))
+            sub = submem_free_pop(node, pool_class);
+    }
+
+    // пополнение запаса - вне пути ioctl
+    shm_refill_kick(node, pool_class);
+
+    if (sub)
+        INF("FOUND free submem (ID: %d)(NODE: %d)", sub->m_id, sub->m_node);
     return sub;
 }
+
+struct sub_mem_t *get_free_submem(int node, size_t size)
+{
+    int order = shm_size_to_order(size);
+    INF("Getting free submem (SIZE: %zu)(ORDER: %d)(NODE: %d)", size, order, node);
+
+    if (!shm_node_valid(node))
+    {
+        ERR("Incorrect NUMA node: %d", node);
+        return NULL;
+    }
+
+    // у порядка, который запросили на узле хотя бы раз, появляется свой запас
+    struct submem_node *sn = &g_submem_nodes[node];
+    if (atomic_read(&sn->m_warm_target[order]) < SHM_POOL_SIZE)
+        atomic_set(&sn->m_warm_target[order], SHM_POOL_SIZE);
+
+    return submem_get(node, order);
+}
+
+struct sub_mem_t *get_free_huge_submem(int node)
+{
+    INF("Getting free huge submem (NODE: %d)", node);
+
+    if (!shm_node_valid(node))
+    {
+        ERR("Incorrect NUMA node: %d", node);
+        return NULL;
+    }
+
+    // запас огромных страниц не держится: пулы создаются только по запросу
+    return submem_get(node, SHM_HUGE_CLASS);
+}
@@ -4,7 +4,12 @@
 #include <linux/atomic.h>
 #include <linux/types.h>
 #include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/llist.h>
+#include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/mm_types.h>
+#include <linux/xarray.h>
 
 #include "id.h"
 #include "ripc.h"
@@ -17,41 +22,84 @@ struct sub_mem_t
 {
     int m_id;
     struct shm_t *m_shm;           // родительская область памяти
-    struct page *m_pages_p;        // страницы памяти, относящиеся к этой области
+    void *m_vaddr;                 // адрес подобласти в адресном пространстве ядра
+    struct page *m_page;           // первая страница подобласти (в пулах SHM_HUGE_CLASS - огромная страница)
+    int m_node;                    // узел NUMA, на котором оказалась память подобласти
+    unsigned long m_pgoff;         // смещение подобласти в пуле (в страницах)
     size_t m_size;                 // размер памяти в байтах
-    struct connection_t *m_conn_p; // соединение между клиентом и сервером
+    struct connection_t *m_conn_p; // соединение между клиентом и сервером (читается под RCU)
+    atomic_t m_claimed;            // подобласть выдана соединению
+    struct list_head m_free_node;  // узел в списке свободных подобластей процессора
+    struct submem_free_list *m_free_list; // список, в котором лежит свободная подобласть
+    struct llist_node m_dirty_node; // узел в списке освобожденных, но еще не очищенных подобластей
+};
+
+// Количество порядков подобластей (0..SHM_REGION_MAX_ORDER)
+#define SHM_ORDERS (SHM_REGION_MAX_ORDER + 1)
+
+// Класс пулов на огромных страницах: идет после всех порядков
+#define SHM_HUGE_CLASS SHM_ORDERS
+#define SHM_CLASSES (SHM_ORDERS + 1)
+#define SHM_HUGE_ORDER (ilog2(SHM_HUGE_REGION_SIZE / PAGE_SIZE)) // порядок огромной страницы
+
+// Свободные очищенные подобласти одного процессора
+struct submem_free_list
+{
+    spinlock_t m_lock;
+    struct list_head m_subs[SHM_CLASSES]; // по списку на класс пулов
+};
+
+// Свободные подобласти и запас одного узла NUMA
+struct submem_node
+{
+    struct submem_free_list m_free;      // подобласти узла, освобожденные на процессоре другого узла
+    atomic_t m_free_count[SHM_CLASSES];  // свободные подобласти узла по классам пулов
+    atomic_t m_warm_target[SHM_CLASSES]; // желаемый запас узла по классам пулов
 };
 
 // Область общих памятей
 struct shm_t
 {
-    int m_id;               // идентификатор области памяти
-    short m_num_of_pages;   // размер общей памяти
-    struct page *m_pages_p; // страницы памяти, выделенные под этот memory pool
-    size_t m_size;          // размер пула в байтах
+    int m_id;             // идентификатор области памяти
+    int m_class;          // класс пула: порядок подобластей или SHM_HUGE_CLASS
+    int m_node;           // узел NUMA, для которого выделен пул
+    int m_region_order;   // порядок подобластей пула (2^order страниц на подобласть)
+    int m_num_of_pages;   // размер общей памяти
+    void *m_vaddr;        // память пула (vmap страниц m_pages), у пулов на огромных страницах - NULL
+    struct page **m_pages; // страницы пула (освобождаются вместе с m_vaddr), у пулов на огромных страницах - NULL
+    size_t m_size;        // размер пула в байтах
 
     // Массив подобластей памяти
     struct sub_mem_t m_sub_mems[SHM_POOL_SIZE];
 
+    atomic_t m_used;              // подобласти, не лежащие в списках свободных (выданные и ждущие очистки)
+    unsigned long m_idle_since;   // момент (jiffies), когда пул стал полностью свободным
+    struct list_head m_reclaim_node; // узел в списке пулов на освобождение
+    struct rcu_head m_rcu;           // отложенное освобождение после читателей таблицы подобластей
+
     struct list_head list; // список областей памяти
 };
 
-// Список соединений и его блокировка
+// Пул без занятых подобластей освобождается после этой паузы (параметр модуля shm_idle_grace_sec)
+#define SHM_IDLE_GRACE_SEC 30
+
+// Список областей: изменяется под g_shm_lock, читается под RCU
 extern struct list_head g_shm_list;
 extern struct mutex g_shm_lock;
 
+// Таблица подобластей по id
+extern struct xarray g_submems_xa;
+
 /**
  * Операции над областью общих памятей
  */
 
-// создание области общей памяти
-struct shm_t *shm_create(void);
+// создание области общей памяти класса pool_class (порядок подобластей или SHM_HUGE_CLASS) на узле NUMA node
+struct shm_t *shm_create(int node, int pool_class);
 
 // удаление области общей памяти
 void shm_destroy(struct shm_t *shm);
 
-// получить свободную область
-struct sub_mem_t *shm_get_free_submem(struct shm_t *shm);
 
 /**
  * Операции над подобластью
@@ -69,14 +117,67 @@ void submem_clear(struct sub_mem_t *);
 // отсоединить область
 int submem_disconnect(struct sub_mem_t *sub, struct connection_t *con);
 
+// вернуть подобласть в пул свободных (она будет очищена фоновой работой)
+void submem_release(struct sub_mem_t *sub);
+
+// поиск подобласти по id (вызывается под rcu_read_lock: простаивающие пулы освобождаются)
+struct sub_mem_t *find_submem_by_id(int id);
+
+/**
+ * @brief Замена подобласти *slot на new при росте области соединения: new получает id и соединение
+ * старой подобласти, старая - id new и уходит на очистку. Так id, известный процессам, не меняется.
+ */
+void submem_replace(struct sub_mem_t **slot, struct sub_mem_t *new);
+
+/**
+ * @brief Обмен подобластями между соединениями *slot_a и *slot_b: подобласти обмениваются id и соединениями,
+ * поэтому id, известные процессам, остаются за соединениями
+ */
+void submem_swap(struct sub_mem_t **slot_a, struct sub_mem_t **slot_b);
+
+// номер страничного кадра по смещению off в подобласти
+unsigned long submem_pfn(struct sub_mem_t *sub, unsigned long off);
+
+// запись размера подобласти в ее управляющий блок
+void submem_publish_size(struct sub_mem_t *sub);
+
+// отметка в управляющем блоке: запросы распределяет драйвер (группа с маршрутизацией)
+void submem_publish_routed(struct sub_mem_t *sub);
+
 /**
  * Операции над глобальным списком
  */
 
-// удаление списка
+/**
+ * @brief Инициализация распределителя подобластей: списки свободных подобластей
+ * и заранее выделенный теплый запас пулов (параметр модуля shm_warm_subs)
+ * @return int 0 - успех, <0 - ошибка
+ */
+int shm_allocator_init(void);
+
+// удаление списка (останавливает фоновое пополнение запаса)
 void delete_shm_list(void);
 
-// получение свободной подобласти памяти
-struct sub_mem_t *get_free_submem(void);
+// порядок подобласти, вмещающей size байт
+int shm_size_to_order(size_t size);
+
+// статистика пулов для монитора
+void shm_get_data(struct st_shm *dest);
+
+// узел NUMA с памятью, пригодный для пулов
+bool shm_node_valid(int node);
+
+/**
+ * @brief Получение свободной обнуленной подобласти памяти размером не меньше size байт на узле NUMA node.
+ * Подобласть берется из списка процессора, общего списка узла или у соседних процессоров узла,
+ * новый пул создается на месте, только если запас узла исчерпан.
+ */
+struct sub_mem_t *get_free_submem(int node, size_t size);
+
+/**
+ * @brief Получение свободной обнуленной подобласти на огромной странице (SHM_HUGE_REGION_SIZE байт) на узле node.
+ * @return NULL, если огромных страниц нет (например, из-за фрагментации памяти)
+ */
+struct sub_mem_t *get_free_huge_submem(int node);
 
 #endif // !SHM_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "task.h"
 #include "client.h"
+#include "conn_file.h"
 #include "err.h"
 #include "id_pack.h"
 #include "ripc.h"
@@ -7,54 +8,65 @@
 
 #include <linux/mm.h>
 #include <linux/pid.h> // pid_alive
+#include <linux/rculist.h>
+#include <linux/vmalloc.h>
 
 // Список соединений и его блокировка
 LIST_HEAD(g_reg_task_list);
 DEFINE_MUTEX(g_reg_task_lock);
 atomic_t g_reg_task_count = ATOMIC_INIT(0);
 
-struct notification_t *notification_create(enum notif_sender who_sends, enum notif_type type, int sub_mem_id,
-                                           int sender_id, int reciver_id)
+struct notification_t *notification_create(struct connection_t *con, const struct notification_data *data)
 {
+    if (!con || !data)
+    {
+        ERR("Empty param");
+        return NULL;
+    }
+
     // проверка типа отправителя
-    if (!IS_NTF_SEND_VALID(who_sends))
+    if (!IS_NTF_SEND_VALID(data->m_who_sends))
     {
-        ERR("unknown sender type %d", who_sends);
+        ERR("unknown sender type %d", data->m_who_sends);
         return NULL;
     }
 
     // проверка типа уведомления
-    if (!IS_NTF_TYPE_VALID(type))
+    if (!IS_NTF_TYPE_VALID(data->m_type))
     {
-        ERR("unknown type %d", type);
+        ERR("unknown type %d", data->m_type);
         return NULL;
     }
 
     // проверка всех идентификаторов
-    if (!IS_ID_VALID(sender_id) || !IS_ID_VALID(sub_mem_id) || !IS_ID_VALID(reciver_id))
+    if (!IS_ID_VALID(data->m_sender_id) || !IS_ID_VALID(data->m_sub_mem_id) || !IS_ID_VALID(data->m_reciver_id))
     {
-        ERR("some id is not valid (SUB_MEM_ID:%d)(SENDER_ID:%d)(RECIVER_ID:%d)", sub_mem_id, sender_id, reciver_id);
+        ERR("some id is not valid (SUB_MEM_ID:%d)(SENDER_ID:%d)(RECIVER_ID:%d)", data->m_sub_mem_id,
+            data->m_sender_id, data->m_reciver_id);
         return NULL;
     }
 
-    // создание объекта уведомления
-    struct notification_t *notif = kmalloc(sizeof(*notif), GFP_KERNEL);
-    if (!notif)
+    // слот занят - такое же уведомление этого соединения еще не прочитано, второе ничего не добавит
+    int slot = CONN_NOTIF_SLOT(data->m_who_sends, data->m_type);
+    if (test_and_set_bit_lock(slot, &con->m_notif_busy))
     {
-        ERR("Cant allocate memory for notification");
+        INF("Notif coalesced: (TYPE:%d)(WHO_SENDS:%d)(SUB_MEM_ID:%d)", data->m_type, data->m_who_sends,
+            data->m_sub_mem_id);
         return NULL;
     }
 
+    // слот живет вместе с соединением, пока уведомление в очереди
+    kref_get(&con->m_ref);
+
     // инициализация полей
-    notif->data.m_reciver_id = reciver_id;
-    notif->data.m_sender_id = sender_id;
-    notif->data.m_sub_mem_id = sub_mem_id;
-    notif->data.m_who_sends = who_sends;
-    notif->data.m_type = type;
+    struct notification_t *notif = &con->m_notif_slots[slot];
+    notif->data = *data;
+    notif->m_conn = con;
+    notif->m_slot = slot;
     INIT_LIST_HEAD(&notif->list);
 
-    INF("Created notif: (TYPE:%d)(WHO_SENDS:%d)(SUB_MEM_ID:%d)(SENDER_ID:%d)(RECIVER_ID:%d)", type, who_sends,
-        sub_mem_id, sender_id, reciver_id);
+    INF("Created notif: (TYPE:%d)(WHO_SENDS:%d)(SUB_MEM_ID:%d)(SENDER_ID:%d)(RECIVER_ID:%d)", data->m_type,
+        data->m_who_sends, data->m_sub_mem_id, data->m_sender_id, data->m_reciver_id);
 
     return notif;
 }
@@ -71,10 +83,15 @@ void notification_delete(struct notification_t *notif)
     INF("Deleting notif: (TYPE:%d)(WHO_SENDS:%d)(SUB_MEM_ID:%d)(SENDER_ID:%d)(RECIVER_ID:%d)", notif->data.m_type,
         notif->data.m_who_sends, notif->data.m_sub_mem_id, notif->data.m_sender_id, notif->data.m_reciver_id);
 
-    kfree(notif);
+    // слот снова свободен, соединение может освободиться
+    struct connection_t *con = notif->m_conn;
+    clear_bit_unlock(notif->m_slot, &con->m_notif_busy);
+    connection_put(con);
 }
 
-int notification_send(enum notif_sender sender, enum notif_type type, struct connection_t *con)
+// доставка уведомления; srv - серверная сторона: получатель запроса клиента или отправитель ответа
+static int notification_deliver(enum notif_sender sender, enum notif_type type, struct connection_t *con,
+                                struct server_t *srv)
 {
     if (!IS_NTF_SEND_VALID(sender))
     {
@@ -92,13 +109,15 @@ int notification_send(enum notif_sender sender, enum notif_type type, struct con
         ERR("NULL connection");
         return -ENOPARAM;
     }
-    if (!con->m_mem_p)
+    // подобласть отвязывается при закрытии соединения, читаем указатель один раз
+    struct sub_mem_t *mem = READ_ONCE(con->m_mem_p);
+    if (!mem)
     {
         ERR("NULL con->mem");
         return -ENOPARAM;
     }
 
-    int sub_mem_id = con->m_mem_p->m_id;
+    int sub_mem_id = mem->m_id;
     int sender_id, reciever_id;
     struct reg_task_t *reciever_task;
 
@@ -112,17 +131,17 @@ int notification_send(enum notif_sender sender, enum notif_type type, struct con
             return -ENOENT;
         }
         sender_id = (!con->m_client_p ? -1 : con->m_client_p->m_id);
-        reciever_id = (!con->m_server_p ? -1 : con->m_server_p->m_id);
-        reciever_task = (!con->m_server_p ? NULL : con->m_server_p->m_task_p->m_reg_task);
+        reciever_id = (!srv ? -1 : srv->m_id);
+        reciever_task = (!srv || !srv->m_task_p ? NULL : srv->m_task_p->m_reg_task);
         break;
 
     case SERVER:
-        if (!con->m_server_p)
+        if (!srv)
         {
             ERR("No client ptr in connection");
             return -ENOENT;
         }
-        sender_id = (!con->m_server_p ? -1 : con->m_server_p->m_id);
+        sender_id = (!srv ? -1 : srv->m_id);
         reciever_id = (!con->m_client_p ? -1 : con->m_client_p->m_id);
         reciever_task = (!con->m_client_p ? NULL : con->m_client_p->m_task_p->m_reg_task);
         break;
@@ -130,23 +149,47 @@ int notification_send(enum notif_sender sender, enum notif_type type, struct con
         ERR("Undefined sender type %d", sender);
     }
 
-    // создание уведомления
-    struct notification_t *ntf = notification_create(sender, type, sub_mem_id, sender_id, reciever_id);
-    if (!ntf)
+    // данные уведомления
+    struct notification_data data = {
+        .m_who_sends = sender,
+        .m_type = type,
+        .m_sub_mem_id = sub_mem_id,
+        .m_sender_id = sender_id,
+        .m_reciver_id = reciever_id,
+    };
+
+    if (!reciever_task || !IS_NTF_DATA_VALID(data))
     {
-        ERR("Notif hasnt created");
+        ERR("Invalid notification: (RECIVER TASK:%p)(SUB_MEM_ID:%d)(SENDER_ID:%d)(RECIVER_ID:%d)", reciever_task,
+            sub_mem_id, sender_id, reciever_id);
         return -EFAULT;
     }
 
-    // добавляем к процессу уведомление
-    if (!reg_task_add_notification(reciever_task, ntf))
+    // запрос серверу, который ждет в IOCTL_SERVER_REPLY_RECV, уходит прямо в его очередь
+    if (sender == CLIENT && type == NEW_MESSAGE && server_recv_push(srv, &data))
+    {
+        INF("Request passed directly to server (ID:%d)", reciever_id);
+        return 0;
+    }
+
+    // у получателя есть дескриптор соединения: уведомление ждет в нем, а не в очереди процесса
+    // (запрос, переданный другому участнику группы, уходит этому участнику обычным путем)
+    if ((sender == SERVER || srv == con->m_server_p) &&
+        conn_file_push(con, sender == CLIENT ? SERVER : CLIENT, &data))
+    {
+        INF("Notification passed to connection file (RECIVER ID:%d)", reciever_id);
+        return 0;
+    }
+
+    // доставляем уведомление процессу
+    if (!reg_task_send_notification(reciever_task, con, &data))
     {
         switch (sender)
         {
         // отправил клиент, то есть полцчатель будет сервер
         case CLIENT:
             INF("Notification sent to server (ID:%d)(PID:%d)(NAME:%s)", reciever_id, reciever_task->m_task_p->pid,
-                con->m_server_p->m_name);
+                srv->m_name);
             break;
             // отправил сервер, то есть полцчатель будет клиент
         case SERVER:
@@ -160,13 +203,29 @@ int notification_send(enum notif_sender sender, enum notif_type type, struct con
     else
     {
         ERR("notification hasnt been added");
-        notification_delete(ntf);
         return -EFAULT;
     }
 
     return 0;
 }
 
+int notification_send(enum notif_sender sender, enum notif_type type, struct connection_t *con)
+{
+    // запрос в группе с маршрутизацией может получить не сервер соединения, а другой участник
+    struct server_t *routed = NULL;
+    if (sender == CLIENT && type == NEW_MESSAGE && con)
+        routed = connection_route_request(con);
+
+    int ret = notification_deliver(sender, type, con, routed ? routed : (con ? con->m_server_p : NULL));
+    server_put(routed);
+    return ret;
+}
+
+int notification_send_to_server(struct server_t *srv, enum notif_type type, struct connection_t *con)
+{
+    return notification_deliver(CLIENT, type, con, srv);
+}
+
 struct servers_list_t *servers_list_t_create(struct reg_task_t *reg_task, struct server_t *serv)
 {
     if (!reg_task || !serv)
@@ -290,6 +349,17 @@ struct reg_task_t *reg_task_create(void)
         return NULL;
     }
 
+    // кольцо уведомлений: vmalloc_user возвращает обнуленную память, пригодную для remap_vmalloc_range
+    reg_task->m_ring = vmalloc_user(NOTIF_RING_MMAP_SIZE);
+    if (!reg_task->m_ring)
+    {
+        ERR("Cant allocate notification ring");
+        kfree(reg_task);
+        put_task_struct(task);
+        return NULL;
+    }
+    reg_task->m_ring_head = 0;
+
     // инициализация полей
     atomic_set(&reg_task->m_is_monitor, 0);
     INIT_LIST_HEAD(&reg_task->list);
@@ -306,7 +376,7 @@ struct reg_task_t *reg_task_create(void)
 
     // добавление в глобальный список
     mutex_lock(&g_reg_task_lock);
-    list_add(&reg_task->list, &g_reg_task_list);
+    list_add_rcu(&reg_task->list, &g_reg_task_list);
     atomic_inc(&g_reg_task_count);
     mutex_unlock(&g_reg_task_lock);
 
@@ -385,13 +455,17 @@ void reg_task_delete(struct reg_task_t *reg_task)
     if (reg_task->m_task_p)
     {
         put_task_struct(reg_task->m_task_p);
-        reg_task->m_task_p = NULL;
+        WRITE_ONCE(reg_task->m_task_p, NULL);
     }
     mutex_lock(&g_reg_task_lock);
-    list_del(&reg_task->list);
+    list_del_rcu(&reg_task->list);
     atomic_dec(&g_reg_task_count);
     mutex_unlock(&g_reg_task_lock);
-    kfree(reg_task);
+
+    // отображения кольца держат ссылку на файл, поэтому к моменту release их уже нет;
+    // читатели списка кольцо не трогают, а саму структуру освобождаем после них
+    vfree(reg_task->m_ring);
+    kfree_rcu(reg_task, m_rcu);
 
     INF("Finished cleaning reg_task");
 }
@@ -406,16 +480,16 @@ struct reg_task_t *reg_task_find_by_task_struct(struct task_struct *task)
 
     struct reg_task_t *entr = NULL;
 
-    mutex_lock(&g_reg_task_lock);
-    list_for_each_entry(entr, &g_reg_task_list, list)
+    rcu_read_lock();
+    list_for_each_entry_rcu(entr, &g_reg_task_list, list)
     {
-        if (entr->m_task_p == task)
+        if (READ_ONCE(entr->m_task_p) == task)
         {
-            mutex_unlock(&g_reg_task_lock);
+            rcu_read_unlock();
             return entr;
         }
     }
-    mutex_unlock(&g_reg_task_lock);
+    rcu_read_unlock();
 
     return NULL;
 }
@@ -527,12 +601,124 @@ int reg_task_add_notification(struct reg_task_t *reg_task, struct notification_t
     mutex_lock(&reg_task->m_notif_list_lock);
     list_add_tail(&notif->list, &reg_task->m_notif_list);
     atomic_inc(&reg_task->m_num_of_notif);
+    WRITE_ONCE(reg_task->m_ring->m_overflow, atomic_read(&reg_task->m_num_of_notif));
+    mutex_unlock(&reg_task->m_notif_list_lock);
+
+    reg_task_notify_all(reg_task);
+    return 0;
+}
+
+/**
+ * @brief Запись уведомления в кольцо. Вызывается под m_notif_list_lock.
+ * @return int 1 - записано, 0 - кольцо заполнено
+ */
+static int reg_task_ring_push(struct reg_task_t *reg_task, const struct notification_data *data)
+{
+    struct notification_ring *ring = reg_task->m_ring;
+    unsigned int head = reg_task->m_ring_head;
+
+    // позицию чтения пишет процесс: испорченное значение лишь заставит считать кольцо заполненным
+    unsigned int tail = smp_load_acquire(&ring->m_tail);
+    if (head - tail >= NOTIF_RING_SIZE)
+        return 0;
+
+    ring->m_entries[head & NOTIF_RING_MASK] = *data;
+    reg_task->m_ring_head = ++head;
+
+    // запись должна стать видимой раньше новой позиции
+    smp_store_release(&ring->m_head, head);
+    return 1;
+}
+
+int reg_task_send_notification(struct reg_task_t *reg_task, struct connection_t *con,
+                               const struct notification_data *data)
+{
+    if (!reg_task || !con || !data)
+    {
+        ERR("Reg_task, con or data is NULL");
+        return -ENODATA;
+    }
+    if (!IS_NTF_DATA_VALID((*data)))
+    {
+        ERR("Invalid notification data");
+        return -EINVAL;
+    }
+
+    mutex_lock(&reg_task->m_notif_list_lock);
+
+    // пока список переполнения не пуст, пишем в него, чтобы не нарушить порядок
+    if (list_empty(&reg_task->m_notif_list) && reg_task_ring_push(reg_task, data))
+    {
+        mutex_unlock(&reg_task->m_notif_list_lock);
+        INF("Notification put into ring of task (PID:%d)", reg_task->m_task_p->pid);
+
+        reg_task_notify_all(reg_task);
+        return 0;
+    }
+    mutex_unlock(&reg_task->m_notif_list_lock);
+
+    INF("Notification ring of task (PID:%d) is full", reg_task->m_task_p->pid);
+
+    // уведомление занимает заранее выделенный слот соединения
+    struct notification_t *notif = notification_create(con, data);
+    if (!notif)
+    {
+        // такое же уведомление уже ждет в списке, процесс его прочитает
+        return 0;
+    }
+
+    return reg_task_add_notification(reg_task, notif);
+}
+
+int reg_task_send_ring_notification(struct reg_task_t *reg_task, const struct notification_data *data)
+{
+    if (!reg_task || !data)
+    {
+        ERR("Reg_task or data is NULL");
+        return -ENODATA;
+    }
+    if (!IS_NTF_DATA_VALID((*data)))
+    {
+        ERR("Invalid notification data");
+        return -EINVAL;
+    }
+
+    // у уведомления нет слота в соединении: список переполнения ему недоступен,
+    // а порядок с уведомлениями соединений не важен
+    mutex_lock(&reg_task->m_notif_list_lock);
+    int pushed = reg_task_ring_push(reg_task, data);
     mutex_unlock(&reg_task->m_notif_list_lock);
 
+    if (!pushed)
+    {
+        INF("Notification ring of task (PID:%d) is full", reg_task->m_task_p->pid);
+        return -ENOSPC;
+    }
+
     reg_task_notify_all(reg_task);
     return 0;
 }
 
+int reg_task_mmap_ring(struct reg_task_t *reg_task, struct vm_area_struct *vma)
+{
+    if (!reg_task || !vma)
+    {
+        ERR("There is no reg_task or vma");
+        return -EINVAL;
+    }
+
+    unsigned long size = vma->vm_end - vma->vm_start;
+    if (size > NOTIF_RING_MMAP_SIZE)
+    {
+        ERR("Requested mapping (%lu bytes) is bigger than notification ring (%lu bytes)", size,
+            (unsigned long)NOTIF_RING_MMAP_SIZE);
+        return -EINVAL;
+    }
+
+    INF("Mapping notification ring of task (PID:%d)", reg_task->m_task_p->pid);
+    return remap_vmalloc_range(vma, reg_task->m_ring, 0);
+}
+
 void reg_task_delete_client(struct clients_list_t *cli_entry)
 {
     if (!cli_entry)
@@ -587,16 +773,16 @@ int reg_task_set_monitor(struct reg_task_t *reg_task)
 
     // Поиск монитора в глобальном списке зарегистрированных процессов
     struct reg_task_t *entr = NULL;
-    mutex_lock(&g_reg_task_lock);
-    list_for_each_entry(entr, &g_reg_task_list, list)
+    rcu_read_lock();
+    list_for_each_entry_rcu(entr, &g_reg_task_list, list)
     {
         if (reg_task_is_monitor(entr))
         {
-            mutex_unlock(&g_reg_task_lock);
+            rcu_read_unlock();
             return -EEXIST;
         }
     }
-    mutex_unlock(&g_reg_task_lock);
+    rcu_read_unlock();
 
     // если же монитор найден не был, значит регистрируем его
     atomic_inc(&reg_task->m_is_monitor);
@@ -616,30 +802,25 @@ int reg_task_is_monitor(struct reg_task_t *reg_task)
 
 struct notification_t *reg_task_get_notification(struct reg_task_t *reg_task)
 {
-    int ret = reg_task_is_notif_pending(reg_task);
-    // если произошла ошибка
-    if (ret == -1)
+    if (!reg_task)
     {
         ERR("CANT pop notification");
         return NULL;
     }
-    // если просто нет уведомлений
-    if (ret == 0)
+
+    mutex_lock(&reg_task->m_notif_list_lock);
+    // через read отдается только список переполнения, кольцо процесс читает сам
+    if (list_empty(&reg_task->m_notif_list))
     {
+        mutex_unlock(&reg_task->m_notif_list_lock);
         INF("There is not notification");
         return NULL;
     }
 
-    mutex_lock(&reg_task->m_notif_list_lock);
     // получение уведомления
     struct notification_t *notif = list_first_entry(&reg_task->m_notif_list, struct notification_t, list);
-    if (notif == NULL)
-    {
-        mutex_unlock(&reg_task->m_notif_list_lock);
-        ERR("Couldnt get notification");
-        return NULL;
-    }
     atomic_dec(&reg_task->m_num_of_notif);
+    WRITE_ONCE(reg_task->m_ring->m_overflow, atomic_read(&reg_task->m_num_of_notif));
 
     // удаление уведомления из списка в зарегистированной структуре
     list_del(&notif->list);
@@ -648,6 +829,44 @@ struct notification_t *reg_task_get_notification(struct reg_task_t *reg_task)
     return notif;
 }
 
+int reg_task_get_notifications(struct reg_task_t *reg_task, struct list_head *out, int max)
+{
+    if (!reg_task || !out)
+    {
+        ERR("NULL param");
+        return 0;
+    }
+
+    int count = 0;
+    struct notification_t *notif, *notif_tmp;
+
+    mutex_lock(&reg_task->m_notif_list_lock);
+    list_for_each_entry_safe(notif, notif_tmp, &reg_task->m_notif_list, list)
+    {
+        if (count >= max)
+            break;
+
+        list_move_tail(&notif->list, out);
+        atomic_dec(&reg_task->m_num_of_notif);
+        count++;
+    }
+    WRITE_ONCE(reg_task->m_ring->m_overflow, atomic_read(&reg_task->m_num_of_notif));
+    mutex_unlock(&reg_task->m_notif_list_lock);
+
+    return count;
+}
+
+int reg_task_is_ring_pending(struct reg_task_t *reg_task)
+{
+    if (!reg_task)
+    {
+        ERR("NULL param");
+        return -1;
+    }
+
+    return READ_ONCE(reg_task->m_ring->m_tail) != READ_ONCE(reg_task->m_ring_head);
+}
+
 int reg_task_is_notif_pending(struct reg_task_t *reg_task)
 {
     if (!reg_task)
@@ -661,7 +880,7 @@ int reg_task_is_notif_pending(struct reg_task_t *reg_task)
     mutex_lock(&reg_task->m_notif_list_lock);
     int res = !list_empty(&reg_task->m_notif_list);
     mutex_unlock(&reg_task->m_notif_list_lock);
-    return res;
+    return res || reg_task_is_ring_pending(reg_task);
 }
 
 void reg_task_notify_all(struct reg_task_t *reg_task)
@@ -687,6 +906,9 @@ void reg_task_get_data(struct st_reg_tasks *reg_tasks)
 
     reg_tasks->tasks_count = 0;
 
+    // состояние пулов общей памяти
+    shm_get_data(&reg_tasks->shm);
+
     // нужно пройти по всему списку задач и скопировать информацию о них в структуру
     struct reg_task_t *entr = NULL;
     mutex_lock(&g_reg_task_lock);
@@ -14,34 +14,30 @@
 /**
  * Глобальные переменные
  */
-// Список зарегистрированных процессов и его блокировка
+// Список зарегистрированных процессов: изменяется под g_reg_task_lock, читается под RCU
 extern struct list_head g_reg_task_list;
 extern atomic_t g_reg_task_count;
 extern struct mutex g_reg_task_lock;
 
 /**
- * Структура отправленного уведомления
+ * Функции для работы со структурой уведомления
  */
-struct notification_t
-{
-    struct notification_data data;
-    struct list_head list;
-};
 
 /**
- * Функции для работы со структурой уведомления
+ * @brief Захват слота уведомления в соединении (берет ссылку на соединение)
+ * @return struct notification_t* слот или NULL, если такое уведомление соединения уже ждет в очереди
  */
+struct notification_t *notification_create(struct connection_t *con, const struct notification_data *data);
 
-// Создание уведомления
-struct notification_t *notification_create(enum notif_sender sender, enum notif_type type, int sub_mem_id,
-                                           int sender_id, int reciver_id);
-
-// Удаление уведомления
+// Освобождение слота уведомления и ссылки на соединение
 void notification_delete(struct notification_t *notif);
 
 // отправление уведомления
 int notification_send(enum notif_sender sender, enum notif_type type, struct connection_t *con);
 
+// отправление уведомления от клиента соединения указанному серверу (участнику группы с маршрутизацией)
+int notification_send_to_server(struct server_t *srv, enum notif_type type, struct connection_t *con);
+
 /**
  * структура для добавления сервера в список
  */
@@ -91,12 +87,15 @@ struct reg_task_t
     struct list_head m_notif_list;  // список уведомлений
     struct mutex m_notif_list_lock; // блокировка доступа к списку уведомлений
     atomic_t m_num_of_notif;        // количество уведомлений в списке
+    struct notification_ring *m_ring; // кольцо уведомлений, отображаемое в процесс
+    unsigned int m_ring_head;         // копия позиции записи (памяти процесса не доверяем)
     struct list_head m_servers;     // список серверов
     atomic_t m_num_of_servers;      // количество серверов в процессе
     struct list_head m_clients;     // список клиентов
     atomic_t m_num_of_clients;      // Количество кдиентов в процессе
     wait_queue_head_t m_wait_queue; // для блокировки процесса при poll ожидании
     struct mutex m_wait_queue_lock; // блокировка доступа к очереди ожидания
+    struct rcu_head m_rcu;          // отложенное освобождение после читателей списка
     struct list_head list;
 };
 
@@ -117,7 +116,7 @@ struct reg_task_t *reg_task_create(void);
 // Удаление зарегистрированного процесса
 void reg_task_delete(struct reg_task_t *reg_task);
 
-// поиск по task_struct
+// поиск по task_struct (без ссылки: результат годится только для проверки регистрации)
 struct reg_task_t *reg_task_find_by_task_struct(struct task_struct *task);
 
 // проверка возможности добавления сервера
@@ -155,13 +154,42 @@ int reg_task_is_monitor(struct reg_task_t *reg_task);
 // получение размера очереди уведомлений
 int reg_task_get_notif_count(struct reg_task_t *reg_task);
 
-// добавление уведомления
+// добавление уведомления в список переполнения
 int reg_task_add_notification(struct reg_task_t *reg_task, struct notification_t *notif);
 
+/**
+ * @brief Доставка уведомления процессу.
+ * Уведомление кладется в кольцо, а если оно заполнено (или в списке переполнения
+ * уже есть уведомления) - в слот соединения con, который забирается через read.
+ * @return int 0 - доставлено, <0 - ошибка
+ */
+int reg_task_send_notification(struct reg_task_t *reg_task, struct connection_t *con,
+                               const struct notification_data *data);
+
+/**
+ * @brief Доставка уведомления без соединения (канал публикации) только через кольцо
+ * @return int 0 - доставлено, -ENOSPC - кольцо заполнено, <0 - ошибка
+ */
+int reg_task_send_ring_notification(struct reg_task_t *reg_task, const struct notification_data *data);
+
+// отображение кольца уведомлений в процесс
+int reg_task_mmap_ring(struct reg_task_t *reg_task, struct vm_area_struct *vma);
+
 // получение уведомления
 struct notification_t *reg_task_get_notification(struct reg_task_t *reg_task);
 
-// есть ли сообщения в очереди
+/**
+ * @brief Извлечение нескольких уведомлений за одну блокировку списка
+ * @param out список, в конец которого переносятся уведомления
+ * @param max максимальное количество уведомлений
+ * @return int количество перенесенных уведомлений
+ */
+int reg_task_get_notifications(struct reg_task_t *reg_task, struct list_head *out, int max);
+
+// есть ли непрочитанные процессом уведомления в кольце
+int reg_task_is_ring_pending(struct reg_task_t *reg_task);
+
+// есть ли сообщения в очереди (в кольце или в списке переполнения)
 int reg_task_is_notif_pending(struct reg_task_t *reg_task);
 
 // пробуждение очереди ожидания
@@ -151,7 +151,7 @@ void handle_new_message(const struct notification_data *ntf)
         }
 
         // Читаем сообщение
-        if (!server_read(srv, submem, 0, SHM_REGION_PAGE_SIZE))
+        if (!server_read(srv, submem, 0, EXAMPLE_REQUEST_SIZE))
         {
             printf("Error: cant read from server (ID:%d) using submem(ID:%d)\n", receiver_id, sub_mem_id);
             return;
@@ -193,7 +193,7 @@ void handle_new_message(const struct notification_data *ntf)
         }
 
         // Читаем сообщение
-        if (!client_read(cli, 0, SHM_REGION_PAGE_SIZE))
+        if (!client_read(cli, 0, EXAMPLE_RESPONSE_SIZE))
         {
             printf("Error: cant read msg for client (ID:%d) from server (ID: %d)\n", receiver_id, sender_id);
             return;
@@ -841,7 +841,7 @@ bool server_mmap(struct ServerInstance *server, int shm_id)
            server->server_id, shm_id, (unsigned long)offset_for_mmap, packed_id, g_page_size);
 
     // Выполняем mmap
-    void *mapped_addr = mmap(NULL, SHM_REGION_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_dev_fd, offset_for_mmap);
+    void *mapped_addr = mmap(NULL, EXAMPLE_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_dev_fd, offset_for_mmap);
 
     if (mapped_addr == MAP_FAILED)
     {
@@ -853,7 +853,7 @@ bool server_mmap(struct ServerInstance *server, int shm_id)
     {
         // Успех: обновляем структуру ServerShmMapping
         mapping->addr = mapped_addr;
-        mapping->size = SHM_REGION_PAGE_SIZE;
+        mapping->size = EXAMPLE_SHM_SIZE;
         mapping->mapped = true;
         printf("Server %d: Memory for shm_id %d mapped successfully at: %p\n", server->server_id, shm_id, mapping->addr);
         return true;
@@ -908,23 +908,27 @@ bool server_write(struct ServerInstance *server, int client_id, long offset, con
         }
     }
 
+    // ответ пишется во вторую половину отображения, смещение отсчитывается от ее начала
+    char *half = (char *)mapping->addr + SHM_RESPONSE_OFFSET(mapping->size);
+    size_t half_size = mapping->size - SHM_RESPONSE_OFFSET(mapping->size);
+
     // Проверка смещения и размера
-    if (offset < 0 || (size_t)offset >= mapping->size)
+    if (offset < 0 || (size_t)offset >= half_size)
     {
-        printf("Error: Invalid offset %ld for server write (max %zu)\n", offset, mapping->size - 1);
+        printf("Error: Invalid offset %ld for server write (max %zu)\n", offset, half_size - 1);
         return false;
     }
     size_t text_len = strlen(text);
-    size_t available_space = mapping->size - (size_t)offset;
+    size_t available_space = half_size - (size_t)offset;
     size_t write_len = (text_len < available_space) ? text_len : available_space;
 
     // Копируем данные
-    memcpy((char *)mapping->addr + offset, text, write_len);
+    memcpy(half + offset, text, write_len);
 
     // Логируем запись
     if (write_len == text_len && write_len < available_space)
     {
-        ((char *)mapping->addr)[offset + write_len] = '\0';
+        half[offset + write_len] = '\0';
         printf("Server %d wrote %zu bytes (null term) to shm_id %d (for client %d) at offset %ld: \"%s\"\n",
                server->server_id, write_len + 1, target_shm_id, client_id, offset, text);
     }
@@ -986,18 +990,22 @@ bool server_read(struct ServerInstance *server, struct ServerShmMapping *submem,
         }
     }
 
+    // запрос лежит после управляющего блока, смещение отсчитывается от начала запроса
+    char *half = (char *)submem->addr + SHM_REQUEST_OFFSET;
+    size_t half_size = SHM_RESPONSE_OFFSET(submem->size) - SHM_REQUEST_OFFSET;
+
     // Проверка смещения и длины
-    if (offset < 0 || length <= 0 || (size_t)offset >= submem->size)
+    if (offset < 0 || length <= 0 || (size_t)offset >= half_size)
     {
-        printf("Error: Invalid offset (%ld) or length (%ld) for server read (max size %zu)\n", offset, length, submem->size);
+        printf("Error: Invalid offset (%ld) or length (%ld) for server read (max size %zu)\n", offset, length, half_size);
         return false;
     }
 
     // Корректировка длины чтения
     size_t read_length = (size_t)length;
-    if ((size_t)offset + read_length > submem->size)
+    if ((size_t)offset + read_length > half_size)
     {
-        read_length = submem->size - (size_t)offset;
+        read_length = half_size - (size_t)offset;
         printf("Warning: Server read length truncated from %ld to %zu bytes to fit buffer.\n", length, read_length);
     }
 
@@ -1010,7 +1018,7 @@ bool server_read(struct ServerInstance *server, struct ServerShmMapping *submem,
     }
 
     // Копируем данные и добавляем нуль-терминатор
-    memcpy(read_buf, (char *)submem->addr + offset, read_length);
+    memcpy(read_buf, half + offset, read_length);
     read_buf[read_length] = '\0';
 
     printf("Server %d read from shm_id %d at offset %ld (%zu bytes): \"%s\"\n",
@@ -1229,6 +1237,7 @@ bool client_connect(struct ClientInstance *client, const char *server_name)
 
     // Заполняем структуру для IOCTL (согласно ripc.h)
     struct connect_to_server con_ioctl_data;
+    memset(&con_ioctl_data, 0, sizeof(con_ioctl_data)); // размер области и флаги - по умолчанию
     con_ioctl_data.client_id = client->client_id; // ID клиента, который вызывает ioctl
     strncpy(con_ioctl_data.server_name, server_name, MAX_SERVER_NAME - 1);
     con_ioctl_data.server_name[MAX_SERVER_NAME - 1] = '\0';
@@ -1309,7 +1318,7 @@ bool client_mmap(struct ClientInstance *client)
            client->client_id, instance_index, (unsigned long)offset_for_mmap, packed_id, g_page_size);
 
     // Выполняем mmap
-    void *mapped_addr = mmap(NULL, SHM_REGION_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_dev_fd, offset_for_mmap);
+    void *mapped_addr = mmap(NULL, EXAMPLE_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_dev_fd, offset_for_mmap);
 
     if (mapped_addr == MAP_FAILED)
     {
@@ -1324,7 +1333,7 @@ bool client_mmap(struct ClientInstance *client)
     {
         // Успех: обновляем структуру клиента
         client->shm.addr = mapped_addr;
-        client->shm.size = SHM_REGION_PAGE_SIZE;
+        client->shm.size = EXAMPLE_SHM_SIZE;
         client->shm.mapped = true;
         printf("Client %d (instance %d): Memory mapped successfully at: %p\n", client->client_id, instance_index, client->shm.addr);
         return true;
@@ -1353,20 +1362,24 @@ bool client_write(struct ClientInstance *client, long offset, const char *text)
         printf("Warning: Client %d is not connected to any server. Write will not notify server.\n", client->client_id);
     }
 
+    // запрос пишется после управляющего блока, смещение отсчитывается от начала запроса
+    char *half = (char *)client->shm.addr + SHM_REQUEST_OFFSET;
+    size_t half_size = SHM_RESPONSE_OFFSET(client->shm.size) - SHM_REQUEST_OFFSET;
+
     // Проверка смещения
-    if (offset < 0 || (size_t)offset >= client->shm.size)
+    if (offset < 0 || (size_t)offset >= half_size)
     {
-        printf("Error: Invalid offset %ld for client write (max %zu)\n", offset, client->shm.size - 1);
+        printf("Error: Invalid offset %ld for client write (max %zu)\n", offset, half_size - 1);
         return false;
     }
 
     // Вычисляем размер для записи
     size_t text_len = strlen(text);
-    size_t available_space = client->shm.size - (size_t)offset;
+    size_t available_space = half_size - (size_t)offset;
     size_t write_len = (text_len < available_space) ? text_len : available_space;
 
     // Копируем данные
-    memcpy((char *)client->shm.addr + offset, text, write_len);
+    memcpy(half + offset, text, write_len);
 
     // Найдем индекс клиента в массиве для логгирования
     int instance_index = -1;
@@ -1380,7 +1393,7 @@ bool client_write(struct ClientInstance *client, long offset, const char *text)
     // Логируем запись
     if (write_len == text_len && write_len < available_space)
     {
-        ((char *)client->shm.addr)[offset + write_len] = '\0';
+        half[offset + write_len] = '\0';
         printf("Client %d (instance %d) wrote %zu bytes (null term) at offset %ld: \"%s\"\n",
                client->client_id, instance_index, write_len + 1, offset, text);
     }
@@ -1448,18 +1461,22 @@ bool client_read(struct ClientInstance *client, long offset, long length)
         }
     }
 
+    // ответ лежит во второй половине отображения, смещение отсчитывается от ее начала
+    char *half = (char *)client->shm.addr + SHM_RESPONSE_OFFSET(client->shm.size);
+    size_t half_size = client->shm.size - SHM_RESPONSE_OFFSET(client->shm.size);
+
     // Проверка смещения и длины
-    if (offset < 0 || length <= 0 || (size_t)offset >= client->shm.size)
+    if (offset < 0 || length <= 0 || (size_t)offset >= half_size)
     {
-        printf("Error: Invalid offset (%ld) or length (%ld) for client read (max size %zu)\n", offset, length, client->shm.size);
+        printf("Error: Invalid offset (%ld) or length (%ld) for client read (max size %zu)\n", offset, length, half_size);
         return false;
     }
 
     // Корректируем длину чтения, если она выходит за пределы
     size_t read_length = (size_t)length;
-    if ((size_t)offset + read_length > client->shm.size)
+    if ((size_t)offset + read_length > half_size)
     {
-        read_length = client->shm.size - (size_t)offset;
+        read_length = half_size - (size_t)offset;
         printf("Warning: Client read length truncated from %ld to %zu bytes to fit buffer.\n", length, read_length);
     }
 
@@ -1472,7 +1489,7 @@ bool client_read(struct ClientInstance *client, long offset, long length)
     }
 
     // Копируем данные и добавляем нуль-терминатор
-    memcpy(read_buf, (char *)client->shm.addr + offset, read_length);
+    memcpy(read_buf, half + offset, read_length);
     read_buf[read_length] = '\0';
 
     // Найдем индекс клиента в массиве для логгирования
@@ -1604,6 +1621,8 @@ void print_commands()
     printf(" - <idx> refers to the instance index in the local g_clients/g_servers array [0-%d].\n", MAX_INSTANCES - 1);
     printf(" - <client_id> / <server_id> are IDs assigned by the kernel.\n");
     printf(" - <shm_id> is the sub-memory ID assigned by the kernel (used by server).\n");
+    printf(" - Offsets are counted from the request half (client write, server read)\n");
+    printf("   or from the response half (server write, client read).\n");
     printf(" - Notifications (NEW_CONNECTION, NEW_MESSAGE) are handled in a separate thread.\n");
 }
 
@@ -18,6 +18,9 @@
 #define MAX_SERVER_SHM 16      // Максимальное количество общих памятей на сервер
 #define MAX_INPUT_LEN 256      // максимальная длина вводимой строки в консольном режиме
 #define MAX_HANDLED_SIGNALS 10 // Максимальное количество сигналов для обработки
+#define EXAMPLE_SHM_SIZE SHM_REGION_PAGE_SIZE // отображается вся подобласть: половина запросов и половина ответов
+#define EXAMPLE_REQUEST_SIZE (SHM_RESPONSE_OFFSET(EXAMPLE_SHM_SIZE) - SHM_REQUEST_OFFSET) // запрос после управляющего блока
+#define EXAMPLE_RESPONSE_SIZE (EXAMPLE_SHM_SIZE - SHM_RESPONSE_OFFSET(EXAMPLE_SHM_SIZE))  // ответ во второй половине
 
 // --- Тип Указателя на Функцию-Обработчик Сигналов ---
 typedef void (*notif_handler_func_t)(const struct notification_data *fdsi);
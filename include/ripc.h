@@ -18,12 +18,16 @@
  */
 
 #define MAX_SERVER_NAME 64                                            // Максимальная длина имени сервера
-#define SHM_REGION_ORDER 0                                            // Порядок для alloc_pages (2^0 = 1 страница)
-#define SHM_REGION_PAGE_NUMBER (1 << SHM_REGION_ORDER)                // Количество страниц в области (1)
+#define MAX_ROUTE_PREFIX 64                                           // Максимальная длина префикса URL участника группы
+#define SHM_REGION_ORDER 1                                            // Порядок минимальной области (2^1 = 2 страницы)
+#define SHM_REGION_PAGE_NUMBER (1 << SHM_REGION_ORDER)                // Количество страниц в области (2: запрос и ответ)
 #define SHM_REGION_PAGE_SIZE (SHM_REGION_PAGE_NUMBER * PAGE_SIZE)     // Размер памяти на область в байтах
 #define SHM_POOL_SIZE 4                                               // Количество областей в пуле
 #define SHM_POOL_PAGE_NUMBER (SHM_POOL_SIZE * SHM_REGION_PAGE_NUMBER) // Количество страниц памяти на пул
 #define SHM_POOL_BYTE_SIZE (SHM_REGION_PAGE_SIZE * SHM_POOL_SIZE)     // Размер пула памяти в байтах
+#define SHM_REGION_MAX_ORDER 8                                        // Максимальный порядок подобласти (2^8 = 256 страниц)
+#define SHM_REGION_MAX_SIZE ((1 << SHM_REGION_MAX_ORDER) * PAGE_SIZE) // Максимальный размер подобласти в байтах
+#define SHM_HUGE_REGION_SIZE (2UL * 1024 * 1024)                      // Размер подобласти на огромной странице
 
 /**
  * Константы для ограничений на процесс
@@ -55,6 +59,7 @@ enum notif_type
     NEW_CONNECTION,
     NEW_MESSAGE,
     REMOTE_DISCONNECT,
+    CHANNEL_MESSAGE, // в канале опубликовано новое сообщение (отправитель - канал, получатель - подписчик)
     TYPE_MAX
 };
 #define IS_NTF_TYPE_VALID(sender) (sender > TYPE_MIN && sender < TYPE_MAX)
@@ -73,6 +78,145 @@ struct notification_data
     (IS_NTF_TYPE_VALID(ntf.m_type) && IS_NTF_SEND_VALID(ntf.m_who_sends) && IS_ID_VALID(ntf.m_reciver_id) &&           \
      IS_ID_VALID(ntf.m_sub_mem_id) && IS_ID_VALID(ntf.m_sender_id))
 
+/**
+ * Кольцо уведомлений процесса (один производитель - драйвер, один потребитель - процесс).
+ * Отображается в процесс через mmap со смещением NOTIF_RING_MMAP_OFFSET.
+ */
+
+#define RIPC_CACHE_LINE 64                     // Размер кэш-линии
+#define NOTIF_RING_SIZE 256                    // Количество записей в кольце (степень двойки)
+#define NOTIF_RING_MASK (NOTIF_RING_SIZE - 1)  // Маска индекса записи
+#define NOTIF_RING_MMAP_ID MAX_ID_VALUE        // Зарезервированный id для отображения кольца
+#define NOTIF_RING_PACKED_ID ((u32)NOTIF_RING_MMAP_ID << 16) // Запакованный id кольца (NOTIF_RING_MMAP_ID, 0)
+#define NOTIF_RING_MMAP_OFFSET(page_size) ((unsigned long)NOTIF_RING_PACKED_ID * (page_size)) // смещение для mmap
+
+struct notification_ring
+{
+    // позиция записи, изменяется только драйвером
+    unsigned int m_head;
+    // количество уведомлений, не поместившихся в кольцо (забираются через read)
+    unsigned int m_overflow;
+    char m_pad_head[RIPC_CACHE_LINE - 2 * sizeof(unsigned int)];
+
+    // позиция чтения, изменяется только процессом
+    unsigned int m_tail;
+    char m_pad_tail[RIPC_CACHE_LINE - sizeof(unsigned int)];
+
+    struct notification_data m_entries[NOTIF_RING_SIZE];
+};
+
+// Размер отображения кольца, выровненный по странице
+#define NOTIF_RING_MMAP_SIZE (((sizeof(struct notification_ring) + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE)
+
+/**
+ * Описание сообщения в половине подобласти: длины секций известны без поиска разделителей.
+ * Сообщение лежит в данных половины: заголовки (через m_header_delimeter), сразу за ними - полезная нагрузка.
+ */
+struct shm_msg_desc
+{
+    unsigned int m_seq;         // номер запроса, к которому относится сообщение
+    unsigned int m_header_len;  // длина секции заголовков
+    unsigned int m_payload_len; // длина полезной нагрузки
+    unsigned int m_flags;       // SHM_MSG_*
+    int m_status;               // результат обработки, задается приложением (0 - успех)
+};
+#define SHM_MSG_HEADERS (1u << 0)  // секция заголовков закрыта
+#define SHM_MSG_COMPLETE (1u << 1) // сообщение дописано
+
+/**
+ * Управляющий блок подобласти ("дверной звонок").
+ * Лежит в начале каждой подобласти, данные сообщения начинаются после него.
+ * Счетчики - источник истины о запросах и ответах, уведомления драйвера лишь будят спящую сторону.
+ * Каждая сторона пишет только в свою кэш-линию, поэтому клиент и сервер не делят линии при записи;
+ * размер подобласти меняется редко и вынесен в отдельную линию, которую обе стороны только читают.
+ * Процесс отображает подобласть размером с ограничение сервера, страницы подставляются при обращении;
+ * после роста подобласти драйвер обновляет m_region_size, и обе стороны видят новый объем без переподключения.
+ */
+struct shm_doorbell
+{
+    // линия клиента
+    unsigned int m_req_seq;        // номер последнего запроса клиента
+    unsigned int m_client_polling; // клиент сам опрашивает m_resp_seq, уведомлять через драйвер не нужно
+    struct shm_msg_desc m_request; // описание запроса
+    char m_pad_client[RIPC_CACHE_LINE - 2 * sizeof(unsigned int) - sizeof(struct shm_msg_desc)];
+
+    // линия сервера
+    unsigned int m_resp_seq;        // номер запроса, на который ответил сервер
+    unsigned int m_server_polling;  // сервер сам опрашивает m_req_seq, уведомлять через драйвер не нужно
+    unsigned int m_req_ack;         // номер запроса, который сервер уже прочитал: страницу запроса можно переписывать
+    struct shm_msg_desc m_response; // описание ответа
+    char m_pad_server[RIPC_CACHE_LINE - 3 * sizeof(unsigned int) - sizeof(struct shm_msg_desc)];
+
+    // линия драйвера
+    unsigned int m_region_size; // текущий размер подобласти (пишет драйвер при подключении и росте)
+    unsigned int m_routed;      // запросы распределяет драйвер между участниками группы: опрос звонка не годится
+    char m_pad_driver[RIPC_CACHE_LINE - 2 * sizeof(unsigned int)];
+};
+#define SHM_DOORBELL_SIZE sizeof(struct shm_doorbell) // место под управляющий блок в начале подобласти
+
+/**
+ * Подобласть делится пополам: первая половина - запросы клиента (после управляющего блока), вторая - ответы сервера.
+ * Стороны пишут в разные страницы, и клиент может готовить следующий запрос, пока сервер отвечает.
+ * В отображении (размером с ограничение сервера map_size) половины лежат по смещениям 0 и map_size / 2
+ * и растут на месте вместе с подобластью.
+ */
+#define SHM_REQUEST_OFFSET SHM_DOORBELL_SIZE              // начало запроса в отображении
+#define SHM_RESPONSE_OFFSET(map_size) ((map_size) / 2)    // начало ответа в отображении
+
+/**
+ * Заголовок подобласти канала публикации (SERVER_FLAG_CHANNEL), сообщение лежит сразу за ним.
+ * Издатель отображает подобласть для записи, подписчики - только для чтения.
+ * Драйвер при публикации пишет длину и четный номер, издатель на время записи делает номер нечетным:
+ * подписчик, увидевший после копирования другой или нечетный номер, отбрасывает копию.
+ * В канале состояния (SERVER_FLAG_STATE) драйвер заголовок не трогает: номер и длину пишет издатель,
+ * а читатели повторяют копирование, пока не получат согласованный снимок (seqlock).
+ */
+struct shm_channel_header
+{
+    unsigned int m_seq;         // удвоенный номер последней публикации (нечетный - сообщение переписывается)
+    unsigned int m_len;         // длина опубликованного сообщения
+    unsigned int m_region_size; // размер подобласти канала
+    char m_pad[RIPC_CACHE_LINE - 3 * sizeof(unsigned int)];
+};
+#define SHM_CHANNEL_DATA_OFFSET sizeof(struct shm_channel_header) // начало сообщения в подобласти канала
+
+/**
+ * Очередь заданий (SERVER_FLAG_QUEUE): кольцо ячеек в подобласти канала. Издатель кладет задания,
+ * подписчики-исполнители забирают их без блокировок, сдвигая m_head через CAS.
+ * Ячейка для позиции pos свободна, когда ее номер равен кругу позиции (pos & ~(m_slot_count - 1)),
+ * и хранит задание, когда номер на 1 больше; исполнитель освобождает ячейку номером следующего круга.
+ * Поэтому обнуленная подобласть - уже пустая очередь.
+ * Исполнитель без заданий ждет в IOCTL_QUEUE_WAIT, издатель при m_waiters > 0 вызывает
+ * IOCTL_QUEUE_POST, и драйвер будит ровно одного ожидающего.
+ */
+struct shm_queue_header
+{
+    // пишет драйвер
+    unsigned int m_region_size; // размер подобласти
+    unsigned int m_slot_count;  // количество ячеек (степень двойки)
+    unsigned int m_slot_size;   // размер ячейки вместе с shm_queue_slot
+    unsigned int m_waiters;     // исполнители, ждущие задание в драйвере
+    char m_pad_driver[RIPC_CACHE_LINE - 4 * sizeof(unsigned int)];
+
+    // пишет издатель
+    unsigned int m_tail; // позиция следующего задания
+    char m_pad_tail[RIPC_CACHE_LINE - sizeof(unsigned int)];
+
+    // сдвигают исполнители
+    unsigned int m_head; // позиция первого невзятого задания
+    char m_pad_head[RIPC_CACHE_LINE - sizeof(unsigned int)];
+};
+
+// ячейка очереди, задание лежит сразу за ней
+struct shm_queue_slot
+{
+    unsigned int m_seq; // круг и состояние ячейки
+    unsigned int m_len; // длина задания
+};
+#define SHM_QUEUE_SLOT_SIZE 256                                       // размер ячейки очереди заданий
+#define SHM_QUEUE_SLOTS_OFFSET sizeof(struct shm_queue_header)        // начало ячеек в подобласти
+#define SHM_QUEUE_JOB_MAX (SHM_QUEUE_SLOT_SIZE - sizeof(struct shm_queue_slot)) // наибольшая длина задания
+
 /**
  * Структуры данных для утилиты мониторинга ripcctl
  */
@@ -86,7 +230,13 @@ struct st_server
 {
     int id;
     char name[MAX_SERVER_NAME];
+    int numa_node;                          // узел NUMA, на котором выделяется память соединений
+    int group_size;                         // участников в группе сервера (0 - сервер не в группе)
+    char route_prefix[MAX_ROUTE_PREFIX];    // префикс URL, по которому группа направляет запросы серверу
+    int subscribers;                        // подписчики канала или исполнители очереди (-1 - сервер не канал)
+    unsigned int flags;                     // SERVER_FLAG_* сервера
     int conn_ids[MAX_CLIENTS_PER_SERVER];
+    int conn_nodes[MAX_CLIENTS_PER_SERVER]; // узел NUMA подобласти соединения
     int conn_count;
 };
 
@@ -99,10 +249,20 @@ struct st_task
     int servers_count;
 };
 
+struct st_shm
+{
+    int pools_count;     // количество пулов общей памяти
+    int idle_pools;      // пулы без выданных подобластей (будут освобождены после паузы)
+    int subs_used;       // подобласти, выданные соединениям или ждущие очистки
+    int subs_free;       // свободные очищенные подобласти
+    unsigned long bytes; // память всех пулов в байтах
+};
+
 struct st_reg_tasks
 {
     struct st_task tasks[MAX_PROCESSES];
     int tasks_count;
+    struct st_shm shm;
 };
 
 /**
@@ -110,17 +270,111 @@ struct st_reg_tasks
  */
 
 // IOCTL REGISTER_SERVER
+#define SERVER_FLAG_HUGE_PAGES 1  // подобласти соединений на огромных страницах (SHM_HUGE_REGION_SIZE)
+#define SERVER_FLAG_GROUP 2       // войти в группу серверов с этим именем: подключения распределяются между участниками
+#define SERVER_FLAG_BALANCE_LEAST 4 // группа отдает подключение участнику с наименьшим числом соединений (иначе - по кругу)
+#define SERVER_FLAG_ROUTE 8       // группа направляет каждый запрос участнику с самым длинным подходящим route_prefix
+#define SERVER_FLAG_CHANNEL 16    // канал публикации: одна подобласть издателя, подписчики отображают ее для чтения
+#define SERVER_FLAG_STATE 32      // канал состояния: без уведомлений, читатели берут последний снимок из отображения
+#define SERVER_FLAG_QUEUE 64      // очередь заданий: каждое задание забирает один исполнитель из подписчиков
+#define SERVER_NUMA_NODE_AUTO (-1) // память соединений на узле NUMA регистрирующего потока
 struct server_registration
 {
     char name[MAX_SERVER_NAME];
     int server_id;
+    unsigned int max_region_size; // максимальный размер области на соединение (0 - SHM_REGION_MAX_SIZE)
+    unsigned int flags;           // SERVER_FLAG_*, в ответ - примененные драйвером
+    int numa_node;                // узел NUMA для памяти соединений (SERVER_NUMA_NODE_AUTO), в ответ - выбранный
+    char route_prefix[MAX_ROUTE_PREFIX]; // префикс URL запросов этого участника (SERVER_FLAG_ROUTE)
 };
 
 // IOCTL CONNECT_TO_SERVER
+#define CONNECT_FLAG_FD 1 // вернуть дескриптор соединения: уведомления клиента уходят в него, а не процессу
 struct connect_to_server
 {
     int client_id;
     char server_name[MAX_SERVER_NAME];
+    unsigned int region_size; // запрошенный размер области (0 - SHM_REGION_PAGE_SIZE), в ответ - выделенный
+    unsigned int flags;       // CONNECT_FLAG_*
+    int conn_fd;              // в ответ - дескриптор соединения (CONNECT_FLAG_FD) или -1
+};
+
+// IOCTL CLIENT_CALL
+struct client_call
+{
+    int client_id;
+    unsigned int timeout_ms; // время ожидания ответа (0 - без ограничения)
+};
+
+// IOCTL REGION_RESIZE
+struct region_resize
+{
+    unsigned int packed_id; // (client_id, 0) или (server_id, sub_mem_id)
+    unsigned int size;      // нужный размер области (0 - только узнать), в ответ - текущий
+    unsigned int max_size;  // в ответ - ограничение сервера, столько нужно отображать
+};
+
+// IOCTL SERVER_MIGRATE
+struct server_migrate
+{
+    int server_id;  // сервер, отдающий соединение
+    int sub_mem_id; // подобласть соединения
+    int target_id;  // участник той же группы, который получит соединение
+};
+
+// IOCTL REGION_SWAP
+struct region_swap
+{
+    unsigned int packed_a; // (client_id, 0) или (server_id, sub_mem_id) соединений процесса
+    unsigned int packed_b;
+};
+
+// IOCTL CHANNEL_SUBSCRIBE
+struct channel_subscribe
+{
+    int client_id;
+    char channel_name[MAX_SERVER_NAME];
+    int channel_id;           // в ответ - id канала, подобласть отображается по (channel_id, 0)
+    unsigned int region_size; // в ответ - размер подобласти канала
+    unsigned int flags;       // в ответ - SERVER_FLAG_* канала
+};
+
+// IOCTL CHANNEL_PUBLISH
+struct channel_publish
+{
+    int channel_id;
+    unsigned int len; // длина сообщения после заголовка подобласти
+};
+
+/**
+ * IOCTL SERVER_ACCEPT: дескриптор соединения для стороны сервера.
+ * Дескриптор поддерживает poll и read (уведомления только этого соединения, по sizeof(struct notification_data))
+ * и mmap со смещением 0 (область соединения). Пустой read ждет уведомления (с O_NONBLOCK - EAGAIN),
+ * после закрытия или передачи соединения read возвращает 0.
+ */
+struct server_accept
+{
+    int server_id;
+    int sub_mem_id; // подобласть соединения из NEW_CONNECTION
+    int conn_fd;    // в ответ - дескриптор соединения
+};
+
+// IOCTL QUEUE_WAIT
+struct queue_wait
+{
+    int channel_id;
+    unsigned int timeout_ms; // время ожидания задания (0 - без ограничения)
+};
+
+// IOCTL SERVER_REPLY_RECV
+#define SERVER_RECV_STOP 1 // отправить ответ и выйти из режима прямого приема запросов
+struct server_reply_recv
+{
+    int server_id;
+    int reply_sub_mem_id;         // подобласть с готовым ответом (-1 - без ответа)
+    unsigned int timeout_ms;      // время ожидания следующего запроса (0 - без ограничения)
+    unsigned int flags;           // SERVER_RECV_*
+    struct notification_data ntf; // в ответ - принятый запрос
 };
 
 /*
@@ -129,7 +383,7 @@ struct connect_to_server
 #define IOCTL_MAGIC '/'
 #define IOCTL_REGISTER_SERVER _IOWR(IOCTL_MAGIC, 1, struct server_registration) // регистрация сервера в системе
 #define IOCTL_REGISTER_CLIENT _IOR(IOCTL_MAGIC, 2, int)                         // регистрация клиента
-#define IOCTL_CONNECT_TO_SERVER _IOW(IOCTL_MAGIC, 3, struct connect_to_server)  // подключение к серверу
+#define IOCTL_CONNECT_TO_SERVER _IOWR(IOCTL_MAGIC, 3, struct connect_to_server) // подключение к серверу
 #define IOCTL_CLIENT_END_WRITING                                                                                       \
     _IOW(IOCTL_MAGIC, 4, unsigned int) // оповещение драйвера об окончании записи из клиента
 #define IOCTL_SERVER_END_WRITING                                                                                       \
@@ -141,7 +395,30 @@ struct connect_to_server
 #define IOCTL_CLIENT_UNREGISTER _IOW(IOCTL_MAGIC, 8, unsigned int) // Запрос от клиента на полное отключение (client_id)
 #define IOCTL_SERVER_UNREGISTER _IOW(IOCTL_MAGIC, 9, unsigned int) // Запрос от сервера на полное отключение (server_id)
 #define IOCTL_REGISTER_MONITOR _IO(IOCTL_MAGIC, 10)                // запрос регистрации монитора
-
-#define IOCTL_MAX_NUM 10 // максимальное количество команд
+#define IOCTL_GET_REGION_SIZE                                                                                          \
+    _IOW(IOCTL_MAGIC, 11, unsigned int) // размер отображаемой области {(client_id, 0) or (server_id, sub_mem_id)}
+#define IOCTL_CLIENT_CALL                                                                                              \
+    _IOW(IOCTL_MAGIC, 12, struct client_call) // отправка запроса и ожидание ответа сервера в ядре
+#define IOCTL_SERVER_REPLY_RECV                                                                                        \
+    _IOWR(IOCTL_MAGIC, 13, struct server_reply_recv) // ответ клиенту и ожидание следующего запроса к серверу
+#define IOCTL_REGION_RESIZE                                                                                            \
+    _IOWR(IOCTL_MAGIC, 14, struct region_resize) // увеличение области соединения без переподключения
+#define IOCTL_SERVER_MIGRATE                                                                                           \
+    _IOW(IOCTL_MAGIC, 15, struct server_migrate) // передача соединения другому участнику группы без ведома клиента
+#define IOCTL_REGION_SWAP                                                                                              \
+    _IOW(IOCTL_MAGIC, 16, struct region_swap) // обмен областями двух соединений процесса без копирования
+#define IOCTL_CHANNEL_SUBSCRIBE                                                                                        \
+    _IOWR(IOCTL_MAGIC, 17, struct channel_subscribe) // подписка клиента на канал публикации
+#define IOCTL_CHANNEL_UNSUBSCRIBE                                                                                      \
+    _IOW(IOCTL_MAGIC, 18, unsigned int) // отписка клиента от канала (client_id, 0)
+#define IOCTL_CHANNEL_PUBLISH                                                                                          \
+    _IOW(IOCTL_MAGIC, 19, struct channel_publish) // публикация сообщения всем подписчикам канала
+#define IOCTL_QUEUE_WAIT                                                                                               \
+    _IOW(IOCTL_MAGIC, 20, struct queue_wait) // ожидание задания исполнителем очереди
+#define IOCTL_QUEUE_POST                                                                                               \
+    _IOW(IOCTL_MAGIC, 21, unsigned int) // пробуждение одного ждущего исполнителя очереди (channel_id)
+#define IOCTL_SERVER_ACCEPT                                                                                            \
+    _IOWR(IOCTL_MAGIC, 22, struct server_accept) // дескриптор соединения для сервера
+#define IOCTL_MAX_NUM 22 // максимальное количество команд
 
 #endif // RIPC_H
\ No newline at end of file
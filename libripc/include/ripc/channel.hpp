@@ -0,0 +1,69 @@
+#ifndef RIPC_CHANNEL_HPP
+#define RIPC_CHANNEL_HPP
+
+#include "submem.hpp"
+#include "types.hpp"
+#include <mutex>
+#include <string>
+
+namespace ripc
+{
+
+    class RipcContext;       // Прямое объявление
+    class RipcEntityManager; // Прямое объявление
+
+    // Канал публикации: издатель пишет сообщение в одну подобласть, драйвер отображает ее
+    // всем подписчикам (Client::subscribe) только для чтения и одной командой уведомляет их всех.
+    // Канал состояния (ChannelType::STATE) публикует без драйвера: подписчики читают последний
+    // снимок из отображения (Client::readState), когда он им нужен.
+    // Очередь заданий (ChannelType::QUEUE) - кольцо ячеек: каждое задание забирает один
+    // подписчик-исполнитель (Client::takeJob), драйвер будит по одному ждущему исполнителю
+    class Channel
+    {
+      private:
+        friend class RipcEntityManager;
+
+        int m_channel_id;
+        std::string m_name;
+        size_t m_region_size; // размер подобласти канала (выбирается драйвером)
+        ChannelType m_type;
+        RipcContext &m_context;
+        bool m_initialized;
+        std::mutex m_lock;    // публикации из разных потоков не перемешиваются в подобласти
+        ChannelMemory m_mem;  // подобласть канала, отображенная для записи
+
+        // Приватный метод инициализации (ioctl register + mmap)
+        bool init();
+
+        // Запрет копирования/присваивания
+        Channel(const Channel &) = delete;
+        Channel &operator=(const Channel &) = delete;
+
+      public:
+        explicit Channel(RipcContext &ctx, const std::string &name, size_t region_size = DEFAULTS::CHANNEL_SIZE,
+                         ChannelType type = ChannelType::BROADCAST);
+        ~Channel();
+
+        // --- Получение информации ---
+        int getId() const;
+        const std::string &getName() const;
+        // наибольшая длина сообщения
+        size_t getCapacity() const;
+        ChannelType getType() const;
+        bool isInitialized() const;
+        std::string getInfo() const;
+
+        /// @brief Публикация сообщения: данные пишутся в подобласть канала один раз,
+        /// драйвер за один проход кладет уведомление в кольцо каждого подписчика.
+        /// Подписчик получает последнее сообщение: если он отстал, промежуточные пропускаются.
+        /// В канале состояния снимок заменяется без ioctl и без уведомлений.
+        /// В очереди заданий сообщение становится заданием (не длиннее SHM_QUEUE_JOB_MAX).
+        /// @return количество уведомленных подписчиков (0 для канала состояния, 0 или 1 для очереди)
+        /// или -1 при ошибке (в том числе при заполненной очереди)
+        int publish(const char *data, size_t len);
+        int publish(const std::string &data);
+    };
+
+} // namespace ripc
+
+#endif // RIPC_CHANNEL_HPP
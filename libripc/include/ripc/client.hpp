@@ -22,6 +22,7 @@ namespace ripc
     {
       private:
         friend class RipcEntityManager;
+        friend class Server;
 
         // Обработчик запросов
         using CallbackIn = std::function<void(ReadBufferView &)>;
@@ -31,6 +32,8 @@ namespace ripc
             CallbackIn m_in;
             CallbackOut m_out;
         };
+        // Обработчик сообщения канала (копия, действительная на время вызова)
+        using ChannelCallback = std::function<void(std::string_view)>;
 
         int m_client_id = -1;
         RipcContext &m_context;              // Ссылка на общий контекст
@@ -38,6 +41,8 @@ namespace ripc
         std::string m_connected_server_name; // имя сервера, к котрому подключен
         CallbackIn m_callback;               // Обработчик ответа от сервера
         bool m_is_request_sent;              // отправлен ли запрос
+        bool m_is_writing = false;           // поток пишет запрос в страницу запроса и еще не опубликовал его
+        unsigned int m_pending_seq = 0;      // номер ожидающего ответа запроса в звонке (0 - нет)
         bool m_is_using_blocking;            // используется ли блокирующий режим
         bool m_is_running;                   // работает ли еще
         std::mutex m_lock;                   // блокировка доступа
@@ -45,10 +50,44 @@ namespace ripc
 
         // Информация о разделяемой памяти
         Memory m_sub_mem;
+        int m_conn_fd = -1; // дескриптор соединения (-1 - уведомления приходят в общий поток)
+
+        // Подписка на канал публикации
+        ChannelMemory m_channel;            // подобласть канала, отображенная только для чтения
+        int m_channel_id = -1;              // id канала (-1 - подписки нет)
+        unsigned int m_channel_seq = 0;     // номер последнего обработанного сообщения канала
+        ChannelCallback m_channel_callback; // обработчик сообщений канала
+        ChannelType m_channel_type = ChannelType::BROADCAST; // вид канала подписки
 
         // Приватный метод инициализации (выполняет ioctl register)
         bool init();
 
+        // Закрытие дескриптора соединения
+        void closeConnectionFd();
+
+        // Ожидание страницы запроса: ее не пишет другой поток, а сервер прочитал прошлый запрос
+        // (блокирующий режим) или ответил на него; false - запрос отправить нельзя
+        bool acquireRequestPage();
+
+        // Публикация запроса в звонке и сохранение обработчика ответа, возвращает номер запроса
+        unsigned int publishRequest(CallbackIn &&in);
+
+        // Отправка запроса: через звонок, если сервер его опрашивает, иначе IOCTL_CLIENT_END_WRITING
+        // (ответ придет уведомлением)
+        void sendRequest(CallbackIn &&in);
+
+        // Отправка запроса и ожидание ответа: активным опросом звонка, если сервер его опрашивает,
+        // иначе в ядре через IOCTL_CLIENT_CALL
+        // 1 - ответ обработан, 0 - запрос не отправлен, -1 - ответ не пришел за время ожидания
+        int callBlocking(CallbackIn &&in);
+
+        // Обработка ответа, если он уже записан в память; ответ обрабатывается ровно один раз
+        bool completeRequest();
+
+        // Пересылка запроса из области соединения сервера upstream_packed_id (server_id, sub_mem_id):
+        // области меняются местами на время вызова, ответ остается в области источника
+        bool forward(unsigned int upstream_packed_id);
+
         // Приватный метод для проверки состояния
         // bool checkInitialized() const;
         // bool checkMapped() const;
@@ -61,6 +100,7 @@ namespace ripc
         bool handleNotification(const notification_data &ntf);
         bool dispatchNewMessage(const notification_data &ntf);
         bool dispatchRemoteDisconnect(const notification_data &ntf);
+        bool dispatchChannelMessage(const notification_data &ntf);
 
       public:
         explicit Client(RipcContext &ctx);
@@ -68,11 +108,45 @@ namespace ripc
 
         /// @brief Подключение к серверу
         /// @param server_name имя сервера
-        bool connect(const std::string &server_name);
+        /// @param region_size запрашиваемый размер общей памяти (драйвер ограничивает его максимумом сервера)
+        /// @param own_fd получить дескриптор соединения: уведомления соединения приходят в него,
+        /// а не в поток контекста, и обрабатываются через processConnectionEvents
+        bool connect(const std::string &server_name, size_t region_size = DEFAULTS::REGION_SIZE,
+                     bool own_fd = false);
 
         /// @brief отключение от сервера
         bool disconnect();
 
+        /// @brief Дескриптор соединения для poll/epoll, неблокирующий (-1 - подключение без own_fd)
+        int getConnectionFd() const;
+
+        /// @brief Обработка уведомлений, накопленных в дескрипторе соединения (вызывается по EPOLLIN)
+        /// @return количество обработанных уведомлений или -1 - ошибка
+        int processConnectionEvents();
+
+        /// @brief Подписка на канал публикации: подобласть канала отображается только для чтения,
+        /// на каждую публикацию вызывается обработчик с копией последнего сообщения.
+        /// Отставший подписчик пропускает промежуточные сообщения. У клиента может быть одна подписка.
+        /// Канал состояния не уведомляет: обработчик не передается, снимок берется через readState.
+        /// Исполнитель очереди заданий тоже подписывается без обработчика и берет задания через takeJob.
+        /// @param channel_name имя канала
+        /// @param callback обработчик сообщений (вызывается потоком уведомлений)
+        bool subscribe(const std::string &channel_name, ChannelCallback &&callback = nullptr);
+
+        /// @brief Копия последнего снимка канала состояния прямо из отображения, без обращения к драйверу
+        /// @return false - нет подписки на канал состояния, снимок еще не опубликован
+        /// или издатель не закончил запись за DEFAULTS::DOORBELL_SPIN_COUNT попыток
+        bool readState(std::string &out);
+
+        /// @brief Получение задания из очереди: без драйвера, если задание уже есть,
+        /// иначе ожидание в драйвере (одно задание будит одного исполнителя)
+        /// @param timeout_ms время ожидания (0 - без ограничения)
+        /// @return false - нет подписки на очередь, время вышло или очередь удалена
+        bool takeJob(std::string &job, unsigned int timeout_ms = DEFAULTS::CALL_TIMEOUT_MS);
+
+        /// @brief Отписка от канала публикации
+        bool unsubscribe();
+
         /// @brief Отправка запроса на сервер
         /// @param url URL запроса
         /// @param in обработчик ответа от сервера
@@ -89,6 +163,8 @@ namespace ripc
         bool isConnected() const;
         // отображена ли память
         bool isMapped() const;
+        // есть ли подписка на канал
+        bool isSubscribed() const;
         // Форматированная строка для вывода
         std::string getInfo() const;
 
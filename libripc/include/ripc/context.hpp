@@ -5,6 +5,8 @@
 #include <stdexcept> // std::runtime_error, std::logic_error
 #include <string>
 
+struct notification_ring; // кольцо уведомлений из ripc.h
+
 namespace ripc
 {
 
@@ -19,6 +21,7 @@ namespace ripc
         long page_size; // Значение по умолчанию
         std::string device_path;
         bool initialized;
+        notification_ring *notif_ring; // отображенное кольцо уведомлений процесса
 
         // Приватный конструктор, вызывается менеджером
         RipcContext();
@@ -31,6 +34,8 @@ namespace ripc
         bool openDevice(const std::string &path);
         bool closeDevice();
         bool determinePageSize();
+        bool mapNotificationRing();
+        void unmapNotificationRing();
 
       public:
         // Деструктор закрывает устройство
@@ -40,6 +45,10 @@ namespace ripc
         int getFd() const;
         long getPageSize() const;
         bool isInitialized() const;
+
+        /// @brief Кольцо уведомлений, в которое драйвер пишет уведомления процесса
+        /// @return указатель на отображенное кольцо или nullptr, если устройство не открыто
+        notification_ring *getNotificationRing() const;
     };
 
 } // namespace ripc
@@ -2,6 +2,7 @@
 #define RIPC_ENTITY_MANAGER_HPP
 
 #include "context.hpp" // Менеджер владеет контекстом
+#include "ripc/channel.hpp"
 #include "ripc/rest_client.hpp"
 #include "ripc/rest_server.hpp"
 #include "types.hpp"   // Для NotificationHandler и других общих типов
@@ -32,6 +33,7 @@ namespace ripc
         // Карты для хранения и владения объектами (ID -> Умный указатель)
         std::unordered_map<int, std::unique_ptr<Server>> servers;
         std::unordered_map<int, std::unique_ptr<Client>> clients;
+        std::unordered_map<int, std::unique_ptr<Channel>> channels;
         // Карта для пользовательских обработчиков уведомлений
         std::map<enum notif_type, NotificationHandler> notification_handlers;
 
@@ -67,6 +69,9 @@ namespace ripc
         // Основная логика потока-слушателя
         bool notificationListenerLoop();
 
+        // Разбор кольца уведомлений, возвращает количество обработанных уведомлений
+        size_t drainNotificationRing(notification_ring *ring);
+
         // Диспетчеризация полученных уведомлений
         bool dispatchNotification(const notification_data &ntf);
 
@@ -90,19 +95,28 @@ namespace ripc
          * @brief Создает, инициализирует и регистрирует новый экземпляр сервера.
          * Вызывает приватный конструктор и init() сервера.
          * @param name Имя нового сервера.
+         * @param max_region_size Максимальный размер общей памяти на соединение (0 - максимум драйвера).
+         * @param huge_pages Память соединений на огромных страницах.
+         * @param numa_node Узел NUMA для памяти соединений (SERVER_NUMA_NODE_AUTO - узел вызывающего потока).
+         * @param group Вход в группу серверов с этим именем.
          * @return Невладеющий указатель на созданный объект Server. Управление жизнью объекта остается у менеджера.
          * @throws std::runtime_error если достигнут лимит серверов или произошла ошибка при регистрации в ядре.
          * @throws std::invalid_argument если имя сервера некорректно.
          * @throws std::logic_error если менеджер не инициализирован.
          */
-        Server *createServer(const std::string &name);
+        Server *createServer(const std::string &name, size_t max_region_size = DEFAULTS::MAX_REGION_SIZE,
+                             bool huge_pages = false, int numa_node = SERVER_NUMA_NODE_AUTO,
+                             ServerGroup group = ServerGroup::NONE, const std::string &route_prefix = "");
 
         /**
          * @brief Создает, инициализирует и регистрирует новый экземпляр Restfull сервера.
          * Вызывает приватный конструктор и init() сервера.
          * @return Невладеющий указатель на созданный объект RESTServer. Управление жизнью объекта остается у менеджера.
          */
-        RESTServer* createRestfulServer(const std::string &name);
+        RESTServer* createRestfulServer(const std::string &name, size_t max_region_size = DEFAULTS::MAX_REGION_SIZE,
+                                        bool huge_pages = false, int numa_node = SERVER_NUMA_NODE_AUTO,
+                                        ServerGroup group = ServerGroup::NONE,
+                                        const std::string &route_prefix = "");
 
         /**
          * @brief Создает, инициализирует и регистрирует новый экземпляр клиента.
@@ -120,6 +134,17 @@ namespace ripc
          */
         RESTClient* createRestfulClient();
 
+        /**
+         * @brief Создает, инициализирует и регистрирует новый канал публикации.
+         * Канал занимает в драйвере место сервера процесса.
+         * @param name Имя канала (общее пространство имен с серверами).
+         * @param region_size Размер подобласти канала (драйвер округляет его до порядка подобласти).
+         * @param type Вид канала (с уведомлениями или канал состояния).
+         * @return Невладеющий указатель на созданный объект Channel. Управление жизнью объекта остается у менеджера.
+         */
+        Channel *createChannel(const std::string &name, size_t region_size = DEFAULTS::CHANNEL_SIZE,
+                               ChannelType type = ChannelType::BROADCAST);
+
         // --- Удаление сущностей ---
 
         /**
@@ -154,6 +179,13 @@ namespace ripc
          */
         bool deleteClient(Client *client);
 
+        /**
+         * @brief Удаляет канал публикации: подписчики отпускаются драйвером.
+         * @param channel Указатель на объект канала.
+         * @return true, если канал был найден и удален, иначе false.
+         */
+        bool deleteChannel(Channel *channel);
+
         // --- Поиск сущностей ---
 
         /**
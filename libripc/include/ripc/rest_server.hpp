@@ -14,7 +14,10 @@ namespace ripc
         friend class RipcEntityManager;
 
       public:
-        explicit RESTServer(RipcContext &context, const std::string &str);
+        explicit RESTServer(RipcContext &context, const std::string &str,
+                            size_t max_region_size = DEFAULTS::MAX_REGION_SIZE, bool huge_pages = false,
+                            int numa_node = SERVER_NUMA_NODE_AUTO, ServerGroup group = ServerGroup::NONE,
+                            const std::string &route_prefix = "");
         ~RESTServer();
 
         bool add(UrlPattern &&url_pattern,
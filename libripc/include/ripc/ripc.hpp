@@ -1,6 +1,7 @@
 #ifndef RIPC_API_HPP
 #define RIPC_API_HPP
 
+#include "channel.hpp"
 #include "client.hpp"
 #include "logger.hpp"
 #include "ripc/rest_client.hpp"
@@ -17,6 +18,7 @@ namespace ripc
     // Прямые объявления классов (пользователь работает с указателями)
     class Server;
     class Client;
+    class Channel;
 
     // --- Управление библиотекой ---
 
@@ -39,17 +41,28 @@ namespace ripc
     /**
      * @brief Создает и регистрирует новый экземпляр сервера.
      * @param name Имя сервера (макс. MAX_SERVER_NAME - 1 символов).
+     * @param max_region_size Максимальный размер общей памяти на соединение (0 - максимум драйвера).
+     * @param huge_pages Память соединений на огромных страницах (SHM_HUGE_REGION_SIZE) для больших сообщений.
+     * @param numa_node Узел NUMA для памяти соединений (SERVER_NUMA_NODE_AUTO - узел вызывающего потока).
+     * @param group Вход в группу серверов с этим именем: политику распределения задает первый участник.
+     * @param route_prefix Префикс URL запросов, которые группа URL_PREFIX направляет этому серверу
+     * (пустой - любые запросы, для которых у группы нет более длинного префикса).
      * @return Невладеющий указатель на созданный объект Server.
      * @throws std::runtime_error если достигнут лимит серверов или регистрация не удалась.
      * @throws std::invalid_argument если имя некорректно.
      */
-    Server *createServer(const std::string &name);
+    Server *createServer(const std::string &name, size_t max_region_size = DEFAULTS::MAX_REGION_SIZE,
+                         bool huge_pages = false, int numa_node = SERVER_NUMA_NODE_AUTO,
+                         ServerGroup group = ServerGroup::NONE, const std::string &route_prefix = "");
     /**
      * @brief Создает, инициализирует и регистрирует новый экземпляр Restfull сервера.
      * Вызывает приватный конструктор и init() сервера.
      * @return Невладеющий указатель на созданный объект RESTServer. Управление жизнью объекта остается у менеджера.
      */
-    RESTServer *createRestfulServer(const std::string &name);
+    RESTServer *createRestfulServer(const std::string &name, size_t max_region_size = DEFAULTS::MAX_REGION_SIZE,
+                                    bool huge_pages = false, int numa_node = SERVER_NUMA_NODE_AUTO,
+                                    ServerGroup group = ServerGroup::NONE,
+                                    const std::string &route_prefix = "");
 
     /**
      * @brief Создает и регистрирует новый экземпляр клиента.
@@ -65,6 +78,24 @@ namespace ripc
      */
     RESTClient *createRestfulClient();
 
+    /**
+     * @brief Создает канал публикации: издатель пишет сообщение один раз, подписчики
+     * (Client::subscribe) читают его из общей подобласти, отображенной только для чтения.
+     * @param name Имя канала (общее пространство имен с серверами).
+     * @param region_size Размер подобласти канала.
+     * @param type Вид канала: ChannelType::STATE публикует снимок без уведомлений (Client::readState).
+     * @return Невладеющий указатель на созданный объект Channel.
+     */
+    Channel *createChannel(const std::string &name, size_t region_size = DEFAULTS::CHANNEL_SIZE,
+                           ChannelType type = ChannelType::BROADCAST);
+
+    /**
+     * @brief Удаляет канал публикации, подписчики отпускаются драйвером.
+     * @param channel Указатель на объект канала.
+     * @return true, если канал был найден и удален, иначе false.
+     */
+    bool deleteChannel(Channel *channel);
+
     /**
      * @brief Удаляет экземпляр сервера по его ID ядра.
      * Вызывает деструктор объекта Server и освобождает связанные ресурсы.
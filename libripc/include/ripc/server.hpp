@@ -4,9 +4,11 @@
 #include "submem.hpp"
 #include "types.hpp" // Общие типы, notification_data, структуры Info/Mapping
 #include "url.hpp"
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept> // Для исключений
 #include <string>
@@ -18,6 +20,7 @@ namespace ripc
 
     class RipcContext;       // Прямое объявление
     class RipcEntityManager; // Прямое объявление
+    class Client;            // Прямое объявление
 
     // Класс, представляющий экземпляр сервера RIPC
     class Server
@@ -32,12 +35,20 @@ namespace ripc
         {
             UrlCallbackIn m_in;
             UrlCallbackOut m_out;
+            Client *m_forward = nullptr; // запрос целиком передается этому клиенту (обмен областями)
         };
 
         int m_server_id;
         std::string m_name;
+        size_t m_max_region_size; // максимальный размер общей памяти на соединение
+        bool m_huge_pages;        // память соединений на огромных страницах (подтверждается драйвером)
+        int m_numa_node;          // узел NUMA памяти соединений (выбирается драйвером)
+        ServerGroup m_group;      // группа серверов с этим именем (политику подтверждает драйвер)
+        std::string m_route_prefix; // префикс URL запросов этого участника в группе URL_PREFIX
         RipcContext &m_context;
         bool m_initialized;
+        std::recursive_mutex m_lock;    // защита соединений от потока уведомлений и цикла serve
+        std::atomic<bool> m_is_serving; // работает ли цикл serve
 
         struct ConnectionInfo
         {
@@ -45,6 +56,8 @@ namespace ripc
             const std::pair<const int, std::shared_ptr<Memory>> &m_sub_mem_p;
             static const std::pair<const int, std::shared_ptr<Memory>> m_null_submem;
             bool active = false;
+            unsigned int last_req_seq = 0; // номер последнего обработанного запроса из звонка
+            int conn_fd = -1;              // дескриптор соединения (-1 - уведомления приходят в общий поток)
             ConnectionInfo(int client_id, const std::pair<const int, std::shared_ptr<Memory>> &sub_mem)
                 : client_id(client_id), m_sub_mem_p(sub_mem), active(true)
             {
@@ -71,22 +84,44 @@ namespace ripc
         Server(const Server &) = delete;
         Server &operator=(const Server &) = delete;
 
-        bool writeToClient(std::shared_ptr<ConnectionInfo> con, WriteBufferView &result);
+        bool writeToClient(std::shared_ptr<ConnectionInfo> con);
+
+        // публикация ответа в звонке, возвращает true, если клиента нужно уведомить через драйвер
+        bool publishReply(std::shared_ptr<ConnectionInfo> con);
+
+        // уведомление клиента об ответе через IOCTL_SERVER_END_WRITING
+        bool notifyClient(int sub_mem_id);
+
+        // опрос звонков соединений: spin - активно ждать запрос с выставленным флагом опроса,
+        // перед возвратом без запроса флаги снимаются
+        bool pollRequests(bool spin, notification_data &ntf);
+        bool findPublishedRequest(bool polling, notification_data &ntf);
 
         // --- Обработка уведомлений ---
         bool handleNotification(const notification_data &ntf);
         bool dispatchNewMessage(const notification_data &ntf);
 
+        // обработка запроса без отправки ответа, возвращает соединение, в память которого записан ответ
+        std::shared_ptr<ConnectionInfo> processRequest(const notification_data &ntf);
+
         // отключение клиента
         bool disconnectFromClient(std::shared_ptr<ConnectionInfo> con);
 
       public:
-        explicit Server(RipcContext &ctx, const std::string &server_name);
+        explicit Server(RipcContext &ctx, const std::string &server_name,
+                        size_t max_region_size = DEFAULTS::MAX_REGION_SIZE, bool huge_pages = false,
+                        int numa_node = SERVER_NUMA_NODE_AUTO, ServerGroup group = ServerGroup::NONE,
+                        const std::string &route_prefix = "");
         ~Server();
 
         // --- Получение информации ---
         int getId() const;
         const std::string &getName() const;
+        size_t getMaxRegionSize() const;
+        bool usesHugePages() const;
+        int getNumaNode() const;
+        ServerGroup getGroup() const;
+        const std::string &getRoutePrefix() const;
         bool isInitialized() const;
         std::string getInfo() const;
 
@@ -94,8 +129,38 @@ namespace ripc
         bool registerCallback(UrlPattern &&url_pattern, UrlCallbackFull &&callback);
         bool registerCallback(UrlPattern &&url_pattern, UrlCallbackIn &&in, UrlCallbackOut &&out);
 
+        /// @brief Пересылка запросов на шаблонный url через клиента следующего сервера без копирования:
+        /// драйвер обменивает области соединений, запрос уходит дальше, ответ возвращается тем же путем.
+        /// Клиент должен быть в блокирующем режиме и подключен с областью того же размера, что у источника.
+        bool registerForward(UrlPattern &&url_pattern, Client *downstream);
+
         // отключение от клиента
         bool disconnect(int id);
+
+        /// @brief Передача соединения с клиентом другому участнику группы (IOCTL_SERVER_MIGRATE).
+        /// Клиент продолжает работу с той же областью и не переподключается.
+        /// @return false, если соединения нет, сервер не из группы или запрос клиента еще обрабатывается
+        bool migrate(int client_id, int target_server_id);
+
+        /// @brief Дескриптор соединения с клиентом (IOCTL_SERVER_ACCEPT): уведомления соединения
+        /// приходят в него, а не в поток контекста, и обрабатываются через processConnectionEvents.
+        /// Соединение должно быть уже принято потоком уведомлений (NEW_CONNECTION).
+        /// @return неблокирующий дескриптор для poll/epoll или -1 - ошибка
+        int accept(int client_id);
+
+        /// @brief Обработка уведомлений, накопленных в дескрипторе соединения (вызывается по EPOLLIN)
+        /// @return количество обработанных уведомлений или -1 - ошибка
+        int processConnectionEvents(int conn_fd);
+
+        /// @brief Обработка запросов в цикле "ответ + прием следующего запроса" (IOCTL_SERVER_REPLY_RECV).
+        /// Под постоянной нагрузкой на каждый запрос приходится один системный вызов.
+        /// Блокирует вызывающий поток; сервер нельзя удалять, пока цикл работает.
+        /// @param max_requests количество запросов, после которого цикл завершается (0 - до stopServing)
+        /// @return false, если драйвер перестал принимать запросы для сервера
+        bool serve(size_t max_requests = 0);
+
+        /// @brief Остановка цикла serve (завершится не позже, чем через DEFAULTS::SERVE_TIMEOUT_MS)
+        void stopServing();
     };
 
 } // namespace ripc
@@ -16,32 +16,38 @@ namespace ripc
     class Server;
     class Client;
 
-    // структура общей области памяти
-    struct Memory
+    struct Memory;
+
+    // половина подобласти: запросы клиента или ответы сервера (SHM_RESPONSE_OFFSET)
+    struct MemoryArea
     {
-        // даем доступ к рабюоте собщей памятию клиенту и серверу
-        friend class Server;
-        friend class Client;
+        friend struct Memory;
 
-        Memory(RipcContext &context);
+        MemoryArea(Memory &owner, bool is_request);
 
-        Memory() = delete;
-        ~Memory();
+        MemoryArea() = delete;
 
         // Запрет копирования
-        Memory(const Memory &) = delete;
-        Memory &operator=(const Memory &) = delete;
-
-        RipcContext &m_context;
-        // адрес памяти
+        MemoryArea(const MemoryArea &) = delete;
+        MemoryArea &operator=(const MemoryArea &) = delete;
+
+        // подобласть, которой принадлежит половина
+        Memory &m_owner;
+        // половина запросов (после управляющего блока) или ответов
+        bool m_is_request;
+        // адрес памяти под сообщение
         char *m_addr;
-        // максимальный размер памяти
+        // максимальный размер памяти (текущий размер половины)
         size_t m_max_size;
+        // описание сообщения этой половины в управляющем блоке
+        shm_msg_desc *m_desc;
         // отображена ли память
         bool m_is_mapped;
 
-        bool mmap(int first_id, int second_id);
-        bool unmap();
+        // размер подобласти мог вырасти по запросу соседа: читается из управляющего блока
+        void syncSize();
+        // увеличение подобласти, чтобы в сообщение этой половины помещалось capacity байт
+        bool grow(size_t capacity);
 
         // элемент после последнего
         char* end() const;
@@ -62,13 +68,133 @@ namespace ripc
         bool add(size_t offset, char ch);
     };
 
+    // структура общей области памяти
+    struct Memory
+    {
+        // даем доступ к рабюоте собщей памятию клиенту и серверу
+        friend class Server;
+        friend class Client;
+
+        Memory(RipcContext &context);
+
+        Memory() = delete;
+        ~Memory();
+
+        // Запрет копирования
+        Memory(const Memory &) = delete;
+        Memory &operator=(const Memory &) = delete;
+
+        RipcContext &m_context;
+        // адрес отображения (начинается с управляющего блока)
+        char *m_base;
+        // размер отображения (ограничение сервера)
+        size_t m_map_size;
+        // управляющий блок подобласти
+        shm_doorbell *m_doorbell;
+        // текущий размер подобласти
+        size_t m_region_size;
+        // запакованные id, по которым отображена память
+        u32 m_packed_id;
+        // отображена ли память
+        bool m_is_mapped;
+        // запросы клиента
+        MemoryArea m_request;
+        // ответы сервера
+        MemoryArea m_response;
+
+        bool mmap(int first_id, int second_id);
+        bool unmap();
+
+        // размер подобласти мог вырасти по запросу соседа: читается из управляющего блока
+        void syncSize();
+        // увеличение подобласти до region_size байт
+        bool grow(size_t region_size);
+
+        // дверной звонок: счетчики запросов/ответов и флаги опроса (без системных вызовов)
+        unsigned int requestSeq() const;
+        unsigned int responseSeq() const;
+        unsigned int publishRequest();
+        void publishResponse(unsigned int seq);
+        void setServerPolling(bool polling);
+        bool isServerPolling() const;
+        void setClientPolling(bool polling);
+        bool isClientPolling() const;
+
+        // запросы распределяет драйвер между участниками группы: забирать их со звонка нельзя
+        bool isRouted() const;
+
+        // сервер прочитал запрос seq: клиент может писать в страницу запроса следующий
+        void ackRequest(unsigned int seq);
+        bool isRequestAcked() const;
+
+        // пауза внутри цикла активного ожидания
+        static void cpuRelax();
+
+      private:
+        // размеры половин для подобласти region_size байт
+        void setRegionSize(size_t region_size);
+    };
+
+    // подобласть канала публикации: заголовок (shm_channel_header) и сразу за ним сообщение
+    struct ChannelMemory
+    {
+        ChannelMemory(RipcContext &context);
+
+        ChannelMemory() = delete;
+        ~ChannelMemory();
+
+        // Запрет копирования
+        ChannelMemory(const ChannelMemory &) = delete;
+        ChannelMemory &operator=(const ChannelMemory &) = delete;
+
+        RipcContext &m_context;
+        // адрес отображения (начинается с заголовка)
+        char *m_base;
+        // размер отображения
+        size_t m_map_size;
+        // заголовок подобласти
+        shm_channel_header *m_header;
+        // отображена ли память
+        bool m_is_mapped;
+
+        // отображение подобласти канала (channel_id, 0): издателю - для записи, подписчику - только для чтения
+        bool mmap(int channel_id, size_t size, bool writable);
+        bool unmap();
+
+        // место под сообщение
+        size_t capacity() const;
+
+        // издатель: номер становится нечетным на время записи сообщения
+        void beginWrite();
+
+        // издатель канала состояния: длина и следующий четный номер публикуются без драйвера
+        void endWrite(size_t len);
+
+        // подписчик: копия последнего сообщения и его номер;
+        // false - публикаций еще не было или издатель переписал сообщение во время копирования
+        bool readLatest(std::string &out, unsigned int &seq) const;
+
+        // очередь заданий (SERVER_FLAG_QUEUE): подобласть начинается с shm_queue_header
+        shm_queue_header *queueHeader() const;
+        shm_queue_slot *queueSlot(unsigned int pos) const;
+
+        // издатель: задание в следующую ячейку; false - очередь заполнена
+        bool enqueue(const char *data, size_t len);
+
+        // издатель: ждет ли задание хотя бы один исполнитель (тогда его нужно разбудить через драйвер)
+        bool hasQueueWaiters() const;
+
+        // исполнитель: забрать первое задание без блокировок; false - очередь пуста
+        bool dequeue(std::string &out);
+    };
+
     // Буфер для регулирования доступа к общей памяти
     class BufferView
     {
     protected:
 
-        // Адрес памяти, которой управляет этот буфер
-        Memory &m_mem;
+        // Половина подобласти, которой управляет этот буфер
+        MemoryArea &m_mem;
 
         // Текущая позиция в буфере
         size_t m_current_size;
@@ -79,17 +205,20 @@ namespace ripc
         // Флаг: было ли закончено сообщение
         bool m_memory_finalized;
 
-        // разделитель между заголовками
-        static const char m_header_delimeter = '\t';//'\t';
+        // Длина секции заголовков (у читателя - из описания сообщения)
+        size_t m_header_len;
+
+        // Длина полезной нагрузки (у читателя - из описания сообщения)
+        size_t m_payload_len;
 
-        // разделитель между заголовками и полезной нагрузкой
-        static const char m_memory_delimeter = '\n';//'\r';
+        // Результат обработки сообщения
+        int m_status;
 
-        // символ окончания сообщения
-        static const char m_memory_finalizer = '\0';//'\0'
+        // разделитель между заголовками
+        static const char m_header_delimeter = '\t';//'\t';
 
     public:
-        BufferView(Memory &mem);
+        BufferView(MemoryArea &mem);
         BufferView() = delete;
         virtual ~BufferView() {};
 
@@ -105,7 +234,7 @@ namespace ripc
          *  Публичный API для конечного приложения
          */
         /// @brief Очистка буфера
-        void reset();
+        virtual void reset();
 
         /// @brief Получить максимальный размер буфера
         /// @return максимальный размер буфера
@@ -123,6 +252,10 @@ namespace ripc
         /// @return 1 - удачное закрытие секции полезной нагрузки, 0 - секция полезной нагрузки не закрыта
         virtual bool finalizePayload() = 0;
 
+        /// @brief Получить результат обработки сообщения
+        /// @return 0 - успех, иначе код, заданный приложением
+        int getStatus() const;
+
         /// @brief Получение буфера в виде си строки
         /// @param ch куда будет записан буфер
         /// @return длина буфера
@@ -146,9 +279,12 @@ namespace ripc
         bool m_headers_initialized;
 
     public:
-        WriteBufferView(Memory &mem);
+        WriteBufferView(MemoryArea &mem);
         ~WriteBufferView() {};
 
+        /// @brief Очистка буфера и описания сообщения
+        void reset() override;
+
         /// @brief Добавить заголовок отделенный символом ':' от других заголовков
         /// @param data данные для добавления заголовка
         /// @param len размер заголовка
@@ -160,10 +296,14 @@ namespace ripc
         /// @return true, если заголовок добавлен, false, если не добавлен
         bool addHeader(const std::string &header);
 
-        /// @brief Завершает секцию заголовков, добавляя m_memory_delimeter ('\0') в память
+        /// @brief Завершает секцию заголовков, записывая ее длину в описание сообщения
         /// @return 1 - удачное закрытие заголовочноый секции, 0 - заголовочная секция не закрыта
         bool finalizeHeader() override;
 
+        /// @brief Задать результат обработки сообщения
+        /// @param status 0 - успех, иначе код приложения
+        void setStatus(int status);
+
         /// @brief Запись полезной нагрузки
         /// @param data данные на запись
         /// @param len размер данных
@@ -175,7 +315,7 @@ namespace ripc
         /// @return 1 - данные записаны, 0 - данные не записаны
         bool setPayload(const std::string &data);
 
-        /// @brief Завершает секцию полезной нагрузки
+        /// @brief Завершает сообщение, публикуя его длины в описании сообщения
         /// @return 1 - удачное закрытие секции полезной нагрузки, 0 - секция полезной нагрузки не закрыта
         bool finalizePayload() override;
     };
@@ -184,7 +324,7 @@ namespace ripc
     class ReadBufferView : public BufferView
     {
     public:
-        ReadBufferView(Memory &mem);
+        ReadBufferView(MemoryArea &mem);
         ~ReadBufferView() {};
 
         /// @brief Получение следующего заголовка в сообщении
@@ -195,7 +335,7 @@ namespace ripc
         /// @return полезная нагрузка, либо std::nullopt, если полезная нагрузка считана
         std::optional<std::string_view> getPayload();
 
-        /// @brief Завершает секцию заголовков, добавляя m_memory_delimeter ('\0') в память
+        /// @brief Переходит к полезной нагрузке (длина заголовков известна из описания сообщения)
         /// @return 1 - удачное закрытие заголовочноый секции, 0 - заголовочная секция не закрыта
         bool finalizeHeader() override;
         
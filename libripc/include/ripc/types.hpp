@@ -24,6 +24,23 @@ namespace ripc
     // Тип для пользовательского обработчика уведомлений
     using NotificationHandler = std::function<void(const notification_data &)>;
 
+    // Участие сервера в группе серверов с одним именем (подключения распределяются драйвером)
+    enum class ServerGroup
+    {
+        NONE,              // имя принадлежит одному серверу
+        ROUND_ROBIN,       // подключения достаются участникам по кругу
+        LEAST_CONNECTIONS, // подключение получает участник с наименьшим числом соединений
+        URL_PREFIX,        // подключения - по кругу, каждый запрос - участнику с самым длинным подходящим префиксом URL
+    };
+
+    // Вид канала публикации
+    enum class ChannelType
+    {
+        BROADCAST, // каждая публикация уведомляет подписчиков
+        STATE,     // без уведомлений: читатели сами берут последний снимок из своего отображения
+        QUEUE,     // очередь заданий: каждое задание забирает один подписчик-исполнитель
+    };
+
     // --- Константы библиотеки ---
     namespace DEFAULTS
     {
@@ -31,6 +48,14 @@ namespace ripc
         constexpr int MAX_SERVERS_MAPPING =  MAX_CLIENTS_PER_SERVER;
         constexpr int MAX_SERVERS_CONNECTIONS = MAX_CLIENTS_PER_SERVER;
         constexpr int MAX_CLIENTS = MAX_CLIENTS_PER_PID;
+        constexpr size_t REGION_SIZE = SHM_REGION_PAGE_SIZE; // запрашиваемый клиентом размер области
+        constexpr size_t MAX_REGION_SIZE = 0;                 // ограничение сервера (0 - максимум драйвера)
+        constexpr size_t CHANNEL_SIZE = SHM_REGION_PAGE_SIZE;  // размер подобласти канала публикации
+        constexpr size_t NOTIF_READ_BATCH = 64;               // уведомлений за один read
+        constexpr unsigned int CALL_TIMEOUT_MS = 5000;        // ожидание ответа в ядре для блокирующего вызова
+        constexpr unsigned int SERVE_TIMEOUT_MS = 500;        // ожидание запроса в цикле Server::serve
+        constexpr unsigned int DOORBELL_SPIN_COUNT = 1024;    // итераций опроса звонка перед переходом к ioctl
+        constexpr int FORWARD_FAILED_STATUS = -1;             // статус ответа прокси, если следующий сервер не ответил
     };
 
 } // namespace ripc
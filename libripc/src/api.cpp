@@ -17,14 +17,18 @@ namespace ripc
         return RipcEntityManager::getInstance().doShutdown();
     }
 
-    Server *createServer(const std::string &name)
+    Server *createServer(const std::string &name, size_t max_region_size, bool huge_pages, int numa_node,
+                         ServerGroup group, const std::string &route_prefix)
     {
-        return RipcEntityManager::getInstance().createServer(name);
+        return RipcEntityManager::getInstance().createServer(name, max_region_size, huge_pages, numa_node, group,
+                                                             route_prefix);
     }
 
-    RESTServer *createRestfulServer(const std::string &name)
+    RESTServer *createRestfulServer(const std::string &name, size_t max_region_size, bool huge_pages, int numa_node,
+                                    ServerGroup group, const std::string &route_prefix)
     {
-        return RipcEntityManager::getInstance().createRestfulServer(name);
+        return RipcEntityManager::getInstance().createRestfulServer(name, max_region_size, huge_pages, numa_node,
+                                                                    group, route_prefix);
     }
     Client *createClient()
     {
@@ -36,6 +40,16 @@ namespace ripc
         return RipcEntityManager::getInstance().createRestfulClient();
     }
 
+    Channel *createChannel(const std::string &name, size_t region_size, ChannelType type)
+    {
+        return RipcEntityManager::getInstance().createChannel(name, region_size, type);
+    }
+
+    bool deleteChannel(Channel *channel)
+    {
+        return RipcEntityManager::getInstance().deleteChannel(channel);
+    }
+
     bool deleteServer(int server_id)
     {
         return RipcEntityManager::getInstance().deleteServer(server_id);
@@ -0,0 +1,182 @@
+#include "ripc/channel.hpp"
+#include "id_pack.h"
+#include "ripc.h"
+#include "ripc/context.hpp"
+#include "ripc/logger.hpp"
+#include <cstring>
+#include <sstream>
+#include <sys/ioctl.h>
+
+namespace ripc
+{
+
+    Channel::Channel(RipcContext &ctx, const std::string &name, size_t region_size, ChannelType type)
+        : m_channel_id(-1), m_name(name), m_region_size(region_size), m_type(type), m_context(ctx), m_initialized(false),
+          m_mem(ctx)
+    {
+        LOG_INFO("Channel's basic constructor");
+    }
+
+    bool Channel::init()
+    {
+        if (m_initialized)
+            return true;
+
+        if (m_name.empty() || m_name.length() >= MAX_SERVER_NAME)
+        {
+            LOG_CRIT("Channel's name is empty or too long");
+            return false;
+        }
+
+        // канал регистрируется как сервер, подобласть выделяет драйвер
+        server_registration reg_data{};
+        strncpy(reg_data.name, m_name.c_str(), MAX_SERVER_NAME - 1);
+        reg_data.server_id = -1;
+        reg_data.max_region_size = m_region_size;
+        reg_data.flags = SERVER_FLAG_CHANNEL;
+        if (m_type == ChannelType::STATE)
+            reg_data.flags |= SERVER_FLAG_STATE;
+        else if (m_type == ChannelType::QUEUE)
+            reg_data.flags |= SERVER_FLAG_QUEUE;
+        reg_data.numa_node = SERVER_NUMA_NODE_AUTO;
+
+        if (ioctl(m_context.getFd(), IOCTL_REGISTER_SERVER, &reg_data) < 0)
+        {
+            LOG_CRIT("failed: IOCTL_REGISTER_SERVER for channel '%s': %s ", m_name.c_str(), strerror(errno));
+            return false;
+        }
+        if (!IS_ID_VALID(reg_data.server_id))
+        {
+            LOG_CRIT("failed: returned invalid channel_id = %d", reg_data.server_id);
+            return false;
+        }
+        m_channel_id = reg_data.server_id;
+        m_region_size = reg_data.max_region_size;
+
+        if (!m_mem.mmap(m_channel_id, m_region_size, true))
+        {
+            LOG_CRIT("Channel '%s': failed to map channel memory", m_name.c_str());
+            ioctl(m_context.getFd(), IOCTL_SERVER_UNREGISTER, pack_ids(m_channel_id, 0));
+            return false;
+        }
+
+        m_initialized = true;
+        LOG_INFO("Channel '%s' initialized with ID %d (%d bytes)", m_name.c_str(), m_channel_id, (int)m_region_size);
+        return true;
+    }
+
+    Channel::~Channel()
+    {
+        LOG_INFO("Channel '%s' (ID: %d) destructing...", m_name.c_str(), m_channel_id);
+        if (!m_initialized)
+            return;
+
+        m_mem.unmap();
+
+        // подписчики отпускаются драйвером, их отображения живут до munmap
+        if (ioctl(m_context.getFd(), IOCTL_SERVER_UNREGISTER, pack_ids(m_channel_id, 0)) < 0)
+            LOG_ERR("IOCTL_SERVER_UNREGISTER for channel '%s': %s", m_name.c_str(), strerror(errno));
+    }
+
+    int Channel::getId() const
+    {
+        return m_channel_id;
+    }
+
+    const std::string &Channel::getName() const
+    {
+        return m_name;
+    }
+
+    size_t Channel::getCapacity() const
+    {
+        return m_type == ChannelType::QUEUE ? (m_initialized ? SHM_QUEUE_JOB_MAX : 0) : m_mem.capacity();
+    }
+
+    ChannelType Channel::getType() const
+    {
+        return m_type;
+    }
+
+    bool Channel::isInitialized() const
+    {
+        return m_initialized;
+    }
+
+    std::string Channel::getInfo() const
+    {
+        std::ostringstream oss;
+        oss << "  Channel Name:  '" << m_name << "'\n";
+        oss << "  Channel ID:    " << (m_channel_id == -1 ? "N/A" : std::to_string(m_channel_id)) << "\n";
+        oss << "  Initialized:   " << (m_initialized ? "Yes" : "No") << "\n";
+        oss << "  Type:          "
+            << (m_type == ChannelType::STATE ? "State" : m_type == ChannelType::QUEUE ? "Job queue" : "Broadcast") << "\n";
+        if (m_initialized)
+            oss << "  Region:        " << m_region_size << " bytes\n";
+        return oss.str();
+    }
+
+    int Channel::publish(const char *data, size_t len)
+    {
+        if (!m_initialized)
+        {
+            LOG_ERR("Not initialized");
+            return -1;
+        }
+        if (len > getCapacity() || (len && !data))
+        {
+            LOG_ERR("Channel '%s': message of %d bytes does not fit %d bytes", m_name.c_str(), (int)len,
+                    (int)getCapacity());
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        // задание забирает один исполнитель: драйвер нужен, только если все исполнители ждут в нем
+        if (m_type == ChannelType::QUEUE)
+        {
+            if (!m_mem.enqueue(data, len))
+            {
+                LOG_WARN("Channel '%s': job queue is full", m_name.c_str());
+                return -1;
+            }
+            if (!m_mem.hasQueueWaiters())
+                return 0;
+
+            int woken = ioctl(m_context.getFd(), IOCTL_QUEUE_POST, m_channel_id);
+            if (woken < 0)
+            {
+                LOG_ERR("Channel '%s': IOCTL_QUEUE_POST failed: %s", m_name.c_str(), strerror(errno));
+                return -1;
+            }
+            return woken;
+        }
+
+        // подписчики, читающие прошлое сообщение, увидят нечетный номер и отбросят копию
+        m_mem.beginWrite();
+        if (len)
+            memcpy(m_mem.m_base + SHM_CHANNEL_DATA_OFFSET, data, len);
+
+        // читатели канала состояния сами заметят новый номер
+        if (m_type == ChannelType::STATE)
+        {
+            m_mem.endWrite(len);
+            return 0;
+        }
+
+        channel_publish cp{m_channel_id, (unsigned int)len};
+        int delivered = ioctl(m_context.getFd(), IOCTL_CHANNEL_PUBLISH, &cp);
+        if (delivered < 0)
+        {
+            LOG_ERR("Channel '%s': IOCTL_CHANNEL_PUBLISH failed: %s", m_name.c_str(), strerror(errno));
+            return -1;
+        }
+        return delivered;
+    }
+
+    int Channel::publish(const std::string &data)
+    {
+        return publish(data.data(), data.size());
+    }
+
+} // namespace ripc
@@ -3,13 +3,15 @@
 #include "ripc.h"           // IOCTL, notification_data, MAX_*
 #include "ripc/context.hpp" // Для context.getFd()
 #include "ripc/logger.hpp"
+#include <chrono>
 #include <cstring> // memcpy, strncpy, memset
+#include <fcntl.h>   // fcntl
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <sys/ioctl.h>
 #include <sys/mman.h> // mmap, munmap
-#include <unistd.h>   // close не нужен
+#include <unistd.h>   // close
 
 namespace ripc
 {
@@ -41,8 +43,8 @@ namespace ripc
 
     // Приватный конструктор
     Client::Client(RipcContext &ctx)
-        : m_context(ctx), m_sub_mem(m_context), m_callback(nullptr), m_is_request_sent(false), m_is_running(true),
-          m_is_using_blocking(false)
+        : m_context(ctx), m_callback(nullptr), m_is_request_sent(false), m_is_using_blocking(false), m_is_running(true),
+          m_sub_mem(m_context), m_channel(m_context)
     {
         // ID будет установлен в init()
         // std::cout << "Client: Basic construction." << std::endl;
@@ -97,6 +99,14 @@ namespace ripc
             //           << m_client_id << "': " << strerror(err_code);
             LOG_ERR("Client destructor failed: IOCTL_CLIENT_UNREGISTER for '%d': %s", m_client_id, strerror(err_code));
         }
+        closeConnectionFd();
+    }
+
+    void Client::closeConnectionFd()
+    {
+        if (m_conn_fd >= 0)
+            close(m_conn_fd);
+        m_conn_fd = -1;
     }
 
     bool Client::call(const Url &url, CallbackIn &&in, CallbackOut &&out)
@@ -104,31 +114,12 @@ namespace ripc
         CHECK_MAPPED
         LOG_INFO("calling smth");
 
-        // проверка на ответ на предыдущий запрос
-        if (m_is_request_sent)
-        {
-            // Если используется блокирующий режим
-            if (m_is_using_blocking)
-            {
-                std::unique_lock<std::mutex> lock(m_lock);
-                LOG_INFO("Cant send request: Client is waiting for response");
-                m_cv.wait(lock, [this] { return !m_is_request_sent || !m_is_running; });
-                if (!m_is_running)
-                {
-                    LOG_WARN("Cant send request: Client stopped working");
-                    return 0;
-                }
-                LOG_INFO("Client is woked up");
-            }
-            else
-            {
-                LOG_WARN("Cant send request: there was no response from the previous request");
-                return 0;
-            }
-        }
+        // страницу запроса пишет один поток; запрос можно готовить, пока сервер отвечает на предыдущий
+        if (!acquireRequestPage())
+            return 0;
 
         // создаем буфер для записи
-        WriteBufferView wb(m_sub_mem);
+        WriteBufferView wb(m_sub_mem.m_request);
 
         // записываем url
         wb.addHeader(url.getUrl());
@@ -141,32 +132,31 @@ namespace ripc
         wb.finalizePayload();
         LOG_INFO("sending message '%.*s' to: %s", wb.getCurrentSize(), wb.getStr().c_str(), url.getUrl().c_str());
 
-        // уведомляем драйвер
-        u32 packed_id = pack_ids(m_client_id, 0);
-        if (packed_id != (u32)-EINVAL)
+        // опубликовать запрос можно только после ответа на предыдущий
+        if (m_is_using_blocking)
         {
-            if (ioctl(m_context.getFd(), IOCTL_CLIENT_END_WRITING, packed_id) < 0)
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_cv.wait(lock, [this] { return !m_is_request_sent || !m_is_running; });
+            if (!m_is_running)
             {
-                LOG_ERR("Client %d: IOCTL_CLIENT_END_WRITING failed with error: %d", m_client_id, strerror(errno));
-
-                // отмечаем, что запрос не отправлен
-                m_is_request_sent = 0;
+                LOG_WARN("Cant send request: Client stopped working");
+                m_is_writing = false;
+                m_cv.notify_all();
+                return 0;
             }
-            else
-            {
-                // отмечаем, что запрос отправлен
-                m_is_request_sent = 1;
+        }
 
-                // сохраняем обработчик ответа
-                m_callback = in;
-            }
+        // в блокирующем режиме отправляем запрос и ждем ответ прямо в ядре
+        if (m_is_using_blocking)
+        {
+            int ret = callBlocking(std::move(in));
+            if (ret >= 0)
+                return ret;
+            // ответ не пришел вовремя: дожидаемся его обычным уведомлением
         }
         else
         {
-            LOG_ERR("Client %d: Failed to pack ID for end writing notification.", m_client_id);
-
-            // отмечаем, что запрос не отправлен
-            m_is_request_sent = 0;
+            sendRequest(std::move(in));
         }
 
         if (m_is_request_sent)
@@ -196,6 +186,244 @@ namespace ripc
         return m_is_request_sent;
     }
 
+    bool Client::acquireRequestPage()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+
+            // проверка на ответ на предыдущий запрос
+            if (m_is_request_sent && !m_is_using_blocking)
+            {
+                LOG_WARN("Cant send request: there was no response from the previous request");
+                return false;
+            }
+
+            // другой поток уже пишет следующий запрос
+            m_cv.wait(lock, [this] { return !m_is_writing || !m_is_running; });
+            if (!m_is_running)
+            {
+                LOG_WARN("Cant send request: Client stopped working");
+                return false;
+            }
+            m_is_writing = true;
+            if (!m_is_request_sent)
+                return true;
+        }
+
+        // сервер прочитал запрос и пишет ответ в свою половину: страница запроса свободна
+        for (unsigned int i = 0; i < DEFAULTS::DOORBELL_SPIN_COUNT; i++)
+        {
+            if (m_sub_mem.isRequestAcked())
+                return true;
+            Memory::cpuRelax();
+        }
+
+        // запрос еще не прочитан: ответ на него освобождает страницу наверняка
+        std::unique_lock<std::mutex> lock(m_lock);
+        LOG_INFO("Cant send request: Client is waiting for response");
+        m_cv.wait(lock, [this] { return !m_is_request_sent || !m_is_running; });
+        if (!m_is_running)
+        {
+            LOG_WARN("Cant send request: Client stopped working");
+            m_is_writing = false;
+            m_cv.notify_all();
+            return false;
+        }
+        LOG_INFO("Client is woked up");
+        return true;
+    }
+
+    unsigned int Client::publishRequest(CallbackIn &&in)
+    {
+        // обработчик сохраняем до публикации, чтобы ответ его не опередил
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_callback = std::move(in);
+        m_pending_seq = m_sub_mem.publishRequest();
+        m_is_request_sent = 1;
+
+        // страница запроса теперь принадлежит серверу: следующий поток ждет его подтверждения
+        m_is_writing = false;
+        m_cv.notify_all();
+        return m_pending_seq;
+    }
+
+    void Client::sendRequest(CallbackIn &&in)
+    {
+        publishRequest(std::move(in));
+
+        // сервер сам опрашивает звонок: драйвер не нужен
+        if (m_sub_mem.isServerPolling())
+        {
+            LOG_INFO("Client %d: request published via doorbell", m_client_id);
+            return;
+        }
+
+        // уведомляем драйвер
+        u32 packed_id = pack_ids(m_client_id, 0);
+        if (packed_id != (u32)-EINVAL)
+        {
+            if (ioctl(m_context.getFd(), IOCTL_CLIENT_END_WRITING, packed_id) < 0)
+            {
+                LOG_ERR("Client %d: IOCTL_CLIENT_END_WRITING failed with error: %d", m_client_id, strerror(errno));
+            }
+            else
+            {
+                return;
+            }
+        }
+        else
+        {
+            LOG_ERR("Client %d: Failed to pack ID for end writing notification.", m_client_id);
+        }
+
+        // отмечаем, что запрос не отправлен
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_pending_seq = 0;
+        m_callback = nullptr;
+        m_is_request_sent = 0;
+    }
+
+    int Client::callBlocking(CallbackIn &&in)
+    {
+        // если ответ опоздает, его разберет поток уведомлений
+        unsigned int seq = publishRequest(std::move(in));
+
+        // сервер сам опрашивает звонок: ждем ответ активным опросом
+        if (m_sub_mem.isServerPolling())
+        {
+            m_sub_mem.setClientPolling(true);
+            for (unsigned int i = 0; i < DEFAULTS::DOORBELL_SPIN_COUNT && m_sub_mem.responseSeq() != seq; i++)
+                Memory::cpuRelax();
+            m_sub_mem.setClientPolling(false);
+
+            // после снятия флага сервер либо уже записал ответ, либо уведомит через драйвер
+            if (completeRequest())
+            {
+                LOG_INFO("Client %d: got response via doorbell", m_client_id);
+                return 1;
+            }
+            return -1;
+        }
+
+        client_call call_data;
+        call_data.client_id = m_client_id;
+        call_data.timeout_ms = DEFAULTS::CALL_TIMEOUT_MS;
+
+        if (ioctl(m_context.getFd(), IOCTL_CLIENT_CALL, &call_data) < 0)
+        {
+            int err_code = errno;
+            if (err_code == ETIMEDOUT || err_code == EINTR)
+            {
+                LOG_WARN("Client %d: IOCTL_CLIENT_CALL: %s", m_client_id, strerror(err_code));
+                return -1;
+            }
+
+            LOG_ERR("Client %d: IOCTL_CLIENT_CALL failed with error: %s", m_client_id, strerror(err_code));
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_pending_seq = 0;
+            m_callback = nullptr;
+            m_is_request_sent = 0;
+            return 0;
+        }
+
+        // ответ уже в памяти, уведомление через поток-слушатель не приходит
+        LOG_INFO("Client %d: got response directly", m_client_id);
+        completeRequest();
+        return 1;
+    }
+
+    bool Client::forward(unsigned int upstream_packed_id)
+    {
+        CHECK_MAPPED
+
+        // области можно вернуть источнику только после ответа
+        if (!m_is_using_blocking)
+        {
+            LOG_ERR("Client %d: forwarding requires blocking mode", m_client_id);
+            return false;
+        }
+        if (!acquireRequestPage())
+            return false;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_cv.wait(lock, [this] { return !m_is_request_sent || !m_is_running; });
+            if (!m_is_running)
+            {
+                LOG_WARN("Cant forward request: Client stopped working");
+                m_is_writing = false;
+                m_cv.notify_all();
+                return false;
+            }
+        }
+
+        region_swap sw;
+        sw.packed_a = upstream_packed_id;
+        sw.packed_b = pack_ids(m_client_id, 0);
+        if (ioctl(m_context.getFd(), IOCTL_REGION_SWAP, &sw) < 0)
+        {
+            LOG_ERR("Client %d: IOCTL_REGION_SWAP failed: %s", m_client_id, strerror(errno));
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_is_writing = false;
+            m_cv.notify_all();
+            return false;
+        }
+
+        // запрос источника вместе с описанием уже лежит в нашей области
+        int ret = callBlocking(nullptr);
+        if (ret < 0)
+        {
+            // ответ опоздал: страницы можно вернуть только после него
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_cv.wait(lock, [this] { return !m_is_request_sent || !m_is_running; });
+        }
+
+        // ответ следующего сервера уходит источнику, наша область возвращается на место
+        if (ioctl(m_context.getFd(), IOCTL_REGION_SWAP, &sw) < 0)
+        {
+            LOG_ERR("Client %d: cant return region to server: %s", m_client_id, strerror(errno));
+            return false;
+        }
+        return ret != 0;
+    }
+
+    bool Client::completeRequest()
+    {
+        CallbackIn callback;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            // ответ уже обработан или еще не записан
+            if (m_pending_seq == 0 || m_sub_mem.responseSeq() != m_pending_seq)
+                return false;
+
+            m_pending_seq = 0;
+            callback = std::move(m_callback);
+            m_callback = nullptr;
+        }
+
+        if (callback)
+        {
+            LOG_INFO("Client %d: Found callback", m_client_id);
+
+            // Создаем буфер для чтения из памяти
+            ReadBufferView rb(m_sub_mem.m_response);
+
+            // вызываем обработчик ответа сервера
+            callback(rb);
+            LOG_INFO("Callback called");
+        }
+        else
+        {
+            LOG_INFO("Client %d: There is no callback", m_client_id);
+        }
+
+        // Уведомление основного потока об обработке ответа на запрос
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_is_request_sent = 0;
+        m_cv.notify_all();
+        return true;
+    }
+
     // --- Публичные методы ---
     int Client::getId() const
     {
@@ -220,7 +448,186 @@ namespace ripc
         return m_sub_mem.m_is_mapped;
     }
 
-    bool Client::connect(const std::string &server_name)
+    bool Client::isSubscribed() const
+    {
+        return m_channel_id != -1;
+    }
+
+    bool Client::subscribe(const std::string &channel_name, ChannelCallback &&callback)
+    {
+        CHECK_INIT;
+
+        if (channel_name.empty() || channel_name.length() >= MAX_SERVER_NAME)
+        {
+            LOG_ERR("Invalid channel name for subscribe operation");
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_channel_id != -1)
+        {
+            LOG_ERR("Client %d already subscribed to channel %d", m_client_id, m_channel_id);
+            return false;
+        }
+
+        channel_subscribe cs{};
+        cs.client_id = m_client_id;
+        strncpy(cs.channel_name, channel_name.c_str(), MAX_SERVER_NAME - 1);
+        if (ioctl(m_context.getFd(), IOCTL_CHANNEL_SUBSCRIBE, &cs) < 0)
+        {
+            LOG_ERR("Client %d: IOCTL_CHANNEL_SUBSCRIBE to '%s' failed: %s", m_client_id, channel_name.c_str(),
+                    strerror(errno));
+            return false;
+        }
+
+        ChannelType type = (cs.flags & SERVER_FLAG_QUEUE)   ? ChannelType::QUEUE
+                           : (cs.flags & SERVER_FLAG_STATE) ? ChannelType::STATE
+                                                            : ChannelType::BROADCAST;
+
+        // обработчик нужен только каналу с уведомлениями
+        if ((type == ChannelType::BROADCAST) != (bool)callback)
+        {
+            LOG_ERR("Client %d: channel '%s' %s", m_client_id, channel_name.c_str(),
+                    callback ? "does not notify subscribers" : "needs a message callback");
+            ioctl(m_context.getFd(), IOCTL_CHANNEL_UNSUBSCRIBE, pack_ids(m_client_id, 0));
+            return false;
+        }
+
+        // подписчик отображает подобласть канала только для чтения, исполнитель очереди сам забирает задания
+        if (!m_channel.mmap(cs.channel_id, cs.region_size, type == ChannelType::QUEUE))
+        {
+            ioctl(m_context.getFd(), IOCTL_CHANNEL_UNSUBSCRIBE, pack_ids(m_client_id, 0));
+            return false;
+        }
+
+        // сообщение, опубликованное до подписки, уже лежит в подобласти: ждем следующее
+        if (type == ChannelType::BROADCAST)
+            m_channel_seq = __atomic_load_n(&m_channel.m_header->m_seq, __ATOMIC_ACQUIRE) & ~1u;
+        m_channel_callback = std::move(callback);
+        m_channel_type = type;
+        m_channel_id = cs.channel_id;
+        LOG_INFO("Client %d subscribed to channel '%s' (ID: %d)", m_client_id, channel_name.c_str(), m_channel_id);
+        return true;
+    }
+
+    bool Client::unsubscribe()
+    {
+        CHECK_INIT;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_channel_id == -1)
+        {
+            LOG_ERR("Client %d is not subscribed", m_client_id);
+            return false;
+        }
+
+        // канал мог закрыться раньше: тогда драйвер уже снял подписку
+        if (ioctl(m_context.getFd(), IOCTL_CHANNEL_UNSUBSCRIBE, pack_ids(m_client_id, 0)) < 0)
+            LOG_WARN("Client %d: IOCTL_CHANNEL_UNSUBSCRIBE failed: %s", m_client_id, strerror(errno));
+
+        m_channel.unmap();
+        m_channel_id = -1;
+        m_channel_callback = nullptr;
+        m_channel_type = ChannelType::BROADCAST;
+        return true;
+    }
+
+    bool Client::readState(std::string &out)
+    {
+        CHECK_INIT;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_channel_id == -1 || m_channel_type != ChannelType::STATE)
+        {
+            LOG_ERR("Client %d is not subscribed to a state channel", m_client_id);
+            return false;
+        }
+
+        // издатель пишет без блокировок: копия повторяется, пока номер не совпадет до и после нее
+        unsigned int seq = 0;
+        for (unsigned int i = 0; i < DEFAULTS::DOORBELL_SPIN_COUNT; i++)
+        {
+            if (m_channel.readLatest(out, seq))
+                return true;
+            if (seq == 0)
+                return false;
+            Memory::cpuRelax();
+        }
+
+        LOG_WARN("Client %d: state channel %d is being rewritten for too long", m_client_id, m_channel_id);
+        return false;
+    }
+
+    bool Client::takeJob(std::string &job, unsigned int timeout_ms)
+    {
+        CHECK_INIT;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (;;)
+        {
+            queue_wait qw{};
+            {
+                // блокировка не держится во время ожидания: другие операции клиента не стоят
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_channel_id == -1 || m_channel_type != ChannelType::QUEUE)
+                {
+                    LOG_ERR("Client %d is not subscribed to a job queue", m_client_id);
+                    return false;
+                }
+                if (m_channel.dequeue(job))
+                    return true;
+                qw.channel_id = m_channel_id;
+            }
+
+            // задание, разбудившее этот поток, мог забрать исполнитель, еще не уснувший в драйвере
+            if (timeout_ms)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                                  std::chrono::steady_clock::now());
+                if (left.count() <= 0)
+                    return false;
+                qw.timeout_ms = (unsigned int)left.count();
+            }
+
+            if (ioctl(m_context.getFd(), IOCTL_QUEUE_WAIT, &qw) < 0)
+            {
+                if (errno != ETIMEDOUT)
+                    LOG_ERR("Client %d: IOCTL_QUEUE_WAIT failed: %s", m_client_id, strerror(errno));
+                return false;
+            }
+        }
+    }
+
+    bool Client::dispatchChannelMessage(const notification_data &ntf)
+    {
+        std::string message;
+        ChannelCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            // уведомление могло прийти после отписки
+            if (m_channel_id == -1 || ntf.m_sender_id != m_channel_id)
+            {
+                LOG_INFO("Client %d: channel message from %d ignored", m_client_id, ntf.m_sender_id);
+                return true;
+            }
+
+            // сообщение уже обработано по прошлому уведомлению или издатель пишет следующее:
+            // по окончании записи придет новое уведомление
+            unsigned int seq;
+            if (!m_channel.readLatest(message, seq) || seq == m_channel_seq)
+                return true;
+
+            m_channel_seq = seq;
+            callback = m_channel_callback;
+        }
+
+        // обработчик вызывается без блокировки: он может публиковать или отписываться
+        callback(message);
+        return true;
+    }
+
+    bool Client::connect(const std::string &server_name, size_t region_size, bool own_fd)
     {
         CHECK_INIT;
 
@@ -231,10 +638,12 @@ namespace ripc
             return 0;
         }
 
-        connect_to_server connect_data;
+        connect_to_server connect_data{};
         connect_data.client_id = this->m_client_id;
         strncpy(connect_data.server_name, server_name.c_str(), MAX_SERVER_NAME - 1);
         connect_data.server_name[MAX_SERVER_NAME - 1] = '\0';
+        connect_data.region_size = region_size;
+        connect_data.flags = own_fd ? CONNECT_FLAG_FD : 0;
 
         if (ioctl(m_context.getFd(), IOCTL_CONNECT_TO_SERVER, &connect_data) < 0)
         {
@@ -245,6 +654,13 @@ namespace ripc
             return false;
         }
 
+        LOG_INFO("Client %d: requested %zu bytes, got %u bytes", m_client_id, region_size, connect_data.region_size);
+        m_conn_fd = connect_data.conn_fd;
+
+        // уведомления читаются по готовности дескриптора: пустое чтение не должно блокировать
+        if (m_conn_fd >= 0 && fcntl(m_conn_fd, F_SETFL, O_NONBLOCK) < 0)
+            LOG_WARN("Client %d: cant make connection fd non-blocking: %s", m_client_id, strerror(errno));
+
         // отображаем память
         if (!m_sub_mem.m_is_mapped)
             m_sub_mem.mmap(m_client_id, 0);
@@ -281,9 +697,41 @@ namespace ripc
         // очистка полей
         m_connected_server_name.clear();
         m_sub_mem.unmap();
+        closeConnectionFd();
         return true;
     }
 
+    int Client::getConnectionFd() const
+    {
+        return m_conn_fd;
+    }
+
+    int Client::processConnectionEvents()
+    {
+        if (m_conn_fd < 0)
+        {
+            LOG_ERR("Client %d has no connection fd", m_client_id);
+            return -1;
+        }
+
+        // дескриптор получает уведомления одной стороны: не больше одного каждого типа
+        notification_data ntfs[TYPE_MAX];
+        ssize_t len = read(m_conn_fd, ntfs, sizeof(ntfs));
+        if (len < 0)
+        {
+            if (errno == EAGAIN)
+                return 0;
+            LOG_ERR("Client %d: read from connection fd failed: %s", m_client_id, strerror(errno));
+            return -1;
+        }
+
+        // после REMOTE_DISCONNECT дескриптор закрыт, но прочитанные уведомления уже в буфере
+        int count = len / sizeof(notification_data);
+        for (int i = 0; i < count; i++)
+            handleNotification(ntfs[i]);
+        return count;
+    }
+
     std::string Client::getInfo() const
     {
         std::ostringstream oss;
@@ -295,8 +743,8 @@ namespace ripc
         oss << "  SHM Mapped:    " << (m_sub_mem.m_is_mapped ? "Yes" : "No") << "\n";
         if (m_sub_mem.m_is_mapped)
         {
-            oss << "    Address:   " << m_sub_mem.m_addr << "\n";
-            oss << "    Size:      " << m_sub_mem.m_max_size << " bytes\n";
+            oss << "    Address:   " << static_cast<void *>(m_sub_mem.m_base) << "\n";
+            oss << "    Size:      " << m_sub_mem.m_region_size << " bytes\n";
         }
         return oss.str();
     }
@@ -335,6 +783,11 @@ namespace ripc
                      m_client_id, ntf.m_sender_id, ntf.m_sub_mem_id)
             return dispatchNewMessage(ntf);
 
+        case CHANNEL_MESSAGE:
+            LOG_INFO("[Client %d Handler]: Received CHANNEL_MESSAGE notification from Channel: %d", m_client_id,
+                     ntf.m_sender_id)
+            return dispatchChannelMessage(ntf);
+
         case REMOTE_DISCONNECT:
             LOG_INFO("[Client %d Handler]: Received REMOTE_DISCONNECT notification "
                      "from Server: %d using SubMem %d",
@@ -353,36 +806,9 @@ namespace ripc
         // checkInitialized();
         // checkMapped();
 
-        if (m_callback)
-        {
-            LOG_INFO("Client %d: Found callback", m_client_id);
-            // std::cout << "Client::dispatchNewMessage: Found callback" << std::endl;
-
-            // Создаем буфер для чтения из памяти
-            ReadBufferView rb(m_sub_mem);
-
-            // вызываем обработчик ответа сервера
-            m_callback(rb);
-
-            // обнуляем обработчик
-            m_callback = nullptr;
-            LOG_INFO("Callback called");
-        }
-        else
-        {
-            LOG_INFO("Client %d: There is no callback", m_client_id);
-            // std::cout << "Client::dispatchNewMessage: There is no callback" <<
-            // std::endl;
-        }
-        m_is_request_sent = 0;
-
-        // Уведомление основного потока об обработке ответа на запрос
-        if (m_is_using_blocking)
-        {
-            std::unique_lock<std::mutex> lock(m_lock);
-            LOG_INFO("Waking up client");
-            m_cv.notify_all();
-        }
+        // ответ мог быть уже обработан при опросе звонка
+        if (!completeRequest())
+            LOG_INFO("Client %d: response was already handled", m_client_id);
 
         return true;
     }
@@ -397,6 +823,7 @@ namespace ripc
         // очистка полей
         m_connected_server_name.clear();
         m_sub_mem.unmap();
+        closeConnectionFd();
         return true;
     }
 
@@ -1,8 +1,10 @@
 #include "ripc/context.hpp"
+#include "ripc.h"
 #include "ripc/logger.hpp"
-#include <cstring>  // strerror
-#include <fcntl.h>  // open flags
-#include <unistd.h> // close, sysconf
+#include <cstring>    // strerror
+#include <fcntl.h>    // open flags
+#include <sys/mman.h> // mmap
+#include <unistd.h>   // close, sysconf
 
 namespace ripc
 {
@@ -15,7 +17,7 @@ namespace ripc
         }                                                                                                              \
     }
 
-    RipcContext::RipcContext() : device_fd(-1), page_size(-1), initialized(false)
+    RipcContext::RipcContext() : device_fd(-1), page_size(-1), initialized(false), notif_ring(nullptr)
     {
     }
 
@@ -41,11 +43,18 @@ namespace ripc
         initialized = true; // Успешно открыли
         // std::cout << "Context: Device '" << device_path << "' opened (fd=" << device_fd << ")" << std::endl;
         LOG_INFO("Device '%s' opened (fd=%d)", device_path.c_str(), device_fd);
-        return determinePageSize(); // Определяем размер страницы после успешного открытия
+        // Определяем размер страницы после успешного открытия и отображаем кольцо уведомлений
+        if (!determinePageSize() || !mapNotificationRing())
+        {
+            closeDevice();
+            return false;
+        }
+        return true;
     }
 
     bool RipcContext::closeDevice()
     {
+        unmapNotificationRing();
         if (device_fd >= 0)
         {
             int current_fd = device_fd; // Копируем на случай, если close изменит errno
@@ -97,6 +106,30 @@ namespace ripc
         return true;
     }
 
+    bool RipcContext::mapNotificationRing()
+    {
+        void *addr = ::mmap(nullptr, NOTIF_RING_MMAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, device_fd,
+                            NOTIF_RING_MMAP_OFFSET(page_size));
+        if (addr == MAP_FAILED)
+        {
+            LOG_CRIT("Failed to mmap notification ring: %s", strerror(errno));
+            return false;
+        }
+        notif_ring = static_cast<notification_ring *>(addr);
+        LOG_INFO("Notification ring mapped at %p (%zu entries)", addr, (size_t)NOTIF_RING_SIZE);
+        return true;
+    }
+
+    void RipcContext::unmapNotificationRing()
+    {
+        if (!notif_ring)
+            return;
+
+        if (::munmap(notif_ring, NOTIF_RING_MMAP_SIZE) != 0)
+            LOG_ERR("Failed to munmap notification ring: %s", strerror(errno));
+        notif_ring = nullptr;
+    }
+
     // Деструктор
     RipcContext::~RipcContext()
     {
@@ -130,4 +163,9 @@ namespace ripc
         return initialized;
     }
 
+    notification_ring *RipcContext::getNotificationRing() const
+    {
+        return notif_ring;
+    }
+
 } // namespace ripc
\ No newline at end of file
@@ -112,6 +112,8 @@ namespace ripc
         // std::cout << "EntityManager: Clearing servers (" << servers.size() << ")..." << std::endl;
         LOG_INFO("Clearing servers (%ld)", servers.size());
         servers.clear();
+        LOG_INFO("Clearing channels (%ld)", channels.size());
+        channels.clear();
 
         LOG_INFO("Clearing notifiction handlers (%ld)", notification_handlers.size());
         notification_handlers.clear();
@@ -138,7 +140,8 @@ namespace ripc
     }
 
     // --- Фабрики и Управление (с использованием unordered_map) ---
-    Server *RipcEntityManager::createServer(const std::string &name)
+    Server *RipcEntityManager::createServer(const std::string &name, size_t max_region_size, bool huge_pages,
+                                            int numa_node, ServerGroup group, const std::string &route_prefix)
     {
         if (!is_initialized)
         {
@@ -154,7 +157,7 @@ namespace ripc
         // throw std::runtime_error("Server limit reached.");
 
         auto new_server =
-            std::make_unique<Server>(getContext(), name); // std::unique_ptr<Server>(new Server(getContext(), name));
+            std::make_unique<Server>(getContext(), name, max_region_size, huge_pages, numa_node, group, route_prefix); // std::unique_ptr<Server>(new Server(getContext(), name));
         if (!new_server->init())
         {
             new_server.reset();
@@ -190,7 +193,9 @@ namespace ripc
         return raw_ptr;
     }
 
-    RESTServer *RipcEntityManager::createRestfulServer(const std::string &name)
+    RESTServer *RipcEntityManager::createRestfulServer(const std::string &name, size_t max_region_size,
+                                                       bool huge_pages, int numa_node, ServerGroup group,
+                                                       const std::string &route_prefix)
     {
         if (!is_initialized)
         {
@@ -206,7 +211,7 @@ namespace ripc
         // throw std::runtime_error("Server limit reached.");
 
         auto new_server = std::make_unique<RESTServer>(
-            getContext(), name); // std::unique_ptr<Server>(new RESTServer(getContext(), name));
+            getContext(), name, max_region_size, huge_pages, numa_node, group, route_prefix); // std::unique_ptr<Server>(new RESTServer(getContext(), name));
         if (!new_server->init())
         {
             new_server.reset();
@@ -338,6 +343,53 @@ namespace ripc
         return raw_ptr;
     }
 
+    Channel *RipcEntityManager::createChannel(const std::string &name, size_t region_size, ChannelType type)
+    {
+        if (!is_initialized)
+        {
+            LOG_CRIT("Manager is not initialized");
+            return nullptr;
+        }
+
+        auto new_channel = std::make_unique<Channel>(getContext(), name, region_size, type);
+        if (!new_channel->init())
+            return nullptr;
+
+        int new_id = new_channel->getId();
+        Channel *raw_ptr = new_channel.get();
+        std::lock_guard<std::mutex> lock(manager_mutex);
+        if (channels.count(new_id))
+        {
+            LOG_ERR("Channel ID collision detected: %d", new_id);
+            return nullptr;
+        }
+        channels.emplace(new_id, std::move(new_channel));
+        LOG_INFO("Channel '%s' (ID:%d) created", name.c_str(), new_id);
+        return raw_ptr;
+    }
+
+    bool RipcEntityManager::deleteChannel(Channel *channel)
+    {
+        if (!channel)
+        {
+            LOG_ERR("Nullptr passed as channel ptr");
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(manager_mutex);
+        if (!is_initialized)
+        {
+            LOG_CRIT("Manager not initialized");
+            return false;
+        }
+
+        if (channels.erase(channel->getId()) == 0)
+        {
+            LOG_ERR("Channel ID %d not found", channel->getId());
+            return false;
+        }
+        return true;
+    }
+
     bool RipcEntityManager::deleteServer(int server_id)
     {
         if (!IS_ID_VALID(server_id))
@@ -597,6 +649,35 @@ namespace ripc
     {
         doShutdown();
     }
+    size_t RipcEntityManager::drainNotificationRing(notification_ring *ring)
+    {
+        size_t count = 0;
+        unsigned int tail = ring->m_tail; // позицию чтения изменяет только этот поток
+        unsigned int head = __atomic_load_n(&ring->m_head, __ATOMIC_ACQUIRE);
+
+        while (tail != head && listener_running.load())
+        {
+            // копируем запись и сразу освобождаем место для драйвера
+            notification_data ntf = ring->m_entries[tail & NOTIF_RING_MASK];
+            __atomic_store_n(&ring->m_tail, ++tail, __ATOMIC_RELEASE);
+
+            if (!dispatchNotification(ntf))
+            {
+                LOG_WARN("Notification wasnt dispatched correctly");
+            }
+            else
+            {
+                LOG_INFO("Notification dispatched");
+            }
+            count++;
+
+            // драйвер мог дописать уведомления, пока обрабатывали текущее
+            if (tail == head)
+                head = __atomic_load_n(&ring->m_head, __ATOMIC_ACQUIRE);
+        }
+        return count;
+    }
+
     bool RipcEntityManager::notificationListenerLoop()
     {
         LOG_INFO("[Listener Thread %ld]: Started", std::this_thread::get_id());
@@ -623,6 +704,14 @@ namespace ripc
             return false;
         }
 
+        notification_ring *ring = getContext().getNotificationRing();
+        if (!ring)
+        {
+            LOG_CRIT("[Listener Thread %d]: Notification ring is not mapped. Stopping", std::this_thread::get_id());
+            listener_running.store(false);
+            return false;
+        }
+
         pollfd pfd;
         pfd.fd = local_fd;
         pfd.events = POLLIN; // Ждем данные для чтения
@@ -630,61 +719,74 @@ namespace ripc
 
         while (listener_running.load())
         {
-            pfd.revents = 0;               // Сбрасываем перед poll
-            int ret = poll(&pfd, 1, 1000); // Таймаут 1 секунда
-
-            if (!listener_running.load())
-                break; // Проверяем флаг после пробуждения
-
-            if (ret < 0)
-            { // Ошибка poll
-                if (errno == EINTR)
-                    continue;
-                LOG_CRIT("[Listener Thread %d]: poll failed Stopping: %s", std::this_thread::get_id(), strerror(errno));
-                // perror("[Listener Thread]: poll failed");
-                listener_running.store(false); // Ошибка, останавливаем поток
-                ret = false;
-                break;
-            }
-            else if (ret == 0)
-            {             // Таймаут
-                continue; // Ничего нет
-            }
+            // Сначала разбираем кольцо: для этого не нужны системные вызовы
+            if (drainNotificationRing(ring) > 0)
+                continue;
 
-            // Есть событие (ret > 0)
-            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            // Кольцо пусто и драйвер ничего не отложил в список переполнения - ждем в poll
+            if (__atomic_load_n(&ring->m_overflow, __ATOMIC_ACQUIRE) == 0)
             {
-                LOG_CRIT("[Listener Thread %d]: Error/Hangup/Invalid event on fd (revents: 0x%x). Stopping",
-                         std::this_thread::get_id(), pfd.revents)
-                // std::cerr << "[Listener Thread]: Error/Hangup/Invalid event on fd (revents: 0x"
-                //           << std::hex << pfd.revents << std::dec << "). Stopping." << std::endl;
-                listener_running.store(false);
-                ret = false;
-                break;
+                pfd.revents = 0;                    // Сбрасываем перед poll
+                int poll_ret = poll(&pfd, 1, 1000); // Таймаут 1 секунда
+
+                if (!listener_running.load())
+                    break; // Проверяем флаг после пробуждения
+
+                if (poll_ret < 0)
+                { // Ошибка poll
+                    if (errno == EINTR)
+                        continue;
+                    LOG_CRIT("[Listener Thread %d]: poll failed Stopping: %s", std::this_thread::get_id(),
+                             strerror(errno));
+                    listener_running.store(false); // Ошибка, останавливаем поток
+                    ret = false;
+                    break;
+                }
+
+                // Есть событие
+                if (poll_ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+                {
+                    LOG_CRIT("[Listener Thread %d]: Error/Hangup/Invalid event on fd (revents: 0x%x). Stopping",
+                             std::this_thread::get_id(), pfd.revents)
+                    listener_running.store(false);
+                    ret = false;
+                    break;
+                }
+
+                // Таймаут или новые уведомления: снова смотрим в кольцо
+                continue;
             }
 
-            if (pfd.revents & POLLIN)
+            // Кольцо переполнялось: забираем отложенные уведомления через read
             {
-                // Данные готовы к чтению
-                notification_data ntf;
+                // Данные готовы к чтению: драйвер отдает за один вызов столько уведомлений, сколько влезет
+                notification_data batch[DEFAULTS::NOTIF_READ_BATCH];
                 ssize_t bytes_read;
 
                 // Читаем все доступные уведомления
                 while (listener_running.load()) // Проверяем флаг перед каждым read
                 {
-                    bytes_read = read(local_fd, &ntf, sizeof(ntf));
+                    bytes_read = read(local_fd, batch, sizeof(batch));
 
-                    if (bytes_read == sizeof(ntf))
+                    if (bytes_read > 0 && bytes_read % sizeof(notification_data) == 0)
                     {
-                        // Диспетчеризуем полное уведомление
-                        if (!dispatchNotification(ntf))
+                        // Диспетчеризуем всю пачку
+                        size_t count = bytes_read / sizeof(notification_data);
+                        for (size_t i = 0; i < count; i++)
                         {
-                            LOG_WARN("Notification wasnt dispatched correctly");
-                        }
-                        else
-                        {
-                            LOG_INFO("Notification dispatched");
+                            if (!dispatchNotification(batch[i]))
+                            {
+                                LOG_WARN("Notification wasnt dispatched correctly");
+                            }
+                            else
+                            {
+                                LOG_INFO("Notification dispatched");
+                            }
                         }
+
+                        // Буфер заполнен не полностью - в списке ничего не осталось
+                        if (count < DEFAULTS::NOTIF_READ_BATCH)
+                            break;
                     }
                     else if (bytes_read < 0)
                     {
@@ -704,16 +806,14 @@ namespace ripc
                         }
                     }
                     else
-                    { // bytes_read == 0 (EOF?) или прочитано меньше, чем ожидалось
-                        LOG_WARN("[Listener Thread %d]: Unexpected read result %d, expected %d",
-                                 std::this_thread::get_id(), bytes_read, sizeof(ntf));
-                        // std::cerr << "[Listener Thread]: Unexpected read result (" << bytes_read
-                        //           << ", expected " << sizeof(ntf) << "). Stopping read loop." << std::endl;
+                    { // bytes_read == 0 (EOF?) или прочитано не кратное размеру уведомления
+                        LOG_WARN("[Listener Thread %d]: Unexpected read result %d, expected multiple of %d",
+                                 std::this_thread::get_id(), bytes_read, sizeof(notification_data));
                         //  Можно попытаться прочитать остаток или просто выйти из цикла read
                         break;
                     }
                 } // end read loop
-            } // end if POLLIN
+            } // end overflow read
         } // end while(listener_running)
 
         // std::cout << "[Listener Thread " << std::this_thread::get_id() << "]: Exiting." << std::endl;
@@ -6,7 +6,9 @@
 namespace ripc
 {
 
-    RESTServer::RESTServer(RipcContext &context, const std::string &str) : Server(context, str)
+    RESTServer::RESTServer(RipcContext &context, const std::string &str, size_t max_region_size, bool huge_pages,
+                           int numa_node, ServerGroup group, const std::string &route_prefix)
+        : Server(context, str, max_region_size, huge_pages, numa_node, group, route_prefix)
     {
     }
     RESTServer::~RESTServer()
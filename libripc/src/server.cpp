@@ -1,10 +1,12 @@
 #include "ripc/server.hpp"
 #include "id_pack.h"
 #include "ripc.h"
+#include "ripc/client.hpp"
 #include "ripc/context.hpp"
 #include "ripc/logger.hpp"
 #include <algorithm> // std::find_if
 #include <cstring>
+#include <fcntl.h>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -36,9 +38,12 @@ namespace ripc
     }
 
     // Приватный конструктор
-    Server::Server(RipcContext &ctx, const std::string &server_name)
-        : m_context(ctx), m_name(server_name), m_server_id(-1), m_connections{}, m_initialized(false),
-          m_mappings(DEFAULTS::MAX_SERVERS_MAPPING)
+    Server::Server(RipcContext &ctx, const std::string &server_name, size_t max_region_size, bool huge_pages,
+                   int numa_node, ServerGroup group, const std::string &route_prefix)
+        : m_context(ctx), m_name(server_name), m_server_id(-1), m_max_region_size(max_region_size),
+          m_huge_pages(huge_pages), m_numa_node(numa_node), m_group(group), m_route_prefix(route_prefix),
+          m_connections{},
+          m_initialized(false), m_is_serving(false), m_mappings(DEFAULTS::MAX_SERVERS_MAPPING)
     {
         m_connections.reserve(DEFAULTS::MAX_SERVERS_CONNECTIONS);
         
@@ -66,11 +71,27 @@ namespace ripc
             LOG_CRIT("Server's name too long");
             return false;
         }
+        if (m_route_prefix.length() >= MAX_ROUTE_PREFIX)
+        {
+            LOG_CRIT("Server's route prefix too long");
+            return false;
+        }
 
         server_registration reg_data;
         strncpy(reg_data.name, m_name.c_str(), MAX_SERVER_NAME - 1);
         reg_data.name[MAX_SERVER_NAME - 1] = '\0';
         reg_data.server_id = -1;
+        reg_data.max_region_size = m_max_region_size;
+        reg_data.flags = m_huge_pages ? SERVER_FLAG_HUGE_PAGES : 0;
+        if (m_group != ServerGroup::NONE)
+            reg_data.flags |= SERVER_FLAG_GROUP;
+        if (m_group == ServerGroup::LEAST_CONNECTIONS)
+            reg_data.flags |= SERVER_FLAG_BALANCE_LEAST;
+        if (m_group == ServerGroup::URL_PREFIX)
+            reg_data.flags |= SERVER_FLAG_ROUTE;
+        strncpy(reg_data.route_prefix, m_route_prefix.c_str(), MAX_ROUTE_PREFIX - 1);
+        reg_data.route_prefix[MAX_ROUTE_PREFIX - 1] = '\0';
+        reg_data.numa_node = m_numa_node;
 
         if (ioctl(m_context.getFd(), IOCTL_REGISTER_SERVER, &reg_data) < 0)
         {
@@ -91,6 +112,15 @@ namespace ripc
         }
 
         this->m_server_id = reg_data.server_id;
+        this->m_max_region_size = reg_data.max_region_size;
+        this->m_huge_pages = reg_data.flags & SERVER_FLAG_HUGE_PAGES;
+        this->m_numa_node = reg_data.numa_node;
+        // политику распределения выбрал первый участник группы
+        if (reg_data.flags & SERVER_FLAG_ROUTE)
+            this->m_group = ServerGroup::URL_PREFIX;
+        else if (reg_data.flags & SERVER_FLAG_GROUP)
+            this->m_group = (reg_data.flags & SERVER_FLAG_BALANCE_LEAST) ? ServerGroup::LEAST_CONNECTIONS
+                                                                         : ServerGroup::ROUND_ROBIN;
         m_initialized = true;
         // std::cout << "Server '" << m_name << "' initialized with ID " <<
         // m_server_id << "." << std::endl;
@@ -113,6 +143,11 @@ namespace ripc
             //           << m_name << "': " << strerror(err_code);
             LOG_ERR("Server init failed: IOCTL_SERVER_UNREGISTER for '%s': %s", m_name.c_str(), strerror(err_code));
         }
+
+        // закрываем дескрипторы соединений
+        for (auto &con : m_connections)
+            if (con->conn_fd >= 0)
+                close(con->conn_fd);
     }
 
     // --- Публичные методы ---
@@ -124,12 +159,33 @@ namespace ripc
     {
         return m_name;
     }
+    size_t Server::getMaxRegionSize() const
+    {
+        return m_max_region_size;
+    }
+    bool Server::usesHugePages() const
+    {
+        return m_huge_pages;
+    }
+    int Server::getNumaNode() const
+    {
+        return m_numa_node;
+    }
+    ServerGroup Server::getGroup() const
+    {
+        return m_group;
+    }
+
+    const std::string &Server::getRoutePrefix() const
+    {
+        return m_route_prefix;
+    }
     bool Server::isInitialized() const
     {
         return m_initialized;
     }
 
-    bool Server::writeToClient(std::shared_ptr<ConnectionInfo> con, WriteBufferView &result)
+    bool Server::writeToClient(std::shared_ptr<ConnectionInfo> con)
     {
         LOG_INFO("sending answer to client");
         // std::cout << "Server::WriteToClient: sending answer to client" <<
@@ -162,13 +218,29 @@ namespace ripc
         // size_t write_len = mem.second->write(0, result.data(),
         // result.getCurrentSize());
 
+        // клиент, опрашивающий звонок, заберет ответ без драйвера
+        if (!publishReply(con))
+            return true;
+
         // отправляем уведомление
-        u32 packed_id = pack_ids(m_server_id, mem.first);
+        return notifyClient(mem.first);
+    }
+
+    bool Server::publishReply(std::shared_ptr<ConnectionInfo> con)
+    {
+        auto &mem = *con->m_sub_mem_p.second;
+        mem.publishResponse(con->last_req_seq);
+        return !mem.isClientPolling();
+    }
+
+    bool Server::notifyClient(int sub_mem_id)
+    {
+        u32 packed_id = pack_ids(m_server_id, sub_mem_id);
         if (packed_id != (u32)-EINVAL)
         {
             if (ioctl(m_context.getFd(), IOCTL_SERVER_END_WRITING, packed_id) < 0)
             {
-                LOG_ERR("Server '%s' IOCTL_SERVER_END_WRITING failed for shm_id %d", m_name.c_str(), mem.first);
+                LOG_ERR("Server '%s' IOCTL_SERVER_END_WRITING failed for shm_id %d", m_name.c_str(), sub_mem_id);
                 return false;
                 // perror(("Server " + std::to_string(m_server_id) +
                 //         ": Warning - IOCTL_SERVER_END_WRITING failed for shm_id " +
@@ -193,6 +265,15 @@ namespace ripc
         oss << "  Initialized:   " << (m_initialized ? "Yes" : "No") << "\n";
         if (!m_initialized)
             return oss.str();
+        oss << "  Max region:    " << m_max_region_size << " bytes\n";
+        oss << "  Huge pages:    " << (m_huge_pages ? "yes" : "no") << "\n";
+        oss << "  NUMA node:     " << m_numa_node << "\n";
+        oss << "  Group:         "
+            << (m_group == ServerGroup::NONE                ? "no"
+                : m_group == ServerGroup::ROUND_ROBIN       ? "round-robin"
+                : m_group == ServerGroup::LEAST_CONNECTIONS ? "least connections"
+                                                            : "url prefix '" + m_route_prefix + "'")
+            << "\n";
 
         oss << "  Connections (" << m_connections.size() << " slots):\n";
         int active_conn_count = 0;
@@ -224,8 +305,8 @@ namespace ripc
                 map_slot_used = true;
                 oss << "    Slot " << i++ << ": SHM ID: " << std::left << std::setw(5) << id
                     << " -> Addr: " << std::left << std::setw(14)
-                    << (submem->m_is_mapped ? submem->m_addr : (void *)-1L) << " Size: " << std::left << std::setw(6)
-                    << (submem->m_is_mapped ? submem->m_max_size : 0)
+                    << (submem->m_is_mapped ? static_cast<void *>(submem->m_base) : (void *)-1L) << " Size: " << std::left << std::setw(6)
+                    << (submem->m_is_mapped ? submem->m_region_size : 0)
                     << " Mapped: " << (submem->m_is_mapped ? "Yes" : "No ") << "\n";
                 if (submem->m_is_mapped)
                     mapped_count++;
@@ -260,16 +341,239 @@ namespace ripc
         return registerCallback(std::move(url_pattern), std::move(UrlCallbackFull{in, out}));
     }
 
+    bool Server::registerForward(UrlPattern &&url_pattern, Client *downstream)
+    {
+        if (!downstream)
+        {
+            LOG_ERR("Forward target is NULL");
+            return false;
+        }
+        return registerCallback(std::move(url_pattern), UrlCallbackFull{nullptr, nullptr, downstream});
+    }
+
     bool Server::disconnect(int id)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_lock);
         return disconnectFromClient(findConnection(id));
     }
+
+    int Server::accept(int client_id)
+    {
+        if (!isInitialized())
+        {
+            LOG_ERR("Not initialized");
+            return -1;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(m_lock);
+        auto con = findConnection(client_id);
+        if (!con)
+        {
+            LOG_ERR("Server %d: there is no connection with client %d", m_server_id, client_id);
+            return -1;
+        }
+        if (con->conn_fd >= 0)
+            return con->conn_fd;
+
+        server_accept sa{};
+        sa.server_id = m_server_id;
+        sa.sub_mem_id = con->m_sub_mem_p.first;
+        if (ioctl(m_context.getFd(), IOCTL_SERVER_ACCEPT, &sa) < 0)
+        {
+            LOG_ERR("Server %d: IOCTL_SERVER_ACCEPT for client %d failed: %s", m_server_id, client_id,
+                    strerror(errno));
+            return -1;
+        }
+
+        LOG_INFO("Server %d: connection with client %d has fd %d", m_server_id, client_id, sa.conn_fd);
+        con->conn_fd = sa.conn_fd;
+
+        // уведомления читаются по готовности дескриптора: пустое чтение не должно блокировать
+        if (fcntl(con->conn_fd, F_SETFL, O_NONBLOCK) < 0)
+            LOG_WARN("Server %d: cant make connection fd non-blocking: %s", m_server_id, strerror(errno));
+        return con->conn_fd;
+    }
+
+    int Server::processConnectionEvents(int conn_fd)
+    {
+        // дескриптор получает уведомления одной стороны: не больше одного каждого типа
+        notification_data ntfs[TYPE_MAX];
+        ssize_t len = read(conn_fd, ntfs, sizeof(ntfs));
+        if (len < 0)
+        {
+            if (errno == EAGAIN)
+                return 0;
+            LOG_ERR("Server %d: read from connection fd %d failed: %s", m_server_id, conn_fd, strerror(errno));
+            return -1;
+        }
+
+        // REMOTE_DISCONNECT закрывает дескриптор, но прочитанные уведомления уже в буфере
+        int count = len / sizeof(notification_data);
+        for (int i = 0; i < count; i++)
+            handleNotification(ntfs[i]);
+        return count;
+    }
+
+    bool Server::migrate(int client_id, int target_server_id)
+    {
+        CHECK_INIT;
+
+        // цикл serve не заберет запрос из звонка, пока соединение передается
+        std::lock_guard<std::recursive_mutex> lock(m_lock);
+        auto con = findConnection(client_id);
+        if (!con)
+        {
+            LOG_ERR("Server %d: there is no connection with client %d", m_server_id, client_id);
+            return false;
+        }
+
+        server_migrate mg;
+        mg.server_id = m_server_id;
+        mg.sub_mem_id = con->m_sub_mem_p.first;
+        mg.target_id = target_server_id;
+        if (ioctl(m_context.getFd(), IOCTL_SERVER_MIGRATE, &mg) < 0)
+        {
+            LOG_ERR("Server %d: failed to migrate client %d to server %d: %s", m_server_id, client_id,
+                    target_server_id, strerror(errno));
+            return false;
+        }
+
+        // драйвер уже отобрал страницы: снимаем отображение и забываем соединение
+        LOG_INFO("Server %d: client %d migrated to server %d", m_server_id, client_id, target_server_id);
+        return disconnectFromClient(con);
+    }
+
+    bool Server::serve(size_t max_requests)
+    {
+        CHECK_INIT;
+        m_is_serving.store(true);
+
+        server_reply_recv rr;
+        memset(&rr, 0, sizeof(rr));
+        rr.server_id = m_server_id;
+        rr.reply_sub_mem_id = -1;
+        rr.timeout_ms = DEFAULTS::SERVE_TIMEOUT_MS;
+
+        size_t handled = 0;
+        bool ret = true;
+        while (m_is_serving.load() && (max_requests == 0 || handled < max_requests))
+        {
+            notification_data ntf;
+
+            // пока запросы идут, забираем их из звонков без системных вызовов
+            if (pollRequests(rr.reply_sub_mem_id == -1, ntf))
+            {
+                // отложенный ответ отправляем сразу, не дожидаясь следующего ioctl
+                if (rr.reply_sub_mem_id != -1)
+                {
+                    notifyClient(rr.reply_sub_mem_id);
+                    rr.reply_sub_mem_id = -1;
+                }
+            }
+            else
+            {
+                // отправляем ответ на предыдущий запрос и ждем следующий
+                int res = ioctl(m_context.getFd(), IOCTL_SERVER_REPLY_RECV, &rr);
+                rr.reply_sub_mem_id = -1;
+
+                if (res < 0)
+                {
+                    int err_code = errno;
+                    if (err_code == ETIMEDOUT || err_code == EINTR)
+                        continue;
+                    if (err_code == ENODATA)
+                    {
+                        LOG_ERR("Server '%s': IOCTL_SERVER_REPLY_RECV: server is not registered", m_name.c_str());
+                        ret = false;
+                        break;
+                    }
+                    // ответ не доставлен (например, клиент отключился), продолжаем принимать запросы
+                    LOG_WARN("Server '%s': IOCTL_SERVER_REPLY_RECV failed: %s", m_name.c_str(), strerror(err_code));
+                    continue;
+                }
+                ntf = rr.ntf;
+            }
+
+            handled++;
+            std::lock_guard<std::recursive_mutex> lock(m_lock);
+            auto con = processRequest(ntf);
+            if (con && publishReply(con))
+                rr.reply_sub_mem_id = con->m_sub_mem_p.first;
+        }
+
+        // отправляем последний ответ и возвращаем доставку запросов через поток уведомлений
+        rr.flags = SERVER_RECV_STOP;
+        if (ioctl(m_context.getFd(), IOCTL_SERVER_REPLY_RECV, &rr) < 0)
+        {
+            LOG_ERR("Server '%s': failed to leave serve loop: %s", m_name.c_str(), strerror(errno));
+        }
+
+        // снимаем флаги опроса; запросы, опубликованные без уведомления драйвера, обрабатываем здесь
+        notification_data ntf;
+        while (pollRequests(false, ntf))
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_lock);
+            dispatchNewMessage(ntf);
+        }
+
+        m_is_serving.store(false);
+        LOG_INFO("Server '%s': serve loop finished after %zu requests", m_name.c_str(), handled);
+        return ret;
+    }
+
+    bool Server::pollRequests(bool spin, notification_data &ntf)
+    {
+        unsigned int iterations = spin ? DEFAULTS::DOORBELL_SPIN_COUNT : 0;
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            if (findPublishedRequest(true, ntf))
+                return true;
+            Memory::cpuRelax();
+        }
+
+        // клиент, увидевший флаг опроса, драйвер не уведомлял: после снятия флага перечитываем счетчики
+        return findPublishedRequest(false, ntf);
+    }
+
+    bool Server::findPublishedRequest(bool polling, notification_data &ntf)
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_lock);
+        for (auto &con : m_connections)
+        {
+            if (!con || !con->active || !con->m_sub_mem_p.second || !con->m_sub_mem_p.second->m_is_mapped)
+                continue;
+
+            // запрос группы URL_PREFIX может быть адресован другому участнику: ждем уведомления драйвера
+            auto &mem = *con->m_sub_mem_p.second;
+            if (mem.isRouted())
+                continue;
+            if (mem.isServerPolling() != polling)
+                mem.setServerPolling(polling);
+
+            if (mem.requestSeq() != con->last_req_seq)
+            {
+                ntf.m_who_sends = CLIENT;
+                ntf.m_type = NEW_MESSAGE;
+                ntf.m_sub_mem_id = con->m_sub_mem_p.first;
+                ntf.m_sender_id = con->client_id;
+                ntf.m_reciver_id = m_server_id;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Server::stopServing()
+    {
+        m_is_serving.store(false);
+    }
     
     // --- Обработка Уведомлений ---
     bool Server::handleNotification(const notification_data &ntf)
     {
         // checkInitialized();
         CHECK_INIT;
+        std::lock_guard<std::recursive_mutex> lock(m_lock);
         if (ntf.m_reciver_id != this->m_server_id)
             return false;
         if (ntf.m_who_sends != CLIENT)
@@ -287,6 +591,9 @@ namespace ripc
             LOG_INFO("[Server %d Handler]: Received NEW_CONNECTION from Client %d "
                      "SubMem id: %d)",
                      m_server_id, ntf.m_type, ntf.m_sender_id, ntf.m_sub_mem_id);
+            // соединение могло быть добавлено при приеме первого запроса в serve
+            if (findConnection(ntf.m_sender_id))
+                return true;
             return addConnection(ntf.m_sender_id, ntf.m_sub_mem_id);
             break;
 
@@ -307,8 +614,11 @@ namespace ripc
             LOG_INFO("[Server %d Handler]: Received REMOTE_DISCONNECT from Client %d "
                      "SubMem id: %d)",
                      m_server_id, ntf.m_type, ntf.m_sender_id, ntf.m_sub_mem_id);
-            return disconnectFromClient(findConnection(ntf.m_sender_id));
-            break;
+        {
+            // участник группы URL_PREFIX узнает о разрыве, даже если запросов этого клиента не получал
+            auto con = findConnection(ntf.m_sender_id);
+            return con ? disconnectFromClient(con) : m_group == ServerGroup::URL_PREFIX;
+        }
         default:
             LOG_ERR("Server %d Received unhandled notification type %d", m_server_id, ntf.m_type);
             // std::cout << "Server " << m_server_id << ": Received unhandled
@@ -318,19 +628,40 @@ namespace ripc
     }
 
     bool Server::dispatchNewMessage(const notification_data &ntf)
+    {
+        // обрабатываем запрос и отправляем ответ клиенту
+        auto con = processRequest(ntf);
+        if (!con)
+            return false;
+        return writeToClient(con);
+    }
+
+    std::shared_ptr<Server::ConnectionInfo> Server::processRequest(const notification_data &ntf)
     {
         // checkInitialized();
-        CHECK_INIT;
+        CHECK_INIT_R(nullptr);
+
+        if (ntf.m_type != NEW_MESSAGE || ntf.m_who_sends != CLIENT || ntf.m_reciver_id != m_server_id)
+        {
+            LOG_ERR("Server %d: unexpected request (type=%d, sender=%d, receiver=%d)", m_server_id, ntf.m_type,
+                    ntf.m_who_sends, ntf.m_reciver_id);
+            return nullptr;
+        }
 
         // поиск нужного соединения
         auto con = findConnection(ntf.m_sender_id);
+
+        // запрос мог прийти раньше, чем поток уведомлений обработал NEW_CONNECTION
+        if (!con && addConnection(ntf.m_sender_id, ntf.m_sub_mem_id))
+            con = findConnection(ntf.m_sender_id);
+
         if (!con)
         {
             // throw std::logic_error(
             //    "Server::dispatchNewMessage: doesnt have conection to client: " +
             //    std::to_string(ntf.m_sender_id));
             LOG_ERR("Server %d doesnt have conection to client: %d", m_server_id, ntf.m_sender_id);
-            return false;
+            return nullptr;
         }
         auto &mem = con->m_sub_mem_p;
 
@@ -338,9 +669,18 @@ namespace ripc
         if (!mem.second)
         {
             LOG_ERR("empty memory ptr in connection");
-            return false;
+            return nullptr;
         }
-        ReadBufferView rb(*mem.second);
+        // запрос мог быть уже обработан: клиент уведомил драйвер, а сервер забрал его из звонка
+        unsigned int seq = mem.second->requestSeq();
+        if (seq == con->last_req_seq)
+        {
+            LOG_INFO("Server %d: request %u from client %d was already handled", m_server_id, seq, ntf.m_sender_id);
+            return nullptr;
+        }
+        con->last_req_seq = seq;
+
+        ReadBufferView rb(mem.second->m_request);
 
         // читаем URL
         LOG_INFO("Getting URL from server");
@@ -352,7 +692,7 @@ namespace ripc
             // std::cerr << "Server::dispatchNewMessage: there is no URL in the
             // memory\n";
             LOG_ERR("there is no URL in the memory");
-            return false;
+            return nullptr;
         }
 
         // создаем URl из строки
@@ -360,16 +700,27 @@ namespace ripc
         // std::cout << "Server::dispatchNewMessage: url: [" << url << "]\n";
         LOG_INFO("url: '%s'", url.getUrl().c_str());
 
-        // создаем выходной буфер
-        WriteBufferView wb(*mem.second);
+        // создаем выходной буфер: ответ пишется в свою половину, запрос остается нетронутым
+        WriteBufferView wb(mem.second->m_response);
 
         // ищем подходящий обработчик для этого url
-        bool found_callback = false;
         for (auto &[pattern, callback_struct] : m_urls)
         {
             if (pattern == url)
             {
-                found_callback = 1;
+                // запрос уходит следующему серверу обменом областей, ответ возвращается тем же путем
+                if (callback_struct.m_forward)
+                {
+                    if (!callback_struct.m_forward->forward(pack_ids(m_server_id, mem.first)))
+                    {
+                        wb.reset();
+                        wb.setStatus(DEFAULTS::FORWARD_FAILED_STATUS);
+                        wb.finalizePayload();
+                    }
+                    mem.second->ackRequest(seq);
+                    return con;
+                }
+
                 // обрабатываем входящий запрос
                 if (callback_struct.m_in)
                 {
@@ -379,6 +730,9 @@ namespace ripc
                     callback_struct.m_in(url, rb);
                 }
 
+                // запрос прочитан: клиент может готовить следующий, пока пишется ответ
+                mem.second->ackRequest(seq);
+
                 // генерируем ответные данные
                 if (callback_struct.m_out)
                 {
@@ -389,26 +743,15 @@ namespace ripc
                 }
                 wb.finalizePayload();
 
-                // отправляем ответ клиенту
-                return writeToClient(con, wb);
-                break;
+                // ответ готов к отправке клиенту
+                return con;
             }
         }
 
-        if (!found_callback)
-        {
-            if (url_str)
-            {
-                LOG_ERR("There is no callback for url: '%s'", std::string(*url_str).c_str());
-            }
-            // std::cerr << "[Server::dispatchNewMessage] There is no callback for url:
-            // " << *url_str << std::endl;
-            else
-            {
-                LOG_ERR("There is no callback for url");
-            }
-        }
-        return false;
+        LOG_ERR("There is no callback for url: '%s'", std::string(*url_str).c_str());
+        // std::cerr << "[Server::dispatchNewMessage] There is no callback for url:
+        // " << *url_str << std::endl;
+        return nullptr;
     }
 
     // отключение клиента от сервера
@@ -430,6 +773,11 @@ namespace ripc
         // удалить ячейку памяти
         m_mappings.erase(con->m_sub_mem_p.first);
 
+        // закрыть дескриптор соединения
+        if (con->conn_fd >= 0)
+            close(con->conn_fd);
+        con->conn_fd = -1;
+
         // удалить соединениеs
         auto it = std::find_if(m_connections.begin(), m_connections.end(),
                                [&con](const auto &el) { return el->client_id == con->client_id; });
@@ -560,8 +908,11 @@ namespace ripc
             map.second->mmap(m_server_id, shm_id);
         }
 
-        // создаем соединение
-        m_connections.emplace_back(std::make_shared<ConnectionInfo>(client_id, map));
+        // создаем соединение; запросы до последнего ответа обработал прежний сервер, если соединение передали
+        auto con = std::make_shared<ConnectionInfo>(client_id, map);
+        if (map.second->m_is_mapped)
+            con->last_req_seq = map.second->responseSeq();
+        m_connections.push_back(con);
 
         // std::cout << "Server " << m_server_id
         //           << ": Adding connection client " << client_id
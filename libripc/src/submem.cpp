@@ -1,9 +1,12 @@
 #include "ripc/submem.hpp"
 #include "id_pack.h"
 #include "ripc/logger.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 
 namespace ripc
@@ -46,7 +49,37 @@ namespace ripc
 
 #define CHECK_OFFSET CHECK_OFFSET_R(false)
 
-    Memory::Memory(RipcContext &context) : m_context(context), m_addr(nullptr), m_is_mapped(false), m_max_size(-1)
+    // Резервирование адреса, выровненного по SHM_HUGE_REGION_SIZE: драйвер отображает
+    // такую подобласть одной огромной страницей, иначе - постранично
+    static void *reserveHugeAligned(size_t size)
+    {
+        size_t reserve_size = size + SHM_HUGE_REGION_SIZE;
+        char *reserved = static_cast<char *>(
+            ::mmap(NULL, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+        if (reserved == MAP_FAILED)
+            return NULL;
+
+        uintptr_t start = reinterpret_cast<uintptr_t>(reserved);
+        uintptr_t aligned = (start + SHM_HUGE_REGION_SIZE - 1) & ~(uintptr_t)(SHM_HUGE_REGION_SIZE - 1);
+
+        // отдаем обратно излишки резерва до и после выровненного участка
+        if (aligned > start)
+            ::munmap(reserved, aligned - start);
+        if (start + reserve_size > aligned + size)
+            ::munmap(reinterpret_cast<void *>(aligned + size), start + reserve_size - (aligned + size));
+
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    MemoryArea::MemoryArea(Memory &owner, bool is_request)
+        : m_owner(owner), m_is_request(is_request), m_addr(nullptr), m_max_size(-1), m_desc(nullptr),
+          m_is_mapped(false)
+    {
+    }
+
+    Memory::Memory(RipcContext &context)
+        : m_context(context), m_base(nullptr), m_map_size(0), m_doorbell(nullptr), m_region_size(0), m_packed_id(0),
+          m_is_mapped(false), m_request(*this, true), m_response(*this, false)
     // m_current_size(0)
     {
     }
@@ -77,34 +110,306 @@ namespace ripc
             return false;
         }
 
+        // размер подобласти согласован при подключении и хранится в драйвере;
+        // отображается ограничение сервера, чтобы подобласть могла вырасти без повторного mmap
+        region_resize rs{packed_id, 0, 0};
+        if (ioctl(m_context.getFd(), IOCTL_REGION_RESIZE, &rs) < 0 || rs.size <= SHM_DOORBELL_SIZE)
+        {
+            LOG_ERR("%d failed to get region size: %s", first_id, strerror(errno));
+            return false;
+        }
+        size_t region_size = rs.max_size;
+
         off_t offset = (off_t)packed_id * m_context.getPageSize();
         // std::cout << "SubMem::mmap: " << first_id << ": Attempting mmap with offset
         // 0x"
         //           << std::hex << offset << " (packed 0x" << packed_id << ")" <<
         //           std::dec << std::endl;
-        LOG_INFO("%d Attempt to call mmap with offset 0x%x (packed 0x%x)", first_id, offset, packed_id);
+        LOG_INFO("%d Attempt to call mmap with offset 0x%x (packed 0x%x) size %d", first_id, offset, packed_id,
+                 (int)region_size);
+
+        // подобласть на огромной странице отображается поверх выровненного резерва
+        void *hint = NULL;
+        int flags = MAP_SHARED;
+        if (region_size % SHM_HUGE_REGION_SIZE == 0 && (hint = reserveHugeAligned(region_size)))
+            flags |= MAP_FIXED;
 
         // запрос на отображение памяти
-        char *addr = static_cast<char *>(
-            ::mmap(NULL, SHM_REGION_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_context.getFd(), offset));
+        char *addr =
+            static_cast<char *>(::mmap(hint, region_size, PROT_READ | PROT_WRITE, flags, m_context.getFd(), offset));
 
         if (addr == MAP_FAILED)
         {
             int err_code = errno;
+            if (hint)
+                ::munmap(hint, region_size);
             // throw std::runtime_error("SubMem::mmap: " +
             //                          std::to_string(first_id) + ": mmap failed: " +
             //                          strerror(err_code));
             LOG_ERR("%d mmap failed: %s", first_id, strerror(err_code));
+            return false;
         }
 
-        // запись результатов
-        m_addr = addr;
-        m_is_mapped = true;
+        // запись результатов: в начале подобласти лежит управляющий блок, за ним - запрос, во второй половине - ответ
+        m_base = addr;
+        m_map_size = region_size;
+        m_doorbell = reinterpret_cast<shm_doorbell *>(addr);
+        m_request.m_addr = addr + SHM_REQUEST_OFFSET;
+        m_request.m_desc = &m_doorbell->m_request;
+        m_response.m_addr = addr + SHM_RESPONSE_OFFSET(region_size);
+        m_response.m_desc = &m_doorbell->m_response;
+        m_is_mapped = m_request.m_is_mapped = m_response.m_is_mapped = true;
+        m_packed_id = packed_id;
         // m_current_size =
-        m_max_size = SHM_REGION_PAGE_SIZE;
+        setRegionSize(rs.size);
 
         return true;
     }
+
+    ChannelMemory::ChannelMemory(RipcContext &context)
+        : m_context(context), m_base(nullptr), m_map_size(0), m_header(nullptr), m_is_mapped(false)
+    {
+    }
+
+    ChannelMemory::~ChannelMemory()
+    {
+        if (m_is_mapped)
+            unmap();
+    }
+
+    bool ChannelMemory::mmap(int channel_id, size_t size, bool writable)
+    {
+        if (!m_context.isInitialized())
+        {
+            LOG_ERR("Context is not initialized");
+            return false;
+        }
+
+        u32 packed_id = pack_ids(channel_id, 0);
+        if (packed_id == (u32)-EINVAL || size <= SHM_CHANNEL_DATA_OFFSET)
+        {
+            LOG_ERR("(%d) invalid channel mapping (size %d)", channel_id, (int)size);
+            return false;
+        }
+
+        // подписчику драйвер не даст отображение с правом записи
+        off_t offset = (off_t)packed_id * m_context.getPageSize();
+        int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        char *addr = static_cast<char *>(::mmap(NULL, size, prot, MAP_SHARED, m_context.getFd(), offset));
+        if (addr == MAP_FAILED)
+        {
+            LOG_ERR("%d channel mmap failed: %s", channel_id, strerror(errno));
+            return false;
+        }
+
+        m_base = addr;
+        m_map_size = size;
+        m_header = reinterpret_cast<shm_channel_header *>(addr);
+        m_is_mapped = true;
+        return true;
+    }
+
+    bool ChannelMemory::unmap()
+    {
+        CHECK_MMAPED_R(true)
+
+        if (munmap(m_base, m_map_size) != 0)
+        {
+            LOG_ERR("munmap failed: %s", strerror(errno));
+            return false;
+        }
+
+        m_base = nullptr;
+        m_header = nullptr;
+        m_is_mapped = false;
+        return true;
+    }
+
+    size_t ChannelMemory::capacity() const
+    {
+        return m_is_mapped ? m_map_size - SHM_CHANNEL_DATA_OFFSET : 0;
+    }
+
+    void ChannelMemory::beginWrite()
+    {
+        // четный номер записан прошлой публикацией, по окончании записи его снова сделает четным драйвер или endWrite
+        unsigned int seq = __atomic_load_n(&m_header->m_seq, __ATOMIC_RELAXED);
+        __atomic_store_n(&m_header->m_seq, seq | 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    void ChannelMemory::endWrite(size_t len)
+    {
+        // номер нечетный с beginWrite: следующий четный открывает снимок читателям
+        unsigned int seq = __atomic_load_n(&m_header->m_seq, __ATOMIC_RELAXED);
+        __atomic_store_n(&m_header->m_len, (unsigned int)len, __ATOMIC_RELAXED);
+        __atomic_store_n(&m_header->m_seq, seq + 1, __ATOMIC_RELEASE);
+    }
+
+    bool ChannelMemory::readLatest(std::string &out, unsigned int &seq) const
+    {
+        CHECK_MMAPED
+
+        seq = __atomic_load_n(&m_header->m_seq, __ATOMIC_ACQUIRE);
+        if (seq == 0 || (seq & 1))
+            return false;
+
+        // длину пишет издатель (сам или через драйвер): за пределы подобласти не выходим
+        size_t len = std::min<size_t>(__atomic_load_n(&m_header->m_len, __ATOMIC_RELAXED), capacity());
+        out.assign(m_base + SHM_CHANNEL_DATA_OFFSET, len);
+
+        // копия годится, только если издатель за это время не начал писать следующее сообщение
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&m_header->m_seq, __ATOMIC_RELAXED) == seq;
+    }
+
+    shm_queue_header *ChannelMemory::queueHeader() const
+    {
+        return reinterpret_cast<shm_queue_header *>(m_base);
+    }
+
+    shm_queue_slot *ChannelMemory::queueSlot(unsigned int pos) const
+    {
+        // количество ячеек задает драйвер, отображение может быть меньше подобласти
+        unsigned int mask = queueHeader()->m_slot_count - 1;
+        size_t off = SHM_QUEUE_SLOTS_OFFSET + (size_t)(pos & mask) * SHM_QUEUE_SLOT_SIZE;
+        if (off + SHM_QUEUE_SLOT_SIZE > m_map_size)
+            return nullptr;
+        return reinterpret_cast<shm_queue_slot *>(m_base + off);
+    }
+
+    bool ChannelMemory::enqueue(const char *data, size_t len)
+    {
+        CHECK_MMAPED
+
+        shm_queue_header *hdr = queueHeader();
+        unsigned int lap_mask = ~(hdr->m_slot_count - 1);
+
+        // позицию записи меняет только издатель
+        unsigned int pos = __atomic_load_n(&hdr->m_tail, __ATOMIC_RELAXED);
+        shm_queue_slot *slot = queueSlot(pos);
+        if (!slot)
+            return false;
+
+        // ячейка прошлого круга еще не забрана исполнителем
+        if (__atomic_load_n(&slot->m_seq, __ATOMIC_ACQUIRE) != (pos & lap_mask))
+            return false;
+
+        if (len)
+            memcpy(reinterpret_cast<char *>(slot + 1), data, len);
+        slot->m_len = (unsigned int)len;
+        __atomic_store_n(&slot->m_seq, (pos & lap_mask) + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->m_tail, pos + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool ChannelMemory::hasQueueWaiters() const
+    {
+        // новая позиция видна драйверу раньше, чем издатель прочитает счетчик:
+        // исполнитель, не попавший в счетчик, увидит задание при проверке очереди
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        return __atomic_load_n(&queueHeader()->m_waiters, __ATOMIC_RELAXED) != 0;
+    }
+
+    bool ChannelMemory::dequeue(std::string &out)
+    {
+        CHECK_MMAPED
+
+        shm_queue_header *hdr = queueHeader();
+        unsigned int count = hdr->m_slot_count;
+        unsigned int pos = __atomic_load_n(&hdr->m_head, __ATOMIC_RELAXED);
+        for (;;)
+        {
+            shm_queue_slot *slot = queueSlot(pos);
+            if (!slot)
+                return false;
+
+            unsigned int lap = pos & ~(count - 1);
+            int diff = (int)(__atomic_load_n(&slot->m_seq, __ATOMIC_ACQUIRE) - (lap + 1));
+
+            // задания в ячейке еще нет: очередь пуста
+            if (diff < 0)
+                return false;
+
+            // ячейку уже забрал другой исполнитель: берем свежую позицию
+            if (diff > 0)
+            {
+                pos = __atomic_load_n(&hdr->m_head, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            // при неудаче pos получает текущую позицию другого исполнителя
+            if (!__atomic_compare_exchange_n(&hdr->m_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                continue;
+
+            size_t len = std::min<size_t>(slot->m_len, SHM_QUEUE_JOB_MAX);
+            out.assign(reinterpret_cast<const char *>(slot + 1), len);
+
+            // ячейка свободна для следующего круга издателя
+            __atomic_store_n(&slot->m_seq, lap + count, __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+
+    void Memory::setRegionSize(size_t region_size)
+    {
+        m_region_size = region_size;
+        m_request.m_max_size = SHM_RESPONSE_OFFSET(region_size) - SHM_REQUEST_OFFSET;
+        m_response.m_max_size = SHM_RESPONSE_OFFSET(region_size);
+    }
+
+    void Memory::syncSize()
+    {
+        if (!m_is_mapped)
+            return;
+
+        // драйвер пишет размер до того, как сосед узнает о сообщении
+        size_t region_size = __atomic_load_n(&m_doorbell->m_region_size, __ATOMIC_ACQUIRE);
+        if (region_size > m_region_size && region_size <= m_map_size)
+            setRegionSize(region_size);
+    }
+
+    bool Memory::grow(size_t region_size)
+    {
+        CHECK_MMAPED
+
+        if (region_size <= m_region_size)
+            return true;
+        if (region_size > m_map_size)
+        {
+            LOG_WARN("Cant grow region to %d bytes: server limit is %d bytes", (int)region_size, (int)m_map_size);
+            return false;
+        }
+
+        // данные подобласти переносятся драйвером, отображение остается прежним
+        region_resize rs{m_packed_id, (unsigned int)region_size, 0};
+        if (ioctl(m_context.getFd(), IOCTL_REGION_RESIZE, &rs) < 0)
+        {
+            LOG_ERR("failed to grow region to %d bytes: %s", (int)region_size, strerror(errno));
+            return false;
+        }
+
+        setRegionSize(rs.size);
+        return region_size <= m_region_size;
+    }
+
+    void MemoryArea::syncSize()
+    {
+        m_owner.syncSize();
+    }
+
+    bool MemoryArea::grow(size_t capacity)
+    {
+        CHECK_MMAPED
+
+        if (capacity <= m_max_size)
+            return true;
+
+        // подобласть растет целиком: обе половины одинаковые, перед запросом лежит управляющий блок
+        size_t half = capacity + (m_is_request ? SHM_REQUEST_OFFSET : 0);
+        return m_owner.grow(2 * half) && capacity <= m_max_size;
+    }
+
     bool Memory::unmap()
     {
         // if (!m_is_mapped)
@@ -120,9 +425,13 @@ namespace ripc
         // }
 
         CHECK_MMAPED_R(true)
-        CHECK_ADDR
+        if (!m_base)
+        {
+            LOG_ERR("addres is empty");
+            return false;
+        }
 
-        if (munmap(m_addr, (m_max_size == -1 ? SHM_REGION_PAGE_SIZE : m_max_size)) != 0)
+        if (munmap(m_base, m_map_size) != 0)
         {
             int err_code = errno;
             // throw std::runtime_error("SubMem::unmap: munmap failed: " +
@@ -131,16 +440,97 @@ namespace ripc
             return false;
         }
 
-        m_is_mapped = false;
+        m_is_mapped = m_request.m_is_mapped = m_response.m_is_mapped = false;
+        m_doorbell = nullptr;
+        m_request.m_desc = m_response.m_desc = nullptr;
         return true;
     }
 
-    char *Memory::end() const
+    /**
+     * Дверной звонок. Все обращения последовательно согласованы (seq_cst): сторона, которая публикует
+     * счетчик и затем читает флаг опроса соседа, и сосед, который снимает флаг и затем перечитывает счетчик,
+     * не могут одновременно пропустить друг друга.
+     */
+
+    unsigned int Memory::requestSeq() const
+    {
+        return __atomic_load_n(&m_doorbell->m_req_seq, __ATOMIC_SEQ_CST);
+    }
+
+    unsigned int Memory::responseSeq() const
+    {
+        return __atomic_load_n(&m_doorbell->m_resp_seq, __ATOMIC_SEQ_CST);
+    }
+
+    unsigned int Memory::publishRequest()
+    {
+        // 0 означает отсутствие запроса, поэтому при переполнении его пропускаем
+        unsigned int seq = requestSeq() + 1;
+        if (seq == 0)
+            seq = 1;
+        m_doorbell->m_request.m_seq = seq;
+        __atomic_store_n(&m_doorbell->m_req_seq, seq, __ATOMIC_SEQ_CST);
+        return seq;
+    }
+
+    void Memory::publishResponse(unsigned int seq)
+    {
+        m_doorbell->m_response.m_seq = seq;
+        __atomic_store_n(&m_doorbell->m_resp_seq, seq, __ATOMIC_SEQ_CST);
+    }
+
+    void Memory::setServerPolling(bool polling)
+    {
+        __atomic_store_n(&m_doorbell->m_server_polling, polling ? 1u : 0u, __ATOMIC_SEQ_CST);
+    }
+
+    bool Memory::isServerPolling() const
+    {
+        return __atomic_load_n(&m_doorbell->m_server_polling, __ATOMIC_SEQ_CST) != 0;
+    }
+
+    bool Memory::isRouted() const
+    {
+        return __atomic_load_n(&m_doorbell->m_routed, __ATOMIC_RELAXED) != 0;
+    }
+
+    void Memory::setClientPolling(bool polling)
+    {
+        __atomic_store_n(&m_doorbell->m_client_polling, polling ? 1u : 0u, __ATOMIC_SEQ_CST);
+    }
+
+    bool Memory::isClientPolling() const
+    {
+        return __atomic_load_n(&m_doorbell->m_client_polling, __ATOMIC_SEQ_CST) != 0;
+    }
+
+    void Memory::ackRequest(unsigned int seq)
+    {
+        __atomic_store_n(&m_doorbell->m_req_ack, seq, __ATOMIC_RELEASE);
+    }
+
+    bool Memory::isRequestAcked() const
+    {
+        return __atomic_load_n(&m_doorbell->m_req_ack, __ATOMIC_ACQUIRE) == requestSeq();
+    }
+
+    void Memory::cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#else
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+#endif
+    }
+
+    char *MemoryArea::end() const
     {
         return static_cast<char *>(m_addr) + m_max_size;
     }
 
-    char *Memory::find(size_t offset, char ch)
+    char *MemoryArea::find(size_t offset, char ch)
     {
         CHECK_MMAPED_R(nullptr);
         CHECK_ADDR_R(nullptr)
@@ -163,7 +553,7 @@ namespace ripc
         }
     }
 
-    char *Memory::find(size_t offset, const char *ch, size_t len)
+    char *MemoryArea::find(size_t offset, const char *ch, size_t len)
     {
         CHECK_MMAPED_R(nullptr);
         CHECK_ADDR_R(nullptr)
@@ -192,7 +582,7 @@ namespace ripc
         return end();
     }
 
-    char *Memory::find(size_t offset, const std::string &chars)
+    char *MemoryArea::find(size_t offset, const std::string &chars)
     {
         CHECK_MMAPED_R(nullptr);
         CHECK_ADDR_R(nullptr)
@@ -210,7 +600,7 @@ namespace ripc
         return end();
     }
 
-    size_t Memory::readUntil(size_t offset, char *buffer, size_t buffer_size, char delim)
+    size_t MemoryArea::readUntil(size_t offset, char *buffer, size_t buffer_size, char delim)
     {
         CHECK_MMAPED_R(-1);
         CHECK_ADDR_R(-1);
@@ -242,7 +632,7 @@ namespace ripc
         return read_len;
     }
 
-    size_t Memory::read(size_t offset, char *buffer, size_t buffer_size)
+    size_t MemoryArea::read(size_t offset, char *buffer, size_t buffer_size)
     {
         // if (!m_is_mapped || !m_addr)
         //     throw std::logic_error("Memory::write: Shared memory is not mapped.");
@@ -272,7 +662,7 @@ namespace ripc
         return read_len;
     }
 
-    std::string Memory::read(size_t offset, size_t buffer_size)
+    std::string MemoryArea::read(size_t offset, size_t buffer_size)
     {
         // if (!m_is_mapped || !m_addr)
         //     throw std::logic_error("Memory::write: Shared memory is not mapped.");
@@ -303,7 +693,7 @@ namespace ripc
         return out;
     }
 
-    size_t Memory::write(size_t offset, const char *buffer, size_t buffer_size)
+    size_t MemoryArea::write(size_t offset, const char *buffer, size_t buffer_size)
     {
         // if (!m_is_mapped || !m_addr)
         //     throw std::logic_error("Memory::write: Shared memory is not mapped.");
@@ -319,6 +709,10 @@ namespace ripc
             return -1;
         }
 
+        // подобласть растет до ограничения сервера
+        if (offset + buffer_size > m_max_size)
+            grow(offset + buffer_size);
+
         // Определяем, сколько байт можно записать
         size_t available_space = m_max_size - offset;
         size_t write_len = std::min(buffer_size, available_space); // Реальное кол-во байт для записи
@@ -345,7 +739,7 @@ namespace ripc
         return write_len;
     }
 
-    size_t Memory::write(size_t offset, std::string data)
+    size_t MemoryArea::write(size_t offset, std::string data)
     {
         CHECK_MMAPED_R(-1);
         CHECK_ADDR_R(-1);
@@ -359,10 +753,12 @@ namespace ripc
     //     return write(m_current_size, data, len);
     // }
 
-    bool Memory::add(size_t offset, char ch)
+    bool MemoryArea::add(size_t offset, char ch)
     {
         CHECK_MMAPED;
         CHECK_ADDR;
+        if (offset >= m_max_size)
+            grow(offset + 1);
         CHECK_OFFSET;
 
         char *dest = static_cast<char *>(m_addr) + offset;
@@ -370,12 +766,16 @@ namespace ripc
         return true;
     }
 
-    BufferView::BufferView(Memory &mem)
-        : m_mem(mem), m_headers_finalized(false), m_memory_finalized(false), m_current_size(0)
+    BufferView::BufferView(MemoryArea &mem)
+        : m_mem(mem), m_current_size(0), m_headers_finalized(false), m_memory_finalized(false), m_header_len(0),
+          m_payload_len(0), m_status(0)
     {
         if (!mem.m_is_mapped)
             LOG_ERR("Memory not mapped");
         //    throw std::logic_error("Buffer::Buffer: Memory not mapped");
+
+        // сосед мог увеличить подобласть с прошлого сообщения
+        m_mem.syncSize();
     }
 
     void BufferView::reset()
@@ -395,6 +795,11 @@ namespace ripc
         return m_current_size;
     }
 
+    int BufferView::getStatus() const
+    {
+        return m_status;
+    }
+
     std::ostream &operator<<(std::ostream &out, const BufferView &buffer)
     {
         // Проверяем, что память, на которую указывает BufferView, валидна и
@@ -441,11 +846,29 @@ namespace ripc
         return out;
     }
 
-    WriteBufferView::WriteBufferView(Memory &mem) : BufferView(mem), m_headers_initialized(false)
+    WriteBufferView::WriteBufferView(MemoryArea &mem) : BufferView(mem), m_headers_initialized(false)
     {
+        // сосед уже прочитал прошлое сообщение этой половины: описание пишется заново
+        if (m_mem.m_desc)
+            m_mem.m_desc->m_flags = 0;
         LOG_INFO("Write buffer created");
     }
 
+    void WriteBufferView::reset()
+    {
+        BufferView::reset();
+        m_headers_initialized = false;
+        m_header_len = m_payload_len = 0;
+        m_status = 0;
+        if (m_mem.m_desc)
+            m_mem.m_desc->m_flags = 0;
+    }
+
+    void WriteBufferView::setStatus(int status)
+    {
+        m_status = status;
+    }
+
     bool WriteBufferView::addHeader(const char *data, size_t len)
     {
         if (m_memory_finalized)
@@ -487,6 +910,7 @@ namespace ripc
 
         // сохраняем размер
         m_current_size += size;
+        m_header_len = m_current_size;
 
         // говрим, что первый заголовок записан
         m_headers_initialized = 1;
@@ -520,22 +944,17 @@ namespace ripc
             return true;
         }
 
-        if (!m_mem.m_is_mapped)
+        if (!m_mem.m_is_mapped || !m_mem.m_desc)
         {
             // std::cerr << "BufferView Error: memory is no mapped" << std::endl;
             LOG_ERR("memory is not mapped");
             return false;
         }
 
-        // добавляем разделитель
-        if (!m_mem.add(m_current_size, m_memory_delimeter))
-        {
-            // std::cerr << "BufferView Error: Cannot add message delimeter" <<
-            // std::endl;
-            LOG_ERR("cannot add message delimeter");
-            return false;
-        }
-        m_current_size++;
+        // полезная нагрузка начинается сразу за заголовками: граница хранится в описании сообщения
+        m_header_len = m_current_size;
+        m_mem.m_desc->m_header_len = m_header_len;
+        m_mem.m_desc->m_flags |= SHM_MSG_HEADERS;
         m_headers_finalized = true;
         LOG_INFO("headers finalized");
         return true;
@@ -572,6 +991,7 @@ namespace ripc
             return false;
         }
         m_current_size += size;
+        m_payload_len = size;
 
         LOG_INFO("Payload '%.*s' added. Cur len: %d", len, data, m_current_size);
 
@@ -604,15 +1024,10 @@ namespace ripc
             }
         }
 
-        // записываем конец сообщения
-        if (!m_mem.add(m_current_size, m_memory_finalizer))
-        {
-            // std::cerr << "WriteBufferView::finalizePayload: cannot finalize
-            // memory\n";
-            LOG_ERR("cannot finalize memory");
-            return false;
-        }
-        m_current_size++;
+        // длины сообщения: читатель узнает их без поиска конца сообщения
+        m_mem.m_desc->m_payload_len = m_payload_len;
+        m_mem.m_desc->m_status = m_status;
+        m_mem.m_desc->m_flags |= SHM_MSG_COMPLETE;
 
         m_memory_finalized = 1;
 
@@ -630,24 +1045,9 @@ namespace ripc
             return -1;
         }
 
+        // длины секций известны: у писателя - по мере записи, у читателя - из описания сообщения
         *ch = static_cast<const char *>(m_mem.m_addr);
-        size_t buffer_capacity = m_mem.m_max_size;
-        size_t len_to_write = 0;
-
-        // Ищем символ m_memory_finalizer ('\0') или конец буфера
-        const char *end_marker_ptr = static_cast<const char *>(memchr(*ch, m_memory_finalizer, buffer_capacity));
-
-        if (end_marker_ptr != nullptr)
-        {
-            // Финализатор ('\0') найден, выводим данные до него
-            len_to_write = static_cast<size_t>(end_marker_ptr - (*ch));
-        }
-        else
-        {
-            // Финализатор ('\0') не найден, выводим все до конца емкости буфера
-            len_to_write = buffer_capacity;
-        }
-        return len_to_write;
+        return m_header_len + m_payload_len;
     }
 
     std::string BufferView::getStr() const
@@ -657,8 +1057,25 @@ namespace ripc
         return std::string(ch, size);
     }
 
-    ReadBufferView::ReadBufferView(Memory &mem) : BufferView(mem)
+    ReadBufferView::ReadBufferView(MemoryArea &mem) : BufferView(mem)
     {
+        if (!m_mem.m_desc)
+            return;
+
+        // описание лежит в линии соседа: читаем его один раз
+        shm_msg_desc desc = *m_mem.m_desc;
+        if (!(desc.m_flags & SHM_MSG_COMPLETE) || desc.m_header_len > m_mem.m_max_size ||
+            desc.m_payload_len > m_mem.m_max_size - desc.m_header_len)
+        {
+            LOG_ERR("invalid message description: flags 0x%x, header %u, payload %u", desc.m_flags, desc.m_header_len,
+                    desc.m_payload_len);
+            m_headers_finalized = m_memory_finalized = true;
+            return;
+        }
+
+        m_header_len = desc.m_header_len;
+        m_payload_len = desc.m_payload_len;
+        m_status = desc.m_status;
         LOG_INFO("Read buffer created");
     }
 
@@ -684,51 +1101,33 @@ namespace ripc
             return std::nullopt;
         }
 
-        // ищем конец первого заголовка
-        char delims[3] = {m_header_delimeter, m_memory_delimeter, m_memory_finalizer};
-        char *start = m_mem.m_addr + m_current_size;
-        char *end = m_mem.find(m_current_size, delims, 3);
-
-        // Разделители не найдены, скорее всего строка кончилась
-        if (end == m_mem.end())
+        // заголовки кончились
+        if (m_current_size >= m_header_len)
         {
-            LOG_ERR("There is not delimeter between buffer and payload ");
+            m_headers_finalized = 1;
+            LOG_INFO("There is no more headers");
             return std::nullopt;
         }
 
-        // размер выделенной области
-        size_t size = end - start;
+        // ищем конец заголовка только внутри секции заголовков
+        char *start = m_mem.m_addr + m_current_size;
+        size_t left = m_header_len - m_current_size;
+        char *end = static_cast<char *>(memchr(start, m_header_delimeter, left));
 
-        // если конец равен символу разделения заголовков,
-        // то это новый заголовок
-        if (*end == m_header_delimeter)
+        // если найден разделитель заголовков, то за ним есть еще заголовок
+        if (end)
         {
+            size_t size = end - start;
             m_current_size += size + 1;
             LOG_INFO("headers delimeter is found. Cur size: %d", m_current_size);
             return std::string_view(start, size);
         }
-        // если это символ разделения заголовков и полезной части
-        // то финализируем заголовки
-        else if (*end == m_memory_delimeter)
-        {
-            m_current_size += size + 1;
-            // finalizeHeader();
-            m_headers_finalized = 1;
-            LOG_INFO("headers with payload delimeter is found. Cur size: %d", m_current_size);
-            return std::string_view(start, size);
-        }
-        // если это символ конца сообщения
-        else if (*end == m_memory_finalizer)
-        {
-            m_current_size += size + 1;
-            // finalizePayload();
-            m_headers_finalized = 1;
-            m_memory_finalized = 1;
-            LOG_INFO("end of memory is found. Cur size: %d", m_current_size);
-            return std::nullopt;
-        }
 
-        return std::nullopt;
+        // последний заголовок заканчивается вместе с секцией
+        m_current_size = m_header_len;
+        m_headers_finalized = 1;
+        LOG_INFO("last header is found. Cur size: %d", m_current_size);
+        return std::string_view(start, left);
     }
 
     std::optional<std::string_view> ReadBufferView::getPayload()
@@ -757,25 +1156,11 @@ namespace ripc
             return std::nullopt;
         }
 
-        // ищем конец первого заголовка
-        char *start = m_mem.m_addr + m_current_size;
-        char *end = m_mem.find(m_current_size, m_memory_finalizer);
-
-        // если это символ конца сообщения,
-        // то найдена полезная нагрузка
-        if (*end == m_memory_finalizer)
-        {
-            // размер выделенной области
-            size_t size = end - start;
-            m_current_size += size;
-            // finalizePayload();
-            m_memory_finalized = 1;
-            // LOG_INFO("Got payload: '%s'", std::string_view(start, size));
-            return std::string_view(start, size);
-        }
-        LOG_ERR("Empty payload");
-
-        return std::nullopt;
+        // полезная нагрузка лежит сразу за заголовками, ее длина известна
+        char *start = m_mem.m_addr + m_header_len;
+        m_current_size = m_header_len + m_payload_len;
+        m_memory_finalized = 1;
+        return std::string_view(start, m_payload_len);
     }
 
     bool ReadBufferView::finalizeHeader()
@@ -797,28 +1182,11 @@ namespace ripc
             return false;
         }
 
-        LOG_INFO("Searching for char m_memory_delimeter");
-        // этот метод пролистал m_current_position до начала полезной нагрузки
-        char *delim = m_mem.find(m_current_size, m_memory_delimeter);
-        LOG_INFO("Got smth");
-
-        if (!delim || delim == m_mem.end())
-        {
-            LOG_ERR("there is no a memory delimeter");
-            return false;
-        }
-
-        // если это разделитель между заголовком и сообщением
-        if (*delim == m_memory_delimeter)
-        {
-            m_current_size = delim - m_mem.m_addr + 1;
-            m_headers_finalized = true;
-            LOG_INFO("Headers finalized");
-            return true;
-        }
-
-        LOG_ERR("Cannot finalize headers");
-        return false;
+        // пропускаем непрочитанные заголовки
+        m_current_size = m_header_len;
+        m_headers_finalized = true;
+        LOG_INFO("Headers finalized");
+        return true;
     }
 
     bool ReadBufferView::finalizePayload()
@@ -837,29 +1205,10 @@ namespace ripc
             // }
         }
 
-        // перематываем до символа конца полезной нагрузки
-        char *delim = m_mem.find(m_current_size, m_memory_finalizer);
-
-        if (!delim)
-        {
-            LOG_ERR("cannot find message finisher");
-            return false;
-        }
-        else if (*delim == m_memory_finalizer || delim == m_mem.end())
-        {
-            m_memory_finalized = 1;
-            m_current_size = m_mem.m_max_size;
-            return true;
-        }
-
-        // // если мы дошли до конца
-        // else if (delim == m_mem.end())
-        //     m_current_size = m_mem.m_max_size;
-        // else
-        //     m_current_size = delim - m_mem.m_addr + 1;
-
-        // m_memory_finalized = 1;
-        return false;
+        // перематываем до конца полезной нагрузки
+        m_current_size = m_header_len + m_payload_len;
+        m_memory_finalized = 1;
+        return true;
     }
 
 } // namespace ripc
@@ -42,13 +42,24 @@ void print_driver_state(const struct st_reg_tasks *state)
                 for (int j = 0; j < task->servers_count && j < MAX_SERVERS_PER_PID; ++j)
                 {
                     const struct st_server *server = &task->servers[j];
-                    printf("    Server ID: %d, Name: \"%.*s\"\n", server->id, MAX_SERVER_NAME - 1, server->name);
+                    printf("    Server ID: %d, Name: \"%.*s\", NUMA node: %d", server->id, MAX_SERVER_NAME - 1,
+                           server->name, server->numa_node);
+                    if (server->group_size > 0)
+                        printf(", Group of %d", server->group_size);
+                    if (server->route_prefix[0])
+                        printf(", Route: \"%.*s\"", MAX_ROUTE_PREFIX - 1, server->route_prefix);
+                    if (server->subscribers >= 0 && (server->flags & SERVER_FLAG_QUEUE))
+                        printf(", Job queue with %d workers", server->subscribers);
+                    else if (server->subscribers >= 0)
+                        printf(", %s with %d subscribers", (server->flags & SERVER_FLAG_STATE) ? "State channel" : "Channel",
+                               server->subscribers);
+                    printf("\n");
                     if (server->conn_count > 0)
                     {
                         printf("      Connected Client IDs (%d): ", server->conn_count);
                         for (int k = 0; k < server->conn_count && k < MAX_CLIENTS_PER_SERVER; ++k)
                         {
-                            printf("%d ", server->conn_ids[k]);
+                            printf("%d(node %d) ", server->conn_ids[k], server->conn_nodes[k]);
                         }
                         printf("\n");
                     }
@@ -91,6 +102,10 @@ void print_driver_state(const struct st_reg_tasks *state)
     {
         printf("No tasks registered with the RIPC driver.\n");
     }
+
+    printf("Shared memory pools: %d (idle: %d), %lu KiB\n", state->shm.pools_count, state->shm.idle_pools,
+           state->shm.bytes / 1024);
+    printf("  Sub regions: %d used, %d free\n", state->shm.subs_used, state->shm.subs_free);
     printf("===============================\n");
 }
 
@@ -76,6 +76,143 @@ TEST_F(ConnManip, ServerDisconnect)
     ASSERT_EQ(sr->disconnect(cl->getId()), 1);
 }
 
+// Подключения к группе серверов распределяются между участниками по кругу
+TEST_F(ConnManip, GroupRoundRobin)
+{
+    ripc::Server *servers[2];
+    int served[2] = {0, 0};
+    for (int i = 0; i < 2; i++)
+    {
+        servers[i] = ripc::createServer("GroupRoundRobin", ripc::DEFAULTS::MAX_REGION_SIZE, false,
+                                        SERVER_NUMA_NODE_AUTO, ripc::ServerGroup::ROUND_ROBIN);
+        ASSERT_NE(servers[i], nullptr);
+        ASSERT_TRUE(servers[i]->registerCallback(
+            "/test/who", [&served, i](const ripc::Url &url, ripc::ReadBufferView &rb) { served[i]++; }, nullptr));
+    }
+
+    // каждый клиент попадает на своего участника и обслуживается только им
+    for (int i = 0; i < 4; i++)
+    {
+        auto cl = ripc::createClient();
+        ASSERT_NE(cl, nullptr);
+        cl->setBlockingMode(true);
+        ASSERT_EQ(cl->connect("GroupRoundRobin"), 1) << "Client " << i;
+        ASSERT_TRUE(cl->call("/test/who", nullptr, nullptr)) << "Client " << i;
+    }
+
+    EXPECT_EQ(served[0], 2);
+    EXPECT_EQ(served[1], 2);
+}
+
+// Новый участник группы получает подключения, пока у него меньше соединений
+TEST_F(ConnManip, GroupLeastConnections)
+{
+    ripc::Server *servers[2];
+    int served[2] = {0, 0};
+    auto create = [&served](int i) {
+        auto srv = ripc::createServer("GroupLeastConnections", ripc::DEFAULTS::MAX_REGION_SIZE, false,
+                                      SERVER_NUMA_NODE_AUTO, ripc::ServerGroup::LEAST_CONNECTIONS);
+        if (srv)
+            srv->registerCallback(
+                "/test/who", [&served, i](const ripc::Url &url, ripc::ReadBufferView &rb) { served[i]++; }, nullptr);
+        return srv;
+    };
+
+    // блокирующий вызов возвращается после ответа: обслуживший участник уже посчитан
+    auto connect_and_call = [](ripc::Client *cl) {
+        cl->setBlockingMode(true);
+        return cl->connect("GroupLeastConnections") && cl->call("/test/who", nullptr, nullptr);
+    };
+
+    servers[0] = create(0);
+    ASSERT_NE(servers[0], nullptr);
+
+    std::vector<ripc::Client *> clients;
+    for (int i = 0; i < 4; i++)
+    {
+        clients.push_back(ripc::createClient());
+        ASSERT_NE(clients.back(), nullptr);
+    }
+
+    ASSERT_TRUE(connect_and_call(clients[0]));
+    ASSERT_TRUE(connect_and_call(clients[1]));
+    EXPECT_EQ(served[0], 2);
+
+    // у второго участника соединений нет: следующие два подключения достаются ему
+    servers[1] = create(1);
+    ASSERT_NE(servers[1], nullptr);
+    for (int i = 2; i < 4; i++)
+    {
+        ASSERT_TRUE(connect_and_call(clients[i])) << "Client " << i;
+        EXPECT_EQ(served[0], 2) << "Client " << i << " was placed on the busier member";
+        EXPECT_EQ(served[1], i - 1) << "Client " << i;
+    }
+}
+
+// Соединение переходит к другому участнику группы, клиент продолжает вызовы без переподключения
+TEST_F(ConnManip, GroupMigrateConnection)
+{
+    ripc::Server *servers[2];
+    int served[2] = {0, 0};
+    for (int i = 0; i < 2; i++)
+    {
+        servers[i] = ripc::createServer("GroupMigrate", ripc::DEFAULTS::MAX_REGION_SIZE, false, SERVER_NUMA_NODE_AUTO,
+                                        ripc::ServerGroup::ROUND_ROBIN);
+        ASSERT_NE(servers[i], nullptr);
+        ASSERT_TRUE(servers[i]->registerCallback(
+            "/test/who", [&served, i](const ripc::Url &url, ripc::ReadBufferView &rb) { served[i]++; }, nullptr));
+    }
+
+    auto cl = ripc::createClient();
+    ASSERT_NE(cl, nullptr);
+    cl->setBlockingMode(true);
+    ASSERT_EQ(cl->connect("GroupMigrate"), 1);
+    ASSERT_TRUE(cl->call("/test/who", nullptr, nullptr));
+
+    int from = served[0] ? 0 : 1;
+    int to = 1 - from;
+    ASSERT_TRUE(servers[from]->migrate(cl->getId(), servers[to]->getId()));
+
+    ASSERT_TRUE(cl->call("/test/who", nullptr, nullptr));
+    EXPECT_EQ(served[from], 1);
+    EXPECT_EQ(served[to], 1);
+
+    // соединение больше не принадлежит старому серверу
+    EXPECT_FALSE(servers[from]->migrate(cl->getId(), servers[to]->getId()));
+}
+
+// Группа с маршрутизацией отдает запрос участнику с самым длинным подходящим префиксом URL
+TEST_F(ConnManip, GroupRoutesByUrlPrefix)
+{
+    int served_default = 0, served_users = 0;
+    auto def = ripc::createServer("GroupRoutes", ripc::DEFAULTS::MAX_REGION_SIZE, false, SERVER_NUMA_NODE_AUTO,
+                                  ripc::ServerGroup::URL_PREFIX);
+    ASSERT_NE(def, nullptr);
+    auto users = ripc::createServer("GroupRoutes", ripc::DEFAULTS::MAX_REGION_SIZE, false, SERVER_NUMA_NODE_AUTO,
+                                    ripc::ServerGroup::URL_PREFIX, "/users");
+    ASSERT_NE(users, nullptr);
+    EXPECT_EQ(users->getGroup(), ripc::ServerGroup::URL_PREFIX);
+
+    ASSERT_TRUE(def->registerCallback(
+        "/orders/list", [&](const ripc::Url &url, ripc::ReadBufferView &rb) { served_default++; }, nullptr));
+    ASSERT_TRUE(users->registerCallback(
+        "/users/list", [&](const ripc::Url &url, ripc::ReadBufferView &rb) { served_users++; }, nullptr));
+
+    // подключения достаются участникам по кругу, но запросы идут по префиксу, а не по соединению
+    for (int i = 0; i < 2; i++)
+    {
+        auto cl = ripc::createClient();
+        ASSERT_NE(cl, nullptr);
+        cl->setBlockingMode(true);
+        ASSERT_EQ(cl->connect("GroupRoutes"), 1) << "Client " << i;
+        ASSERT_TRUE(cl->call("/users/list", nullptr, nullptr)) << "Client " << i;
+        ASSERT_TRUE(cl->call("/orders/list", nullptr, nullptr)) << "Client " << i;
+    }
+
+    EXPECT_EQ(served_default, 2);
+    EXPECT_EQ(served_users, 2);
+}
+
 int main(int argc, char **argv)
 {
     // чтобы логов не было из библиотеки
@@ -1,6 +1,10 @@
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <future>
+#include <poll.h>
+#include <set>
+#include <thread>
 #include <gtest/gtest.h>
 #include "../tests.hpp"
 
@@ -101,6 +105,421 @@ TEST_F(DataTransm, ServerToClient) {
     ASSERT_TRUE(call_future.get()) << "Data validation failed";
 }
 
+TEST_F(DataTransm, LargePayload)
+{
+    auto cl = ripc::createClient();
+    auto srv = ripc::createServer("LargePayload");
+
+    ASSERT_NE(cl, nullptr);
+    ASSERT_NE(srv, nullptr);
+
+    // полезная нагрузка больше одной страницы
+    const std::string send_data(96 * 1024, 'x');
+    std::promise<bool> callback_promise;
+    auto callback_future = callback_promise.get_future();
+
+    auto reg_res = srv->registerCallback(
+        "/test/large",
+        [&](const ripc::Url &url, ripc::ReadBufferView &rb) {
+            auto data = rb.getPayload();
+            callback_promise.set_value(data && (*data == send_data));
+        },
+        nullptr);
+    ASSERT_TRUE(reg_res) << "Callback registration failed";
+
+    ASSERT_TRUE(cl->connect("LargePayload", 128 * 1024)) << "Connection failed";
+
+    auto call_res =
+        cl->call("/test/large", nullptr, [&](ripc::WriteBufferView &wb) { wb.setPayload(send_data); });
+    ASSERT_TRUE(call_res) << "Call failed";
+
+    ASSERT_NE(callback_future.wait_for(std::chrono::seconds(4)), std::future_status::timeout) << "Callback timed out";
+    ASSERT_TRUE(callback_future.get()) << "Large payload was truncated";
+}
+
+TEST_F(DataTransm, BinaryPayloadWithStatus)
+{
+    auto cl = ripc::createClient();
+    auto srv = ripc::createServer("BinaryPayload");
+
+    ASSERT_NE(cl, nullptr);
+    ASSERT_NE(srv, nullptr);
+
+    // длины сообщения лежат в управляющем блоке: бывшие разделители внутри данных не обрезают их
+    const std::string send_data("a\tb\nc\0d", 7);
+    const std::string resp_data("\0\n\t", 3);
+    std::promise<bool> callback_promise;
+    auto callback_future = callback_promise.get_future();
+
+    auto reg_res = srv->registerCallback(
+        "/test/binary",
+        [&](const ripc::Url &url, ripc::ReadBufferView &rb) {
+            auto data = rb.getPayload();
+            callback_promise.set_value(data && (*data == send_data));
+        },
+        [&](ripc::WriteBufferView &wb) {
+            wb.setStatus(42);
+            wb.setPayload(resp_data);
+        });
+    ASSERT_TRUE(reg_res) << "Callback registration failed";
+
+    ASSERT_TRUE(cl->connect("BinaryPayload")) << "Connection failed";
+    cl->setBlockingMode(true);
+
+    bool got_response = false;
+    int status = 0;
+    auto call_res = cl->call(
+        "/test/binary",
+        [&](ripc::ReadBufferView &rb) {
+            status = rb.getStatus();
+            auto data = rb.getPayload();
+            got_response = data && (*data == resp_data);
+        },
+        [&](ripc::WriteBufferView &wb) { wb.setPayload(send_data); });
+    ASSERT_TRUE(call_res) << "Call failed";
+
+    ASSERT_NE(callback_future.wait_for(std::chrono::seconds(4)), std::future_status::timeout) << "Callback timed out";
+    ASSERT_TRUE(callback_future.get()) << "Request payload was truncated";
+    ASSERT_TRUE(got_response) << "Response payload was truncated";
+    ASSERT_EQ(status, 42);
+}
+
+TEST_F(DataTransm, RegionSizeLimitedByServer)
+{
+    auto cl = ripc::createClient();
+    auto srv = ripc::createServer("RegionSizeLimited", 2 * PAGE_SIZE);
+
+    ASSERT_NE(cl, nullptr);
+    ASSERT_NE(srv, nullptr);
+    ASSERT_EQ(srv->getMaxRegionSize(), 2 * PAGE_SIZE);
+
+    ASSERT_TRUE(cl->connect("RegionSizeLimited", 64 * 1024)) << "Connection failed";
+
+    // клиент получает не больше, чем разрешил сервер
+    std::promise<size_t> capacity_promise;
+    auto capacity_future = capacity_promise.get_future();
+    cl->call("/test/capacity", nullptr,
+             [&](ripc::WriteBufferView &wb) { capacity_promise.set_value(wb.getCapacity()); });
+
+    ASSERT_NE(capacity_future.wait_for(std::chrono::seconds(2)), std::future_status::timeout);
+    // запрос занимает первую половину области после управляющего блока
+    ASSERT_EQ(capacity_future.get(), SHM_RESPONSE_OFFSET(2 * PAGE_SIZE) - SHM_REQUEST_OFFSET);
+}
+
+TEST_F(DataTransm, RegionGrowsOnDemand)
+{
+    auto cl = ripc::createClient();
+    auto srv = ripc::createServer("RegionGrows");
+
+    ASSERT_NE(cl, nullptr);
+    ASSERT_NE(srv, nullptr);
+
+    const std::string send_data(96 * 1024, 'g');
+    std::promise<bool> callback_promise;
+    auto callback_future = callback_promise.get_future();
+
+    auto reg_res = srv->registerCallback(
+        "/test/grow",
+        [&](const ripc::Url &url, ripc::ReadBufferView &rb) {
+            auto data = rb.getPayload();
+            callback_promise.set_value(data && (*data == send_data));
+        },
+        nullptr);
+    ASSERT_TRUE(reg_res) << "Callback registration failed";
+    ASSERT_TRUE(srv->registerCallback("/test/capacity", nullptr, nullptr));
+
+    // подключение с областью по умолчанию (страница запроса и страница ответа)
+    ASSERT_TRUE(cl->connect("RegionGrows")) << "Connection failed";
+    cl->setBlockingMode(true);
+
+    // запись не помещается в страницу: область растет без переподключения
+    size_t capacity_before = 0;
+    auto call_res = cl->call("/test/grow", nullptr, [&](ripc::WriteBufferView &wb) {
+        capacity_before = wb.getCapacity();
+        wb.setPayload(send_data);
+    });
+    ASSERT_TRUE(call_res) << "Call failed";
+    ASSERT_EQ(capacity_before, SHM_RESPONSE_OFFSET(SHM_REGION_PAGE_SIZE) - SHM_REQUEST_OFFSET);
+
+    ASSERT_NE(callback_future.wait_for(std::chrono::seconds(4)), std::future_status::timeout) << "Callback timed out";
+    ASSERT_TRUE(callback_future.get()) << "Payload was truncated instead of growing the region";
+
+    // следующее сообщение видит выросшую область
+    size_t capacity_after = 0;
+    cl->call("/test/capacity", nullptr, [&](ripc::WriteBufferView &wb) { capacity_after = wb.getCapacity(); });
+    ASSERT_GT(capacity_after, send_data.size());
+}
+
+TEST_F(DataTransm, BlockingCallGetsResponse)
+{
+    auto cl = ripc::createClient();
+    auto srv = ripc::createServer("BlockingCall");
+
+    ASSERT_NE(cl, nullptr);
+    ASSERT_NE(srv, nullptr);
+
+    auto reg_res = srv->registerCallback(
+        "/test/echo",
+        nullptr,
+        [](ripc::WriteBufferView &wb) { wb.setPayload("pong"); });
+    ASSERT_TRUE(reg_res) << "Server callback registration failed";
+
+    ASSERT_TRUE(cl->connect("BlockingCall")) << "Connection failed";
+    cl->setBlockingMode(true);
+
+    // в блокирующем режиме ответ обрабатывается до возврата из call
+    for (int i = 0; i < 16; i++)
+    {
+        bool got_response = false;
+        auto call_res = cl->call(
+            "/test/echo",
+            [&](ripc::ReadBufferView &rb) {
+                auto data = rb.getPayload();
+                got_response = data && (*data == "pong");
+            },
+            nullptr);
+        ASSERT_TRUE(call_res) << "Call " << i << " failed";
+        ASSERT_TRUE(got_response) << "Response " << i << " was not handled before call returned";
+    }
+}
+
+TEST_F(DataTransm, ServeLoopAnswersRequests)
+{
+    auto srv = ripc::createServer("ServeLoop");
+    ASSERT_NE(srv, nullptr);
+
+    auto reg_res = srv->registerCallback(
+        "/test/serve",
+        nullptr,
+        [](ripc::WriteBufferView &wb) { wb.setPayload("served"); });
+    ASSERT_TRUE(reg_res) << "Server callback registration failed";
+
+    // цикл ответа и приема запросов в отдельном потоке
+    auto serve_future = std::async(std::launch::async, [srv] { return srv->serve(); });
+
+    const int clients_count = 4;
+    const int requests_per_client = 8;
+    std::vector<ripc::Client *> clients;
+    for (int i = 0; i < clients_count; i++)
+    {
+        auto cl = ripc::createClient();
+        ASSERT_NE(cl, nullptr);
+        ASSERT_TRUE(cl->connect("ServeLoop")) << "Connection " << i << " failed";
+        cl->setBlockingMode(true);
+        clients.push_back(cl);
+    }
+
+    int responses = 0;
+    for (int r = 0; r < requests_per_client; r++)
+    {
+        for (auto cl : clients)
+        {
+            cl->call(
+                "/test/serve",
+                [&](ripc::ReadBufferView &rb) {
+                    auto data = rb.getPayload();
+                    if (data && *data == "served")
+                        responses++;
+                },
+                nullptr);
+        }
+    }
+    EXPECT_EQ(responses, clients_count * requests_per_client);
+
+    srv->stopServing();
+    ASSERT_NE(serve_future.wait_for(std::chrono::seconds(2)), std::future_status::timeout) << "Serve loop hung";
+    EXPECT_TRUE(serve_future.get());
+}
+
+TEST_F(DataTransm, ForwardSwapsRegions)
+{
+    // следующий сервер отвечает в своем цикле: поток уведомлений занят пересылкой
+    auto back = ripc::createServer("ForwardBack");
+    ASSERT_NE(back, nullptr);
+    std::string received;
+    ASSERT_TRUE(back->registerCallback(
+        "/test/forward",
+        [&](const ripc::Url &url, ripc::ReadBufferView &rb) {
+            auto data = rb.getPayload();
+            received = data ? std::string(*data) : "";
+        },
+        [&](ripc::WriteBufferView &wb) { wb.setPayload("back:" + received); }));
+    auto serve_future = std::async(std::launch::async, [back] { return back->serve(); });
+
+    // прокси пересылает запрос клиентом с областью того же размера
+    auto proxy = ripc::createServer("ForwardProxy");
+    ASSERT_NE(proxy, nullptr);
+    auto downstream = ripc::createClient();
+    ASSERT_NE(downstream, nullptr);
+    downstream->setBlockingMode(true);
+    ASSERT_TRUE(downstream->connect("ForwardBack"));
+    ASSERT_TRUE(proxy->registerForward("/test/forward", downstream));
+
+    auto cl = ripc::createClient();
+    ASSERT_NE(cl, nullptr);
+    cl->setBlockingMode(true);
+    ASSERT_TRUE(cl->connect("ForwardProxy"));
+
+    for (const std::string payload : {"first", "second"})
+    {
+        std::string response;
+        int status = -2;
+        ASSERT_TRUE(cl->call(
+            "/test/forward",
+            [&](ripc::ReadBufferView &rb) {
+                status = rb.getStatus();
+                auto data = rb.getPayload();
+                response = data ? std::string(*data) : "";
+            },
+            [&](ripc::WriteBufferView &wb) { wb.setPayload(payload); }));
+        EXPECT_EQ(status, 0);
+        EXPECT_EQ(response, "back:" + payload);
+    }
+
+    back->stopServing();
+    ASSERT_NE(serve_future.wait_for(std::chrono::seconds(2)), std::future_status::timeout) << "Serve loop hung";
+}
+
+// Одна публикация доходит до всех подписчиков канала, данные читаются из общей подобласти
+TEST_F(DataTransm, ChannelBroadcast)
+{
+    auto channel = ripc::createChannel("ChannelBroadcast");
+    ASSERT_NE(channel, nullptr);
+
+    constexpr int SUBSCRIBERS = 4;
+    std::vector<std::promise<std::string>> received(SUBSCRIBERS);
+    for (int i = 0; i < SUBSCRIBERS; i++)
+    {
+        auto cl = ripc::createClient();
+        ASSERT_NE(cl, nullptr);
+        ASSERT_TRUE(cl->subscribe("ChannelBroadcast", [&received, i](std::string_view msg) {
+            received[i].set_value(std::string(msg));
+        })) << "Subscriber " << i;
+    }
+
+    // к каналу нельзя подключиться как к серверу
+    auto cl = ripc::createClient();
+    ASSERT_NE(cl, nullptr);
+    EXPECT_FALSE(cl->connect("ChannelBroadcast"));
+
+    EXPECT_EQ(channel->publish("broadcast"), SUBSCRIBERS);
+    for (int i = 0; i < SUBSCRIBERS; i++)
+    {
+        auto future = received[i].get_future();
+        ASSERT_NE(future.wait_for(std::chrono::seconds(2)), std::future_status::timeout) << "Subscriber " << i;
+        EXPECT_EQ(future.get(), "broadcast");
+    }
+}
+
+TEST_F(DataTransm, StateChannelLatestValue)
+{
+    auto channel = ripc::createChannel("StateChannel", ripc::DEFAULTS::CHANNEL_SIZE, ripc::ChannelType::STATE);
+    ASSERT_NE(channel, nullptr);
+
+    // канал состояния не вызывает обработчиков
+    auto cl = ripc::createClient();
+    ASSERT_NE(cl, nullptr);
+    EXPECT_FALSE(cl->subscribe("StateChannel", [](std::string_view) {}));
+    ASSERT_TRUE(cl->subscribe("StateChannel"));
+
+    std::string state;
+    EXPECT_FALSE(cl->readState(state));
+
+    EXPECT_EQ(channel->publish("v1"), 0);
+    EXPECT_EQ(channel->publish("v2"), 0);
+    ASSERT_TRUE(cl->readState(state));
+    EXPECT_EQ(state, "v2");
+}
+
+TEST_F(DataTransm, JobQueueWorkers)
+{
+    auto queue = ripc::createChannel("JobQueue", 64 * 1024, ripc::ChannelType::QUEUE);
+    ASSERT_NE(queue, nullptr);
+
+    constexpr int WORKERS = 3;
+    constexpr int JOBS = 30;
+    std::mutex lock;
+    std::multiset<std::string> taken;
+    std::atomic<int> left{JOBS};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < WORKERS; i++)
+    {
+        auto cl = ripc::createClient();
+        ASSERT_NE(cl, nullptr);
+        ASSERT_TRUE(cl->subscribe("JobQueue")) << "Worker " << i;
+
+        // каждое задание достается ровно одному исполнителю
+        workers.emplace_back([cl, &lock, &taken, &left]() {
+            std::string job;
+            while (left.load() > 0 && cl->takeJob(job, 1000))
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                taken.insert(job);
+                left--;
+            }
+        });
+    }
+
+    for (int i = 0; i < JOBS; i++)
+        EXPECT_GE(queue->publish("job" + std::to_string(i)), 0) << "Job " << i;
+    for (auto &worker : workers)
+        worker.join();
+
+    ASSERT_EQ(taken.size(), (size_t)JOBS);
+    for (int i = 0; i < JOBS; i++)
+        EXPECT_EQ(taken.count("job" + std::to_string(i)), 1u) << "Job " << i;
+}
+
+TEST_F(DataTransm, ConnectionFd)
+{
+    auto cl = ripc::createClient();
+    auto srv = ripc::createServer("ConnectionFd");
+    ASSERT_NE(cl, nullptr);
+    ASSERT_NE(srv, nullptr);
+
+    auto reg_res = srv->registerCallback(
+        "/test/fd",
+        nullptr,
+        [](ripc::WriteBufferView &wb) { wb.setPayload("by_fd"); });
+    ASSERT_TRUE(reg_res) << "Server callback registration failed";
+
+    ASSERT_TRUE(cl->connect("ConnectionFd", ripc::DEFAULTS::REGION_SIZE, true)) << "Connection failed";
+    int cl_fd = cl->getConnectionFd();
+    ASSERT_GE(cl_fd, 0) << "Client did not get connection fd";
+
+    // соединение появляется у сервера после уведомления NEW_CONNECTION
+    int srv_fd = -1;
+    for (int i = 0; i < 100 && srv_fd < 0; i++)
+    {
+        srv_fd = srv->accept(cl->getId());
+        if (srv_fd < 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GE(srv_fd, 0) << "Server did not get connection fd";
+
+    bool got_response = false;
+    ASSERT_TRUE(cl->call(
+        "/test/fd",
+        [&](ripc::ReadBufferView &rb) {
+            auto data = rb.getPayload();
+            got_response = data && (*data == "by_fd");
+        },
+        nullptr));
+
+    // запрос и ответ приходят только в дескрипторы соединения
+    pollfd pfd{srv_fd, POLLIN, 0};
+    ASSERT_EQ(poll(&pfd, 1, 1000), 1) << "Request did not reach server fd";
+    ASSERT_EQ(srv->processConnectionEvents(srv_fd), 1);
+
+    pfd = {cl_fd, POLLIN, 0};
+    ASSERT_EQ(poll(&pfd, 1, 1000), 1) << "Response did not reach client fd";
+    ASSERT_EQ(cl->processConnectionEvents(), 1);
+    EXPECT_TRUE(got_response);
+
+    // пустой дескриптор не блокирует
+    EXPECT_EQ(cl->processConnectionEvents(), 0);
+}
+
 int main(int argc, char **argv)
 {
     ripc::setLogLevel(ripc::LogLevel::WARNING);
@@ -53,6 +53,53 @@ TEST(ServerRegistartion, CreataionAfterDeletion)
     ASSERT_NE(ripc::createServer("CreataionAfterDeletion"), nullptr);
 }
 
+// память соединений выделяется на узле NUMA потока, зарегистрировавшего сервер
+TEST(ServerRegistartion, NumaNodeChosenByDriver)
+{
+    auto server = ripc::createServer("NumaNodeChosenByDriver");
+
+    ASSERT_NE(server, nullptr);
+    ASSERT_GE(server->getNumaNode(), 0);
+
+    // явно запрошенный узел сохраняется
+    auto pinned = ripc::createServer("NumaNodePinned", ripc::DEFAULTS::MAX_REGION_SIZE, false, server->getNumaNode());
+    ASSERT_NE(pinned, nullptr);
+    ASSERT_EQ(pinned->getNumaNode(), server->getNumaNode());
+}
+
+// регистрация с несуществующим узлом NUMA
+TEST(ServerRegistartion, InvalidNumaNode)
+{
+    ASSERT_EQ(ripc::createServer("InvalidNumaNode", ripc::DEFAULTS::MAX_REGION_SIZE, false, 1 << 20), nullptr);
+}
+
+// серверы группы делят одно имя, политику распределения задает первый участник
+TEST(ServerRegistartion, GroupSharesName)
+{
+    auto first = ripc::createServer("GroupSharesName", ripc::DEFAULTS::MAX_REGION_SIZE, false,
+                                    SERVER_NUMA_NODE_AUTO, ripc::ServerGroup::LEAST_CONNECTIONS);
+    auto second = ripc::createServer("GroupSharesName", ripc::DEFAULTS::MAX_REGION_SIZE, false,
+                                     SERVER_NUMA_NODE_AUTO, ripc::ServerGroup::ROUND_ROBIN);
+
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(second->getGroup(), ripc::ServerGroup::LEAST_CONNECTIONS);
+}
+
+// имя группы нельзя занять сервером без группы, а имя одиночного сервера - группой
+TEST(ServerRegistartion, GroupNameNotShared)
+{
+    ASSERT_NE(ripc::createServer("GroupNameNotShared", ripc::DEFAULTS::MAX_REGION_SIZE, false, SERVER_NUMA_NODE_AUTO,
+                                 ripc::ServerGroup::ROUND_ROBIN),
+              nullptr);
+    EXPECT_EQ(ripc::createServer("GroupNameNotShared"), nullptr);
+
+    ASSERT_NE(ripc::createServer("SingleNameNotShared"), nullptr);
+    EXPECT_EQ(ripc::createServer("SingleNameNotShared", ripc::DEFAULTS::MAX_REGION_SIZE, false, SERVER_NUMA_NODE_AUTO,
+                                 ripc::ServerGroup::ROUND_ROBIN),
+              nullptr);
+}
+
 int main(int argc, char **argv)
 {
     // чтобы логов не было из библиотеки
@@ -0,0 +1,96 @@
+#include "../tests.hpp"
+#include "ripc/ripc.hpp"
+#include <chrono>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+class HugePages : public RipcTest
+{
+  protected:
+    void runTest(bool hugePages, int requestCount, int payloadSize)
+    {
+        const std::string &testName{std::string(hugePages ? "huge" : "regular") + "payloadSize" +
+                                    std::to_string(payloadSize)};
+        auto srv = ripc::createServer(testName, ripc::DEFAULTS::MAX_REGION_SIZE, hugePages);
+        ASSERT_NE(srv, nullptr);
+
+        ASSERT_EQ(srv->usesHugePages(), hugePages);
+
+        const std::string payload(payloadSize, 'h');
+        auto reg_res = srv->registerCallback(
+            "/load/huge", [](const ripc::Url &url, ripc::ReadBufferView &rb) { rb.getPayload(); },
+            [&](ripc::WriteBufferView &wb) { wb.setPayload(payload); });
+        ASSERT_TRUE(reg_res);
+
+        auto cli = ripc::createClient();
+        ASSERT_NE(cli, nullptr);
+        cli->setBlockingMode(true);
+        ASSERT_TRUE(cli->connect(testName, SHM_REGION_MAX_SIZE));
+
+        std::vector<long> results;
+        results.reserve(requestCount + 1);
+
+        auto full_start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < requestCount; ++i)
+        {
+            bool got_response = false;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            auto call_res = cli->call(
+                "/load/huge",
+                [&](ripc::ReadBufferView &rb) {
+                    auto data = rb.getPayload();
+                    got_response = data && data->size() == payload.size();
+                },
+                [&](ripc::WriteBufferView &wb) { wb.setPayload(payload); });
+            auto end = std::chrono::high_resolution_clock::now();
+
+            ASSERT_TRUE(call_res) << "Call " << i << " failed";
+            ASSERT_TRUE(got_response) << "Response " << i << " was truncated";
+            results.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        }
+        auto full_end = std::chrono::high_resolution_clock::now();
+        results.push_back(std::chrono::duration_cast<std::chrono::microseconds>(full_end - full_start).count());
+
+        std::ofstream fout(testName + ".log");
+        for (int i = 0; i < requestCount; ++i)
+            fout << "(" << i << "," << results[i] << "),";
+        fout << "\n" << results.back();
+    }
+};
+
+// одинаковые сообщения через обычные страницы и через огромные: сравнение по логам
+TEST_F(HugePages, Regular256K)
+{
+    runTest(false, 200, 256 * 1024);
+}
+
+TEST_F(HugePages, Huge256K)
+{
+    runTest(true, 200, 256 * 1024);
+}
+
+TEST_F(HugePages, Regular384K)
+{
+    runTest(false, 200, 384 * 1024);
+}
+
+TEST_F(HugePages, Huge384K)
+{
+    runTest(true, 200, 384 * 1024);
+}
+
+int main(int argc, char **argv)
+{
+    std::ofstream fout("huge_pages.log");
+    ripc::setLogStream(&fout);
+    ripc::initialize();
+
+    ::testing::InitGoogleTest(&argc, argv);
+    auto ret = RUN_ALL_TESTS();
+
+    ripc::shutdown();
+    return ret;
+}
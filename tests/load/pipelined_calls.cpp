@@ -0,0 +1,103 @@
+#include "../tests.hpp"
+#include "ripc/ripc.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PipelinedCalls : public RipcTest
+{
+  protected:
+    void runTest(int threadCount, int requestCount, int payloadSize)
+    {
+        const std::string &testName{"pipelinedThreads" + std::to_string(threadCount) + "payloadSize" +
+                                    std::to_string(payloadSize)};
+        auto srv = ripc::createServer(testName);
+        ASSERT_NE(srv, nullptr);
+
+        // ответ сервера пишется в свою страницу, пока клиент готовит следующий запрос
+        const std::string payload(payloadSize, 'p');
+        auto reg_res = srv->registerCallback(
+            "/load/pipelined", [](const ripc::Url &url, ripc::ReadBufferView &rb) { rb.getPayload(); },
+            [&](ripc::WriteBufferView &wb) { wb.setPayload(payload); });
+        ASSERT_TRUE(reg_res);
+
+        auto cli = ripc::createClient();
+        ASSERT_NE(cli, nullptr);
+        cli->setBlockingMode(true);
+        ASSERT_TRUE(cli->connect(testName, 4 * payloadSize));
+
+        std::atomic<int> responses{0};
+        std::vector<long> results(requestCount);
+
+        // потоки одного клиента пишут запросы по очереди: следующий готовится во время ответа сервера
+        auto full_start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&, t]() {
+                for (int i = t; i < requestCount; i += threadCount)
+                {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    cli->call(
+                        "/load/pipelined",
+                        [&](ripc::ReadBufferView &rb) {
+                            auto data = rb.getPayload();
+                            if (data && data->size() == payload.size())
+                                responses++;
+                        },
+                        [&](ripc::WriteBufferView &wb) { wb.setPayload(payload); });
+                    auto end = std::chrono::high_resolution_clock::now();
+                    results[i] = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+                }
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        auto full_end = std::chrono::high_resolution_clock::now();
+
+        EXPECT_EQ(responses.load(), requestCount);
+
+        std::ofstream fout(testName + ".log");
+        for (int i = 0; i < requestCount; ++i)
+            fout << "(" << i << "," << results[i] << "),";
+        fout << "\n" << std::chrono::duration_cast<std::chrono::microseconds>(full_end - full_start).count();
+    }
+};
+
+// один поток ждет ответа перед каждым запросом, два - готовят запрос во время ответа: сравнение по логам
+TEST_F(PipelinedCalls, Sequential4K)
+{
+    runTest(1, 400, 4 * 1024);
+}
+
+TEST_F(PipelinedCalls, Pipelined4K)
+{
+    runTest(2, 400, 4 * 1024);
+}
+
+TEST_F(PipelinedCalls, Sequential64K)
+{
+    runTest(1, 200, 64 * 1024);
+}
+
+TEST_F(PipelinedCalls, Pipelined64K)
+{
+    runTest(2, 200, 64 * 1024);
+}
+
+int main(int argc, char **argv)
+{
+    std::ofstream fout("pipelined_calls.log");
+    ripc::setLogStream(&fout);
+    ripc::initialize();
+
+    ::testing::InitGoogleTest(&argc, argv);
+    auto ret = RUN_ALL_TESTS();
+
+    ripc::shutdown();
+    return ret;
+}